@@ -19,8 +19,9 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 File:  arm_timer.h
 
-Interface into the ARM timer on the Broadcom 2835.  Along with a busy wait timer
-that just spins the ARM CPU.
+Interface into the ARM timer on the Broadcom 2835, which drives any number of
+one shot and periodic software timers.  Along with System Timer backed delays
+(which sleep the CPU when they can) and a busy wait that just spins the ARM CPU.
 
 */
 
@@ -29,15 +30,55 @@ that just spins the ARM CPU.
 
 #define SPIN_WAIT_ONE_SECOND 3700000
 #define SPIN_WAIT_ONE_MILLISECOND 3700
+#define SOFT_TIMER_NOT_ARMED -1
+
+typedef enum {
+	Soft_Timer_One_Shot,
+	Soft_Timer_Periodic
+} SoftTimerMode;
+
+/*  Software timers are multiplexed on the ARM timer.  A timer is owned by the
+	client, normally as a static, and must stay around while it is armed.  The
+	handler is called from interrupt context so it should be short (post work
+	to the work queue for anything slow).
+*/
+
+typedef struct {
+	void (*handler_ptr)(uint32_t argument);
+	uint32_t argument;
+	SoftTimerMode mode;
+	uint32_t period;  //In microseconds
+	uint64_t deadline;  //On the timer_now_us() time line
+	uint32_t overruns;  //Periods skipped because the handler ran late
+	int32_t heap_index;
+} Soft_Timer;
 
 Error_Returns arm_timer_init(void);
 
+Error_Returns arm_timer_init_soft_timer(Soft_Timer *timer, void (*handler_ptr)(uint32_t argument), uint32_t argument);
+
+Error_Returns arm_timer_start(Soft_Timer *timer, uint32_t time_out, SoftTimerMode mode);
+
+Error_Returns arm_timer_start_us(Soft_Timer *timer, uint32_t microseconds, SoftTimerMode mode);
+
+Error_Returns arm_timer_start_at(Soft_Timer *timer, uint64_t deadline_us);
+
+Error_Returns arm_timer_cancel(Soft_Timer *timer);
+
+uint64_t arm_timer_get_time(void);
+
 Error_Returns arm_timer_enable(void (*handler_ptr)(void), uint32_t time_out);
 
 Error_Returns arm_timer_disable(void);
 
 void arm_timer_dump_registers(void);
 
+void timer_delay_us(uint32_t microseconds);
+
+void timer_delay_until_us(uint64_t deadline);
+
+void timer_delay_ms(uint32_t milliseconds);
+
 void spin_wait(uint32_t spin_count);
 
 void spin_wait_seconds(uint32_t seconds);
@@ -29,6 +29,8 @@ the mini-UART.
 
 extern Error_Returns uart_init(void);
 
+extern void uart_set_rx_handler(void (*handler_ptr)(void));
+
 extern void aux_putchar(uint32_t c);
 
 extern char aux_getchar(void);
@@ -113,13 +113,48 @@ typedef enum {
 typedef enum {
 	pupd_disable,
 	pupd_pull_down,
-	pupd_pull_up
+	pupd_pull_up,
+	pupd_unchanged  //Leave the pull as it is
 } GPIOPullUpPullDown;
 
 typedef enum {
 	event_not_detected,
 	event_detected
 } GPIOEventDetectStatus;
+
+typedef enum {
+	gpio_bank_0,  //Pins 0-31
+	gpio_bank_1,  //Pins 32-53
+	gpio_bank_count
+} GPIOBank;
+
+#define GPIO_GROUP_MAX_PINS 32
+#define GPIO_GROUP_NOT_CONSECUTIVE 0xFF
+
+/*  A set of output pins written (or read) as one value, bit n is the nth pin
+	given to gpio_group_init.  Pins in different banks take a write per bank
+	so only the pins within a bank change at exactly the same time.
+*/
+
+typedef struct {
+	uint32_t mask[gpio_bank_count];
+	unsigned char pins[GPIO_GROUP_MAX_PINS];
+	uint32_t count;
+	GPIOBank bank;  //Where the pins are when they are consecutive
+	uint32_t shift;  //The first pin's bit, or GPIO_GROUP_NOT_CONSECUTIVE
+} GPIO_Pin_Group;
+
+/*  One line of a pin table for gpio_configure, a driver's (or a board's) pins
+	are normally a static const table of these.
+*/
+
+typedef struct {
+	GPIO_Pins pin;
+	GPIOFunction function;
+	GPIOPullUpPullDown pull;
+} GPIO_Pin_Config;
+
+#define GPIO_CONFIG_COUNT(table) (sizeof(table) / sizeof((table)[0]))
 	
 extern Error_Returns gpio_init();
 
@@ -127,14 +162,28 @@ extern Error_Returns gpio_set_function_select(GPIO_Pins pin, GPIOFunction functi
 
 extern void gpio_set_pullup_pulldown(GPIO_Pins pin, GPIOPullUpPullDown function);
 
+extern Error_Returns gpio_configure(const GPIO_Pin_Config *table, uint32_t count);
+
 extern Error_Returns gpio_set_pin(GPIO_Pins pin);
 
 extern Error_Returns gpio_clear_pin(GPIO_Pins pin);
 
 extern Error_Returns gpio_get_level(GPIO_Pins pin, uint32_t *level_value);
 
+extern Error_Returns gpio_write_mask(GPIOBank bank, uint32_t set_mask, uint32_t clear_mask);
+
+extern Error_Returns gpio_read_bank(GPIOBank bank, uint32_t *levels);
+
+extern Error_Returns gpio_group_init(GPIO_Pin_Group *group, const GPIO_Pins *pins, uint32_t count);
+
+extern Error_Returns gpio_group_write(const GPIO_Pin_Group *group, uint32_t value);
+
+extern Error_Returns gpio_group_read(const GPIO_Pin_Group *group, uint32_t *value);
+
 extern Error_Returns gpio_set_high_detect_pin(GPIO_Pins pin);
 
+extern Error_Returns gpio_clear_high_detect_pin(GPIO_Pins pin);
+
 extern Error_Returns gpio_set_low_detect_pin(GPIO_Pins pin);
 
 extern Error_Returns gpio_set_rising_detect_pin(GPIO_Pins pin);
@@ -148,3 +197,7 @@ extern Error_Returns gpio_set_async_falling_detect_pin(GPIO_Pins pin);
 extern GPIOEventDetectStatus gpio_get_event_detect_status(GPIO_Pins pin);
 
 extern Error_Returns gpio_clear_event_detect_status(GPIO_Pins pin);
+
+extern Error_Returns gpio_register_event_callback(GPIO_Pins pin, void (*callback_ptr)(GPIO_Pins pin, uint32_t timestamp));
+
+extern Error_Returns gpio_remove_event_callback(GPIO_Pins pin);
@@ -35,9 +35,23 @@ typedef enum {
 typedef enum {
 	Int_Basic,
 	Int_GPIO_Pin,
-	Int_GPIO_All
+	Int_GPIO_All,
+	Int_Aux,
+	Int_System_Timer_1,
+	Int_System_Timer_3
 } InterruptType;
 
+/*  A handler can be preempted by handlers of a higher priority.  High priority
+	handlers run with CPU interrupts masked so keep them short.
+*/
+
+typedef enum {
+	Int_Priority_High,
+	Int_Priority_Medium,
+	Int_Priority_Low,
+	Int_Priority_Count
+} InterruptPriority;
+
 extern Error_Returns interrupt_handler_init(void);
 
 extern int interrupt_handler_add(InterruptHandlerStatus (*handler_ptr)(void), InterruptType type,
@@ -47,4 +61,12 @@ extern int interrupt_handler_basic_add(InterruptHandlerStatus (*handler_ptr)(voi
 
 extern Error_Returns interrupt_handler_remove(int handler_index);
 
-extern void interrupt_handler_dump_registers(void);
\ No newline at end of file
+extern Error_Returns interrupt_handler_set_priority(int handler_index, InterruptPriority priority);
+
+extern void interrupt_handler_record_timer_latency(uint32_t latency_microseconds);
+
+extern void interrupt_handler_reset_stats(void);
+
+extern void interrupt_handler_dump_stats(void);
+
+extern void interrupt_handler_benchmark_entry(void);
\ No newline at end of file
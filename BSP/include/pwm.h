@@ -0,0 +1,72 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  pwm.h
+
+Interface into the two hardware PWM channels of the Broadcom 2835, for driving
+servos and ESCs straight from the GPIO pins.  Both channels run in mark-space
+mode off one PWM clock from the clock manager, with their own period and pulse
+width.  A channel can also be fed a sequence of pulse widths (one per period)
+by DMA so updates land on exact period boundaries with no CPU involvement.
+
+*/
+
+#pragma once
+#include "common.h"
+#include "gpio.h"
+
+//PLLD (500MHz) divided by 50, so pulse widths have 100ns resolution
+#define PWM_CLOCK_HZ 10000000
+#define PWM_NS_PER_TICK (1000000000 / PWM_CLOCK_HZ)
+#define PWM_TICKS_PER_MICROSECOND (PWM_CLOCK_HZ / 1000000)
+
+/*  Channel 1 comes out on GPIO 12 (ALT0) or GPIO 18 (ALT5), channel 2 on
+	GPIO 13 (ALT0) or GPIO 19 (ALT5).
+*/
+
+typedef enum {
+	pwm_channel_1,
+	pwm_channel_2,
+	pwm_channel_count
+} PWMChannel;
+
+Error_Returns pwm_init(void);
+
+Error_Returns pwm_channel_enable(PWMChannel channel, GPIO_Pins pin, uint32_t period_us);
+
+Error_Returns pwm_channel_disable(PWMChannel channel);
+
+Error_Returns pwm_set_pulse_us(PWMChannel channel, uint32_t pulse_us);
+
+Error_Returns pwm_set_pulse_ns(PWMChannel channel, uint32_t pulse_ns);
+
+/*  Feed a channel from a buffer of pulse widths in PWM clock ticks, one per
+	period, over DMA.  The buffer must stay put until the sequence is done (or
+	stopped), with loop set it is repeated until pwm_dma_stop.  Otherwise the
+	last pulse width is held once the buffer runs out.  Only one channel at a
+	time can be fed this way, the other carries on as normal.
+*/
+
+Error_Returns pwm_dma_start(PWMChannel channel, const uint32_t *pulse_ticks, uint32_t count, uint32_t loop);
+
+Error_Returns pwm_dma_stop(void);
+
+uint32_t pwm_dma_busy(void);
+
+void pwm_dump_registers(void);
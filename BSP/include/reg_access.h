@@ -0,0 +1,45 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  reg_access.h
+
+Every peripheral register access in the BSP goes through REG_READ and
+REG_WRITE.  On the Pi they are plain volatile accesses and compile to exactly
+what the direct access did.  The host build (HOST_BUILD, see host/Makefile)
+routes them to the simulated register file in host/sim instead so the
+behavioural models there can react to them.  The register structures keep
+their real addresses either way, the host build maps the simulated register
+file over the peripheral window.
+
+*/
+
+#pragma once
+#include <stdint.h>
+
+#ifdef HOST_BUILD
+uint32_t reg_sim_read(volatile uint32_t *register_ptr);
+
+void reg_sim_write(volatile uint32_t *register_ptr, uint32_t value);
+
+#define REG_READ(reg) reg_sim_read(&(reg))
+#define REG_WRITE(reg, value) reg_sim_write(&(reg), (uint32_t)(value))
+#else
+#define REG_READ(reg) (reg)
+#define REG_WRITE(reg, value) ((reg) = (value))
+#endif
@@ -43,8 +43,24 @@ Provides base register set definitions for the functions in the Broadcom 2835.
 #define BSC1_BASE	(P_BASE + 0x804000)
 #define BSC2_BASE	(P_BASE + 0x805000)
 
+//System Timer registers
+#define SYSTEM_TIMER_BASE	(P_BASE + 0x3000)
+
 //ARM interrupt register
 #define ARM_INTERRUPTS_BASE	(P_BASE + 0xB200)
 
 //ARM timer register
-#define ARM_TIMER_BASE	(P_BASE + 0xB400)
\ No newline at end of file
+#define ARM_TIMER_BASE	(P_BASE + 0xB400)
+
+//Clock manager, the PWM clock is at 0xA0 (it isn't in the peripherals document)
+#define CM_BASE	(P_BASE + 0x101000)
+
+//PWM registers
+#define PWM_BASE	(P_BASE + 0x20C000)
+
+//DMA controller, channels 0-14 are 0x100 apart
+#define DMA_BASE	(P_BASE + 0x7000)
+
+//Where the DMA engine sees the peripherals, and RAM through the L2 cache
+#define BUS_PERIPHERAL_BASE	0x7E000000
+#define BUS_RAM_ALIAS		0x40000000
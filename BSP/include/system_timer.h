@@ -0,0 +1,48 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  system_timer.h
+
+Interface into the Broadcom 2835 System Timer, a free running 64 bit counter
+clocked at 1 MHz that isn't affected by changes to the ARM or core clocks.  Also
+gives one shot deadlines on the two compare channels the GPU leaves for the ARM.
+
+*/
+
+#pragma once
+#include "common.h"
+
+//Channels 0 and 2 are used by the GPU
+typedef enum {
+	system_timer_channel_1 = 1,
+	system_timer_channel_3 = 3
+} SystemTimerChannel;
+
+Error_Returns system_timer_init(void);
+
+uint64_t timer_now_us(void);
+
+uint64_t timer_deadline_us(uint32_t microseconds);
+
+uint32_t timer_deadline_reached(uint64_t deadline_us);
+
+Error_Returns system_timer_set_one_shot(SystemTimerChannel channel, uint64_t deadline_us,
+		void (*handler_ptr)(uint32_t argument), uint32_t argument);
+
+Error_Returns system_timer_cancel(SystemTimerChannel channel);
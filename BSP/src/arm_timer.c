@@ -25,8 +25,10 @@ Provides ARM timer support using the Broadcom 2835.
 
 #include "common.h"
 #include "reg_definitions.h"
+#include "reg_access.h"
 #include "arm_timer.h"
 #include "interrupt_handler.h"
+#include "system_timer.h"
 #include "log.h"
 
 typedef struct {
@@ -45,74 +47,369 @@ typedef struct {
 #define PRE_DIVIDER_VALUE 249 //The chip clocks on pre_divider + 1, we want 250 so set it to 249
 #define DIVIDED_CLOCK_SPEED (CORE_CLOCK_SPEED / (PRE_DIVIDER_VALUE + 1))
 #define CLOCKS_PER_MILLISECOND (DIVIDED_CLOCK_SPEED/1000)
+#define CLOCKS_PER_MICROSECOND (DIVIDED_CLOCK_SPEED/1000000)
 #define ARM_TIMER_INTERRUPT_ACTIVE 1
 #define ARM_TIMER_CLEAR_INTERRUPT 0
 #define ARM_TIMER_ENABLE 7
 #define ARM_TIMER_INTERRUPT_ENABLE 5
 #define ARM_TIMER_32_BIT_COUNTER 1
+#define ARM_TIMER_MAX_LOAD 0xFFFFFFFF
+#define ARM_TIMER_MIN_LOAD 2  //Don't program a deadline that has already gone by
+#define ARM_TIMER_RUNNING ((1 << ARM_TIMER_ENABLE) | (1 << ARM_TIMER_INTERRUPT_ENABLE) | (1 << ARM_TIMER_32_BIT_COUNTER))
+#define MAX_SOFT_TIMERS 16
+#define TIMER_DELAY_SPIN_LIMIT 50  //In microseconds, shorter delays aren't worth a sleep
+#define CPSR_IRQ_MASKED 0x80
 
-static void (*timer_handler_ptr)(void); //We handle one client at a time
+/*  Tickless operation:  the ARM timer is only an alarm, it is loaded with the
+	time to the nearest software timer deadline and stopped altogether when no
+	timer is armed.  Deadlines are kept in microseconds on the System Timer time
+	line, which is never reloaded, so reprogramming the ARM timer as often as we
+	like doesn't lose any time.  Should the core clock (and so the ARM timer)
+	run fast the alarm just goes off early, nothing is due and it is reloaded.
+*/
+
+static Soft_Timer *timer_heap[MAX_SOFT_TIMERS];  //Min heap on deadline
+static uint32_t timer_heap_count = 0;
+
+static void (*timer_handler_ptr)(void); //The arm_timer_enable client
+static Soft_Timer enable_timer;
+static Soft_Timer delay_timer;  //Only here to wake timer_delay_us up
 static unsigned char arm_timer_initialized = 0;
 static int interrupt_handler_index = 0;
 
 static volatile ARM_Timer_Registers *arm_timer_registers = (ARM_Timer_Registers *)ARM_TIMER_BASE;
 
-void arm_timer_dump_registers(void)
+COLD void arm_timer_dump_registers(void)
+{
+	log_string_plus("load: ", REG_READ(arm_timer_registers->load));
+	log_string_plus("value: ", REG_READ(arm_timer_registers->value));
+	log_string_plus("control: ", REG_READ(arm_timer_registers->control));
+	log_string_plus("raw_irq: ", REG_READ(arm_timer_registers->raw_irq));
+	log_string_plus("masked_irq: ", REG_READ(arm_timer_registers->masked_irq));
+	log_string_plus("reload: ", REG_READ(arm_timer_registers->reload));
+	log_string_plus("predivider: ", REG_READ(arm_timer_registers->predivider));
+	log_string_plus("free_running_counter: ", REG_READ(arm_timer_registers->free_running_counter));
+	log_string_plus("soft timers armed: ", timer_heap_count);
+}
+
+HOT static void arm_timer_heap_swap(uint32_t first, uint32_t second)
+{
+	Soft_Timer *temp = timer_heap[first];
+	timer_heap[first] = timer_heap[second];
+	timer_heap[second] = temp;
+	timer_heap[first]->heap_index = first;
+	timer_heap[second]->heap_index = second;
+}
+
+HOT static void arm_timer_heap_up(uint32_t index)
+{
+	while (index > 0)
+	{
+		uint32_t parent = (index - 1) / 2;
+		if (timer_heap[parent]->deadline <= timer_heap[index]->deadline)
+		{
+			break;
+		}
+		arm_timer_heap_swap(parent, index);
+		index = parent;
+	}
+}
+
+HOT static void arm_timer_heap_down(uint32_t index)
+{
+	for (;;)
+	{
+		uint32_t smallest = index;
+		uint32_t left = (2 * index) + 1;
+		uint32_t right = left + 1;
+		if ((left < timer_heap_count) && (timer_heap[left]->deadline < timer_heap[smallest]->deadline))
+		{
+			smallest = left;
+		}
+		if ((right < timer_heap_count) && (timer_heap[right]->deadline < timer_heap[smallest]->deadline))
+		{
+			smallest = right;
+		}
+		if (smallest == index)
+		{
+			break;
+		}
+		arm_timer_heap_swap(index, smallest);
+		index = smallest;
+	}
+}
+
+HOT static void arm_timer_heap_insert(Soft_Timer *timer)
+{
+	timer->heap_index = timer_heap_count;
+	timer_heap[timer_heap_count++] = timer;
+	arm_timer_heap_up(timer->heap_index);
+}
+
+HOT static void arm_timer_heap_remove(Soft_Timer *timer)
+{
+	uint32_t index = timer->heap_index;
+	timer_heap_count--;
+	if (index != timer_heap_count)
+	{
+		timer_heap[index] = timer_heap[timer_heap_count];
+		timer_heap[index]->heap_index = index;
+		arm_timer_heap_up(index);
+		arm_timer_heap_down(timer_heap[index]->heap_index);
+	}
+	timer->heap_index = SOFT_TIMER_NOT_ARMED;
+}
+
+//Interrupts must be masked when these are called
+
+HOT static void arm_timer_program_locked(void)
 {
-	log_string_plus("load: ", arm_timer_registers->load);
-	log_string_plus("value: ", arm_timer_registers->value);
-	log_string_plus("control: ", arm_timer_registers->control);
-	log_string_plus("raw_irq: ", arm_timer_registers->raw_irq);
-	log_string_plus("masked_irq: ", arm_timer_registers->masked_irq);
-	log_string_plus("reload: ", arm_timer_registers->reload);
-	log_string_plus("predivider: ", arm_timer_registers->predivider);
-	log_string_plus("free_running_counter: ", arm_timer_registers->free_running_counter);
+	REG_WRITE(arm_timer_registers->irq_clear_ack, ARM_TIMER_CLEAR_INTERRUPT);
+	if (timer_heap_count != 0)
+	{
+		uint64_t now = timer_now_us();
+		uint64_t deadline = timer_heap[0]->deadline;
+		uint32_t load = ARM_TIMER_MAX_LOAD;
+		if (deadline < now + ARM_TIMER_MIN_LOAD)
+		{
+			load = ARM_TIMER_MIN_LOAD;
+		}
+		else if ((deadline - now) < (ARM_TIMER_MAX_LOAD / CLOCKS_PER_MICROSECOND))
+		{
+			load = (uint32_t)(deadline - now) * CLOCKS_PER_MICROSECOND;
+		}
+		REG_WRITE(arm_timer_registers->load, load);
+		REG_WRITE(arm_timer_registers->control, REG_READ(arm_timer_registers->control) | ARM_TIMER_RUNNING);
+	}
+	else
+	{
+		REG_WRITE(arm_timer_registers->control, REG_READ(arm_timer_registers->control) & ~((1 << ARM_TIMER_ENABLE) | (1 << ARM_TIMER_INTERRUPT_ENABLE)));
+	}
 }
 
 /*  When the ARM timer interrupts the CPU the interrupt handler will call 
-    this routine, which in turn will notify the client of the timeout.  If
-	the ARM timer didn't interrupt we will return unclaimed to the interrupt
-	handler.
+    this routine, which runs every software timer that is due and programs
+	the timer for the next deadline.  If the ARM timer didn't interrupt we will
+	return unclaimed to the interrupt handler.
 */
 
-InterruptHandlerStatus arm_timer_interrupt_handler(void)
+HOT InterruptHandlerStatus arm_timer_interrupt_handler(void)
 {
 	InterruptHandlerStatus to_return = Interrupt_Not_Claimed;
-	if (arm_timer_registers->masked_irq & ARM_TIMER_INTERRUPT_ACTIVE)
+	if (REG_READ(arm_timer_registers->masked_irq) & ARM_TIMER_INTERRUPT_ACTIVE)
 	{
-		if (timer_handler_ptr != NULL_PTR)
+		uint32_t saved_cpsr = enter_critical_section();
+		uint64_t now = timer_now_us();
+		//Entry latency for the profiler, how late the earliest deadline is being run
+		if ((timer_heap_count != 0) && (timer_heap[0]->deadline <= now))
 		{
-			timer_handler_ptr();
-			arm_timer_registers->irq_clear_ack = ARM_TIMER_CLEAR_INTERRUPT;
-			to_return = Interrupt_Claimed;
+			interrupt_handler_record_timer_latency((uint32_t)(now - timer_heap[0]->deadline));
 		}
+		while ((timer_heap_count != 0) && (timer_heap[0]->deadline <= now))
+		{
+			Soft_Timer *timer = timer_heap[0];
+			arm_timer_heap_remove(timer);
+			if (timer->mode == Soft_Timer_Periodic)
+			{
+				//Step on from the old deadline, not from now, so the period doesn't drift
+				timer->deadline += timer->period;
+				while (timer->deadline <= now)
+				{
+					timer->deadline += timer->period;
+					timer->overruns++;
+				}
+				arm_timer_heap_insert(timer);
+			}
+			//The handler may start or cancel timers (itself included)
+			exit_critical_section(saved_cpsr);
+			timer->handler_ptr(timer->argument);
+			saved_cpsr = enter_critical_section();
+			now = timer_now_us();
+		}
+		arm_timer_program_locked();
+		exit_critical_section(saved_cpsr);
+		to_return = Interrupt_Claimed;
 	}
 	return to_return;
 }
 
+static void arm_timer_delay_wakeup(uint32_t argument)
+{
+}
+
 /* Initialize the interrupt handler and set up some basic housekeeping stuff. */
 
-Error_Returns arm_timer_init(void)
+COLD Error_Returns arm_timer_init(void)
 {
 	Error_Returns to_return = RPi_Success;
 	if (!arm_timer_initialized)
 	{
-		to_return = interrupt_handler_init();
-		if (to_return != RPi_Success)
+		do
 		{
-			log_string_plus("Failed interrupt_handler_init, status: ", to_return);
-			log_indicate_system_error();
-		}
-		timer_handler_ptr = NULL_PTR;
-		arm_timer_registers->predivider = PRE_DIVIDER_VALUE;
-		interrupt_handler_index = -1;
-		arm_timer_initialized = 1;
+			to_return = interrupt_handler_init();
+			if (to_return != RPi_Success)
+			{
+				log_string_plus("Failed interrupt_handler_init, status: ", to_return);
+				log_indicate_system_error();
+			}
+			timer_handler_ptr = NULL_PTR;
+			timer_heap_count = 0;
+			arm_timer_init_soft_timer(&delay_timer, arm_timer_delay_wakeup, 0);
+			interrupt_handler_index = interrupt_handler_basic_add(arm_timer_interrupt_handler);
+			if (interrupt_handler_index == -1)
+			{
+				to_return = RPi_OperationFailed;
+				break;
+			}
+
+			//Left stopped until a software timer is started
+			REG_WRITE(arm_timer_registers->control, REG_READ(arm_timer_registers->control) & ~((1 << ARM_TIMER_ENABLE) | (1 << ARM_TIMER_INTERRUPT_ENABLE)));
+			REG_WRITE(arm_timer_registers->predivider, PRE_DIVIDER_VALUE);
+			REG_WRITE(arm_timer_registers->reload, ARM_TIMER_MAX_LOAD);
+			REG_WRITE(arm_timer_registers->irq_clear_ack, ARM_TIMER_CLEAR_INTERRUPT);
+			arm_timer_initialized = 1;
+		} while(0);
 	}	
 	return to_return;
 }
 
+Error_Returns arm_timer_init_soft_timer(Soft_Timer *timer, void (*handler_ptr)(uint32_t argument), uint32_t argument)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((timer != NULL_PTR) && (handler_ptr != NULL_PTR))
+	{
+		timer->handler_ptr = handler_ptr;
+		timer->argument = argument;
+		timer->mode = Soft_Timer_One_Shot;
+		timer->period = 0;
+		timer->deadline = 0;
+		timer->overruns = 0;
+		timer->heap_index = SOFT_TIMER_NOT_ARMED;
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
+/*  Arm a timer for an absolute deadline on the timer_now_us() time line.  A
+	periodic timer then repeats every period microseconds from that deadline.
+*/
+
+HOT static Error_Returns arm_timer_start_locked(Soft_Timer *timer, uint64_t deadline_us, uint32_t period, SoftTimerMode mode)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (!arm_timer_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((timer == NULL_PTR) || (timer->handler_ptr == NULL_PTR) ||
+			((mode == Soft_Timer_Periodic) && (period == 0)))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		if (timer->heap_index != SOFT_TIMER_NOT_ARMED)
+		{
+			arm_timer_heap_remove(timer);
+		}
+		else if (timer_heap_count >= MAX_SOFT_TIMERS)
+		{
+			to_return = RPi_InsufficientResources;
+			break;
+		}
+		timer->mode = mode;
+		timer->period = period;
+		timer->deadline = deadline_us;
+		timer->overruns = 0;
+		arm_timer_heap_insert(timer);
+		if (timer_heap[0] == timer)
+		{
+			arm_timer_program_locked();
+		}
+	} while(0);
+	return to_return;
+}
+
+/*  Start (or restart) a software timer.  The time out is in microseconds and
+	is both the first delay and, for a periodic timer, the period.  The handler
+	is called from interrupt context.
+*/
+
+Error_Returns arm_timer_start_us(Soft_Timer *timer, uint32_t microseconds, SoftTimerMode mode)
+{
+	Error_Returns to_return = RPi_InvalidParam;
+	if (microseconds != 0)
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		to_return = arm_timer_start_locked(timer, timer_now_us() + microseconds, microseconds, mode);
+		exit_critical_section(saved_cpsr);
+	}
+	return to_return;
+}
+
+//As arm_timer_start_us but the time out is in milliseconds, up to UINT32_MAX microseconds
+Error_Returns arm_timer_start(Soft_Timer *timer, uint32_t time_out, SoftTimerMode mode)
+{
+	Error_Returns to_return = RPi_InvalidParam;
+	if (time_out <= (UINT32_MAX / 1000))
+	{
+		to_return = arm_timer_start_us(timer, time_out * 1000, mode);
+	}
+	return to_return;
+}
+
+//One shot at an absolute time from timer_now_us(), if it has gone by it fires straight away
+HOT Error_Returns arm_timer_start_at(Soft_Timer *timer, uint64_t deadline_us)
+{
+	uint32_t saved_cpsr = enter_critical_section();
+	Error_Returns to_return = arm_timer_start_locked(timer, deadline_us, 0, Soft_Timer_One_Shot);
+	exit_critical_section(saved_cpsr);
+	return to_return;
+}
+
+Error_Returns arm_timer_cancel(Soft_Timer *timer)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t saved_cpsr = enter_critical_section();
+	if ((timer != NULL_PTR) && (timer->heap_index != SOFT_TIMER_NOT_ARMED))
+	{
+		arm_timer_heap_remove(timer);
+		if (timer_heap_count == 0)
+		{
+			arm_timer_program_locked();
+		}
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	exit_critical_section(saved_cpsr);
+	return to_return;
+}
+
+//The time line the software timer deadlines are on, in microseconds
+uint64_t arm_timer_get_time(void)
+{
+	return timer_now_us();
+}
+
+static void arm_timer_enable_handler(uint32_t argument)
+{
+	if (timer_handler_ptr != NULL_PTR)
+	{
+		timer_handler_ptr();
+	}
+}
+
 /*  A client uses this function to set up a recurring tick timer.  The time out
-	is in milliseconds.  Note:  Only one client can be using the timer at a time.
+	is in milliseconds.  Note:  This is a wrapper on a single software timer so
+	only one client can use it at a time, everyone else should use their own
+	Soft_Timer.
 */
 
 Error_Returns arm_timer_enable(void (*handler_ptr)(void), uint32_t time_out)
@@ -130,19 +427,13 @@ Error_Returns arm_timer_enable(void (*handler_ptr)(void), uint32_t time_out)
 			to_return = RPi_InUse;
 			break;
 		}
-		interrupt_handler_index = interrupt_handler_basic_add(arm_timer_interrupt_handler);
-		if (interrupt_handler_index == -1)
+		timer_handler_ptr = handler_ptr;
+		arm_timer_init_soft_timer(&enable_timer, arm_timer_enable_handler, 0);
+		to_return = arm_timer_start(&enable_timer, time_out, Soft_Timer_Periodic);
+		if (to_return != RPi_Success)
 		{
-			to_return = RPi_OperationFailed;
-			break;
+			timer_handler_ptr = NULL_PTR;
 		}
-
-		timer_handler_ptr = handler_ptr;
-		uint32_t counter_load_value = CLOCKS_PER_MILLISECOND * time_out;
-		arm_timer_registers->load = counter_load_value;
-		arm_timer_registers->reload = counter_load_value;
-		arm_timer_registers->control |= (1 << ARM_TIMER_ENABLE) | (1 << ARM_TIMER_INTERRUPT_ENABLE) | (1 << ARM_TIMER_32_BIT_COUNTER);
-		
 	} while(0);
 	return to_return;
 }
@@ -155,36 +446,91 @@ Error_Returns arm_timer_disable(void)
 	Error_Returns to_return = RPi_Success;
 	do
 	{
-		if ((!arm_timer_initialized) || (timer_handler_ptr == NULL_PTR) || (interrupt_handler_index == -1))
+		if ((!arm_timer_initialized) || (timer_handler_ptr == NULL_PTR))
 		{
 			to_return = RPi_NotInitialized;
 			break;
 		}
 		
-		arm_timer_registers->control &= ~((1 << ARM_TIMER_ENABLE) | (1 << ARM_TIMER_INTERRUPT_ENABLE));
+		arm_timer_cancel(&enable_timer);
 		timer_handler_ptr = NULL_PTR;
-		
-		Error_Returns status = interrupt_handler_remove(interrupt_handler_index);
-		if (status != RPi_Success)
-		{
-			to_return = RPi_OperationFailed;
-		}
-
 	} while(0);
 	return to_return;
 }
 
 
+/*  Delay against the System Timer so the time is right whatever the clocks and
+	caches are doing.  Short delays just poll it, longer ones sleep with WFI and
+	a software timer to wake us at the deadline (any other interrupt wakes us
+	too, we just go back to sleep).  If the ARM timer isn't running or IRQs are
+	masked there's nothing to wake us so poll instead.  Not for use from
+	interrupt handlers.
+*/
+
+void timer_delay_us(uint32_t microseconds)
+{
+	timer_delay_until_us(timer_deadline_us(microseconds));
+}
+
+/*  As timer_delay_us but to an absolute time on the timer_now_us() time line.
+	The time is read once, a deadline that has already gone by (an interrupt
+	came in after the caller worked it out) returns straight away rather than
+	underflowing into a very long delay.
+*/
+
+void timer_delay_until_us(uint64_t deadline)
+{
+	uint64_t now = timer_now_us();
+	if (now < deadline)
+	{
+		if (((deadline - now) < TIMER_DELAY_SPIN_LIMIT) || !arm_timer_initialized ||
+			(get_cpsr() & CPSR_IRQ_MASKED) ||
+			(arm_timer_start_at(&delay_timer, deadline) != RPi_Success))
+		{
+			while (!timer_deadline_reached(deadline));
+		}
+		else
+		{
+			for (;;)
+			{
+				//Masked so an interrupt between the check and the WFI can't be slept through
+				uint32_t saved_cpsr = enter_critical_section();
+				if (timer_deadline_reached(deadline))
+				{
+					exit_critical_section(saved_cpsr);
+					break;
+				}
+				wait_for_interrupt();
+				exit_critical_section(saved_cpsr);
+			}
+			arm_timer_cancel(&delay_timer);
+		}
+	}
+}
+
+void timer_delay_ms(uint32_t milliseconds)
+{
+	//A second at a time keeps the microseconds inside 32 bits
+	while (milliseconds > 0)
+	{
+		uint32_t chunk = (milliseconds > 1000) ? 1000 : milliseconds;
+		timer_delay_us(chunk * 1000);
+		milliseconds -= chunk;
+	}
+}
+
 void spin_wait(uint32_t spin_count)
 {
 	for(uint32_t counter = 0; counter < spin_count; counter++) dummy(counter);
 }
 
+//Kept for older callers, these are now timer backed rather than counted spins
+
 void spin_wait_seconds(uint32_t seconds)
 {
-	for(uint32_t counter = 0; counter < seconds; counter++) spin_wait(SPIN_WAIT_ONE_SECOND);
+	for(uint32_t counter = 0; counter < seconds; counter++) timer_delay_ms(1000);
 }
 
 void spin_wait_milliseconds(uint32_t milliseconds){
-	for(uint32_t counter = 0; counter < milliseconds; counter++) spin_wait(SPIN_WAIT_ONE_MILLISECOND);
-}
\ No newline at end of file
+	timer_delay_ms(milliseconds);
+}
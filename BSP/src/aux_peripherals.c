@@ -29,6 +29,7 @@ relieving a client from having to poll for characters.
 */
 
 #include "reg_definitions.h"
+#include "reg_access.h"
 #include "gpio.h"
 #include "aux_peripherals.h"
 #include "interrupt_handler.h"
@@ -90,26 +91,37 @@ static volatile Aux_Peripherals_Registers *aux_perihperals_registers = (Aux_Peri
 
 static char rx_buffer[UART_RX_BUFFER_SIZE] = {0};
 
+//TXD1 and RXD1, the pulls are left as the firmware set them
+static const GPIO_Pin_Config uart_pins[] = {
+	{gpio_pin_14, gpio_alt_5, pupd_unchanged},
+	{gpio_pin_15, gpio_alt_5, pupd_unchanged}
+};
+static void (*rx_handler_ptr)(void) = NULL_PTR;
+
 
 /*  Receive a character and stuff it into the RX buffer.  This isn't set up
 	to handle intensive transfers, just the occasional typed command character.
 	This is a circular buffer so characters can be lost.
 */
 
-InterruptHandlerStatus uart_char_interrupt_handler(void)
+HOT InterruptHandlerStatus uart_char_interrupt_handler(void)
 {
 	InterruptHandlerStatus to_return = Interrupt_Not_Claimed;
 	if (uart_ready)
 	{
-		if ((aux_perihperals_registers->aux_irq & AUX_UART_IRQ_ACTIVE) &&
-			(aux_perihperals_registers->aux_mu_ier_reg & UART_READ_INTERRUPT))
+		if ((REG_READ(aux_perihperals_registers->aux_irq) & AUX_UART_IRQ_ACTIVE) &&
+			(REG_READ(aux_perihperals_registers->aux_mu_ier_reg) & UART_READ_INTERRUPT))
 		{
-			while (aux_perihperals_registers->aux_mu_lsr_reg & UART_DATA_RX_READY)
+			while (REG_READ(aux_perihperals_registers->aux_mu_lsr_reg) & UART_DATA_RX_READY)
 			{
-				rx_buffer[write_index] = aux_perihperals_registers->aux_mu_io_reg & UART_RX_MASK;
+				rx_buffer[write_index] = REG_READ(aux_perihperals_registers->aux_mu_io_reg) & UART_RX_MASK;
 				write_index++;
 				write_index = write_index % UART_RX_BUFFER_SIZE;
 			}
+			if (rx_handler_ptr != NULL_PTR)
+			{
+				rx_handler_ptr();
+			}
 			to_return = Interrupt_Claimed;
 		}
 	}
@@ -120,7 +132,7 @@ InterruptHandlerStatus uart_char_interrupt_handler(void)
 	interrupt on character receive.
 */
 
-Error_Returns uart_init()
+COLD Error_Returns uart_init()
 {
 	Error_Returns to_return = RPi_Success;
 	if (uart_ready == 0)
@@ -134,47 +146,56 @@ Error_Returns uart_init()
 				log_indicate_system_error();
 			}
 			
-			to_return = interrupt_handler_basic_add(uart_char_interrupt_handler);
+			//Receive is at the top priority so characters aren't lost behind long handlers
+			int handler_index = interrupt_handler_add(uart_char_interrupt_handler, Int_Aux, gpio_pin_0);
 			
-			if (to_return != RPi_Success)
+			if ((handler_index < 0) ||
+				(interrupt_handler_set_priority(handler_index, Int_Priority_High) != RPi_Success))
 			{
 				log_indicate_system_error();
 			}
 			
-			aux_perihperals_registers->aux_enables = ENABLE_UART;
-			aux_perihperals_registers->aux_mu_ier_reg = IER_ENABLE_RX_INTERRUPT; 
-			aux_perihperals_registers->aux_mu_cntl_reg = DISABLE_TX_RX;
-			aux_perihperals_registers->aux_mu_lcr_reg = LCR_ENABLE_EIGHT_BIT; 
-			aux_perihperals_registers->aux_mu_mcr_reg = MCR_SET_RTS_LOW; 
-			aux_perihperals_registers->aux_mu_iir_reg = IIR__CLEAR_FIFOS;
-			aux_perihperals_registers->aux_mu_baud_reg = BAUD_RATE;
-			to_return = gpio_set_function_select(gpio_pin_14, gpio_alt_5);
+			REG_WRITE(aux_perihperals_registers->aux_enables, ENABLE_UART);
+			REG_WRITE(aux_perihperals_registers->aux_mu_ier_reg, IER_ENABLE_RX_INTERRUPT);
+			REG_WRITE(aux_perihperals_registers->aux_mu_cntl_reg, DISABLE_TX_RX);
+			REG_WRITE(aux_perihperals_registers->aux_mu_lcr_reg, LCR_ENABLE_EIGHT_BIT);
+			REG_WRITE(aux_perihperals_registers->aux_mu_mcr_reg, MCR_SET_RTS_LOW);
+			REG_WRITE(aux_perihperals_registers->aux_mu_iir_reg, IIR__CLEAR_FIFOS);
+			REG_WRITE(aux_perihperals_registers->aux_mu_baud_reg, BAUD_RATE);
+			to_return = gpio_configure(uart_pins, GPIO_CONFIG_COUNT(uart_pins));
 			if (to_return != RPi_Success)
 			{
-				log_string_plus("uart_init:  failed to set up pin ", gpio_pin_14);
-				break;
-			}
-			to_return = gpio_set_function_select(gpio_pin_15, gpio_alt_5);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("uart_init:  failed to set up pin ", gpio_pin_15);
+				log_string_plus("uart_init:  failed to set up pins, status: ", to_return);
 				break;
 			}
 
-			aux_perihperals_registers->aux_mu_cntl_reg = CNTL_TX_RX_ENABLE;
+			REG_WRITE(aux_perihperals_registers->aux_mu_cntl_reg, CNTL_TX_RX_ENABLE);
 			uart_ready = 1;
 		} while(0);
 	} 
 	return to_return;
 }
 
+/*  Register a function to be called from the receive interrupt handler once
+	the received characters are in the buffer.  It runs in interrupt context so
+	it should do no more than signal whoever reads the buffer.  Pass NULL_PTR
+	to remove it.
+*/
+
+void uart_set_rx_handler(void (*handler_ptr)(void))
+{
+	uint32_t saved_cpsr = enter_critical_section();
+	rx_handler_ptr = handler_ptr;
+	exit_critical_section(saved_cpsr);
+}
+
 void aux_putchar(uint32_t c)
 {
     while(1)
     {
-		if(aux_perihperals_registers->aux_mu_lsr_reg & UART_TX_IDLE) break;
+		if(REG_READ(aux_perihperals_registers->aux_mu_lsr_reg) & UART_TX_IDLE) break;
     }
-    aux_perihperals_registers->aux_mu_io_reg = c;
+    REG_WRITE(aux_perihperals_registers->aux_mu_io_reg, c);
 }
 
 /*  Get a character, there is the possibilty of an interrupt occurring at just
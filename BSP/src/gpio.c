@@ -28,9 +28,11 @@ the Raspberry Pi header.
 
 #include "common.h"
 #include "reg_definitions.h"
+#include "reg_access.h"
 #include "gpio.h"
 #include "log.h"
 #include "arm_timer.h"
+#include "interrupt_handler.h"
 
 #define GPIO_PIN_COUNT 54
 #define ALL_FUNCTION_BITS 7
@@ -75,8 +77,16 @@ typedef struct {
 static volatile GPIO_Registers *gpio_registers = (GPIO_Registers *)GPIO_BASE;
 static GPIOFunction pin_direction_array[GPIO_PIN_COUNT];
 static uint32_t pin_in_use_array[GPIO_ENABLE_ARRAY_SIZE];
+static uint32_t pin_output_mask[GPIO_ENABLE_ARRAY_SIZE];  //Pins set to gpio_output, for the bank writes
 static uint32_t gpio_initialized = 0;
 
+/*  GPIO event demultiplexer.  One interrupt handler per bank reads the event
+	status once and calls the callback of each pin with an event.
+*/
+static void (*event_callback_array[GPIO_PIN_COUNT])(GPIO_Pins pin, uint32_t timestamp);
+static uint32_t event_callback_pins[GPIO_ENABLE_ARRAY_SIZE];
+static int bank_handler_index[GPIO_ENABLE_ARRAY_SIZE];
+
 static Error_Returns gpio_set_detect_register(char *error_string, volatile uint32_t *register_array, GPIO_Pins pin)
 {
 	Error_Returns to_return = RPi_Success;
@@ -87,7 +97,32 @@ static Error_Returns gpio_set_detect_register(char *error_string, volatile uint3
 		{
 			uint32_t index = pin / ENABLE_PINS_PER_REGISTER;
 			uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
-			register_array[index] |= (1 << pin_index);
+			REG_WRITE(register_array[index], REG_READ(register_array[index]) | (1 << pin_index));
+		}
+		else
+		{
+			log_string_plus(error_string, pin);
+			to_return = RPi_InvalidParam;
+		}
+	}
+	else
+	{
+		to_return = RPi_NotInitialized;
+	}
+	return to_return;
+}
+
+static Error_Returns gpio_clear_detect_register(char *error_string, volatile uint32_t *register_array, GPIO_Pins pin)
+{
+	Error_Returns to_return = RPi_Success;
+
+	if (gpio_initialized)
+	{
+		if (pin_direction_array[pin] == gpio_input)
+		{
+			uint32_t index = pin / ENABLE_PINS_PER_REGISTER;
+			uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
+			REG_WRITE(register_array[index], REG_READ(register_array[index]) & ~(1 << pin_index));
 		}
 		else
 		{
@@ -102,7 +137,7 @@ static Error_Returns gpio_set_detect_register(char *error_string, volatile uint3
 	return to_return;
 }
 
-Error_Returns gpio_init()
+COLD Error_Returns gpio_init()
 {
 	Error_Returns to_return = RPi_Success;
 	if (!gpio_initialized)
@@ -114,6 +149,13 @@ Error_Returns gpio_init()
 		for (uint32_t index = 0; index < GPIO_ENABLE_ARRAY_SIZE; index++)
 		{
 			pin_in_use_array[index] = 0;
+			pin_output_mask[index] = 0;
+			event_callback_pins[index] = 0;
+			bank_handler_index[index] = -1;
+		}
+		for (uint32_t index = 0; index < GPIO_PIN_COUNT; index++)
+		{
+			event_callback_array[index] = NULL_PTR;
 		}
 		gpio_initialized = 1;
 	}
@@ -133,10 +175,14 @@ Error_Returns gpio_set_function_select(GPIO_Pins pin, GPIOFunction function)
 			uint32_t register_index = pin / FUNCTION_SELECT_PINS_PER_REGISTER;
 			uint32_t pin_index = (pin % FUNCTION_SELECT_PINS_PER_REGISTER) * BITS_PER_FUNCTION_SELECT;
 			//Clear the bits at the appropriate location
-			gpio_registers->gpio_function_select[register_index] &= ~(ALL_FUNCTION_BITS << pin_index); 
+			REG_WRITE(gpio_registers->gpio_function_select[register_index], REG_READ(gpio_registers->gpio_function_select[register_index]) & ~(ALL_FUNCTION_BITS << pin_index));
 			//Set the appropriate bits
-			gpio_registers->gpio_function_select[register_index] |= (function << pin_index); 
+			REG_WRITE(gpio_registers->gpio_function_select[register_index], REG_READ(gpio_registers->gpio_function_select[register_index]) | (function << pin_index));
 			pin_in_use_array[in_use_index] |= (1 << in_use_pin_index);
+			if (function == gpio_output)
+			{
+				pin_output_mask[in_use_index] |= (1 << in_use_pin_index);
+			}
 			pin_direction_array[pin] = function;
 		}
 		else
@@ -152,17 +198,133 @@ Error_Returns gpio_set_function_select(GPIO_Pins pin, GPIOFunction function)
 	return to_return;
 }
 
+/*  The pull is latched into every pin whose GPPUDCLK bit is clocked while
+	GPPUD holds it, so one sequence (with its two 150 cycle waits) sets the
+	pull of any number of pins in both banks.
+*/
+
+static void gpio_program_pulls(GPIOPullUpPullDown function, const uint32_t *pin_masks)
+{
+	if ((pin_masks[0] | pin_masks[1]) != 0)
+	{
+		REG_WRITE(gpio_registers->gpio_pull_up_pull_down_enable, function);
+		spin_wait(GPIO_PUPD_SPIN_WAIT);
+		for (uint32_t index = 0; index < GPIO_ENABLE_ARRAY_SIZE; index++)
+		{
+			if (pin_masks[index] != 0)
+			{
+				REG_WRITE(gpio_registers->gpio_pull_up_pull_down_clock[index], pin_masks[index]);
+			}
+		}
+		spin_wait(GPIO_PUPD_SPIN_WAIT);
+		REG_WRITE(gpio_registers->gpio_pull_up_pull_down_enable, 0);
+		for (uint32_t index = 0; index < GPIO_ENABLE_ARRAY_SIZE; index++)
+		{
+			if (pin_masks[index] != 0)
+			{
+				REG_WRITE(gpio_registers->gpio_pull_up_pull_down_clock[index], 0);
+			}
+		}
+	}
+}
+
 void gpio_set_pullup_pulldown(GPIO_Pins pin, GPIOPullUpPullDown function)
 {
-	uint32_t register_index = pin / ENABLE_PINS_PER_REGISTER;
-	uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
-
-	gpio_registers->gpio_pull_up_pull_down_enable = function;
-	spin_wait(GPIO_PUPD_SPIN_WAIT);
-	gpio_registers->gpio_pull_up_pull_down_clock[register_index] =  1 << pin_index;
-	spin_wait(GPIO_PUPD_SPIN_WAIT);
-	gpio_registers->gpio_pull_up_pull_down_enable = 0;
-	gpio_registers->gpio_pull_up_pull_down_clock[register_index] =  0;	
+	uint32_t pin_masks[GPIO_ENABLE_ARRAY_SIZE] = {0, 0};
+	if (function != pupd_unchanged)
+	{
+		pin_masks[pin / ENABLE_PINS_PER_REGISTER] = 1 << (pin % ENABLE_PINS_PER_REGISTER);
+		gpio_program_pulls(function, pin_masks);
+	}
+}
+
+/*  Set up a table of pins in one go.  The table is checked first, if any pin
+	is bad or already in use nothing is changed.  Then each function select
+	register the table touches gets one read-modify-write and each pull type
+	one GPPUD/GPPUDCLK sequence, instead of one of each per pin.
+*/
+
+COLD Error_Returns gpio_configure(const GPIO_Pin_Config *table, uint32_t count)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t table_pins[GPIO_ENABLE_ARRAY_SIZE] = {0, 0};
+	uint32_t function_clear[GPIO_FUNCTION_SELECT_SIZE] = {0};
+	uint32_t function_set[GPIO_FUNCTION_SELECT_SIZE] = {0};
+	uint32_t pull_pins[pupd_unchanged][GPIO_ENABLE_ARRAY_SIZE] = {{0}};
+	do
+	{
+		if (!gpio_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if (table == NULL_PTR)
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		for (uint32_t index = 0; index < count; index++)
+		{
+			GPIO_Pins pin = table[index].pin;
+			if ((pin >= GPIO_PIN_COUNT) || ((uint32_t)table[index].function > ALL_FUNCTION_BITS) ||
+				(table[index].pull > pupd_unchanged))
+			{
+				log_string_plus("gpio_configure:  invalid entry for pin: ", pin);
+				to_return = RPi_InvalidParam;
+				break;
+			}
+			uint32_t in_use_index = pin / ENABLE_PINS_PER_REGISTER;
+			uint32_t in_use_bit = 1 << (pin % ENABLE_PINS_PER_REGISTER);
+			if ((pin_in_use_array[in_use_index] | table_pins[in_use_index]) & in_use_bit)
+			{
+				log_string_plus("gpio_configure:  pin in use: ", pin);
+				to_return = GPIO_Pin_In_Use;
+				break;
+			}
+			table_pins[in_use_index] |= in_use_bit;
+
+			uint32_t register_index = pin / FUNCTION_SELECT_PINS_PER_REGISTER;
+			uint32_t pin_index = (pin % FUNCTION_SELECT_PINS_PER_REGISTER) * BITS_PER_FUNCTION_SELECT;
+			function_clear[register_index] |= ALL_FUNCTION_BITS << pin_index;
+			function_set[register_index] |= table[index].function << pin_index;
+			if (table[index].pull != pupd_unchanged)
+			{
+				pull_pins[table[index].pull][in_use_index] |= in_use_bit;
+			}
+		}
+		if (to_return != RPi_Success)
+		{
+			break;
+		}
+
+		for (uint32_t register_index = 0; register_index < GPIO_FUNCTION_SELECT_SIZE; register_index++)
+		{
+			if (function_clear[register_index] != 0)
+			{
+				REG_WRITE(gpio_registers->gpio_function_select[register_index],
+					(REG_READ(gpio_registers->gpio_function_select[register_index]) & ~function_clear[register_index]) |
+					function_set[register_index]);
+			}
+		}
+		for (uint32_t pull = pupd_disable; pull < pupd_unchanged; pull++)
+		{
+			gpio_program_pulls((GPIOPullUpPullDown)pull, pull_pins[pull]);
+		}
+		for (uint32_t index = 0; index < count; index++)
+		{
+			GPIO_Pins pin = table[index].pin;
+			pin_direction_array[pin] = table[index].function;
+			if (table[index].function == gpio_output)
+			{
+				pin_output_mask[pin / ENABLE_PINS_PER_REGISTER] |= 1 << (pin % ENABLE_PINS_PER_REGISTER);
+			}
+		}
+		for (uint32_t index = 0; index < GPIO_ENABLE_ARRAY_SIZE; index++)
+		{
+			pin_in_use_array[index] |= table_pins[index];
+		}
+	} while(0);
+	return to_return;
 }
 
 Error_Returns gpio_set_pin(GPIO_Pins pin)
@@ -175,7 +337,7 @@ Error_Returns gpio_set_pin(GPIO_Pins pin)
 		{
 			uint32_t index = pin / ENABLE_PINS_PER_REGISTER;
 			uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
-			gpio_registers->gpio_output_set[index] |= (1 << pin_index);
+			REG_WRITE(gpio_registers->gpio_output_set[index], (1 << pin_index));
 		}
 		else
 		{
@@ -200,7 +362,7 @@ Error_Returns gpio_clear_pin(GPIO_Pins pin)
 		{
 			uint32_t index = pin / ENABLE_PINS_PER_REGISTER;
 			uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
-			gpio_registers->gpio_output_clear[index] |= (1 << pin_index);
+			REG_WRITE(gpio_registers->gpio_output_clear[index], (1 << pin_index));
 		}
 		else
 		{
@@ -225,7 +387,7 @@ Error_Returns gpio_get_level(GPIO_Pins pin, uint32_t *level_value)
 		{
 			uint32_t index = pin / ENABLE_PINS_PER_REGISTER;
 			uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
-			uint32_t register_value = gpio_registers->gpio_level[index];
+			uint32_t register_value = REG_READ(gpio_registers->gpio_level[index]);
 			*level_value = (register_value >> pin_index) & SINGLE_BIT_MASK;
 		}
 		else
@@ -241,12 +403,213 @@ Error_Returns gpio_get_level(GPIO_Pins pin, uint32_t *level_value)
 	return to_return;
 }
 
+/*  Bank wide access.  GPSET and GPCLR only act on the 1 bits written so any
+	number of pins in a bank change together in one write, and nothing else in
+	the bank is disturbed.  Every pin in the masks must be an output.
+*/
+
+HOT Error_Returns gpio_write_mask(GPIOBank bank, uint32_t set_mask, uint32_t clear_mask)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (!gpio_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((bank >= gpio_bank_count) || ((set_mask | clear_mask) & ~pin_output_mask[bank]))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		//Clear first so a pin in both masks ends up set
+		if (clear_mask != 0)
+		{
+			REG_WRITE(gpio_registers->gpio_output_clear[bank], clear_mask);
+		}
+		if (set_mask != 0)
+		{
+			REG_WRITE(gpio_registers->gpio_output_set[bank], set_mask);
+		}
+	} while(0);
+	return to_return;
+}
+
+//The level of every pin in the bank, inputs and outputs alike
+HOT Error_Returns gpio_read_bank(GPIOBank bank, uint32_t *levels)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!gpio_initialized)
+	{
+		to_return = RPi_NotInitialized;
+	}
+	else if ((bank >= gpio_bank_count) || (levels == NULL_PTR))
+	{
+		to_return = RPi_InvalidParam;
+	}
+	else
+	{
+		*levels = REG_READ(gpio_registers->gpio_level[bank]);
+	}
+	return to_return;
+}
+
+/*  Bit n of a group's value is pins[n].  When the pins are consecutive in one
+	bank, in order, a value is just shifted into place, otherwise it is spread
+	over the pins a bit at a time.  Either way the pins in each bank change in
+	one clear and one set write.
+*/
+
+Error_Returns gpio_group_init(GPIO_Pin_Group *group, const GPIO_Pins *pins, uint32_t count)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if ((group == NULL_PTR) || (pins == NULL_PTR) || (count == 0) || (count > GPIO_GROUP_MAX_PINS))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		group->mask[gpio_bank_0] = 0;
+		group->mask[gpio_bank_1] = 0;
+		group->count = count;
+		group->bank = (GPIOBank)(pins[0] / ENABLE_PINS_PER_REGISTER);
+		group->shift = pins[0] % ENABLE_PINS_PER_REGISTER;
+		for (uint32_t index = 0; index < count; index++)
+		{
+			uint32_t bank = pins[index] / ENABLE_PINS_PER_REGISTER;
+			uint32_t pin_bit = 1 << (pins[index] % ENABLE_PINS_PER_REGISTER);
+			if ((pins[index] >= GPIO_PIN_COUNT) || (group->mask[bank] & pin_bit))
+			{
+				log_string_plus("gpio_group_init:  invalid or repeated pin: ", pins[index]);
+				to_return = RPi_InvalidParam;
+				break;
+			}
+			group->mask[bank] |= pin_bit;
+			group->pins[index] = pins[index];
+			if (pins[index] != (pins[0] + index))
+			{
+				group->shift = GPIO_GROUP_NOT_CONSECUTIVE;
+			}
+		}
+		//Consecutive pin numbers can still run off the end of bank 0
+		if ((group->shift != GPIO_GROUP_NOT_CONSECUTIVE) &&
+			((group->mask[group->bank] >> group->shift) != (0xFFFFFFFF >> (ENABLE_PINS_PER_REGISTER - count))))
+		{
+			group->shift = GPIO_GROUP_NOT_CONSECUTIVE;
+		}
+	} while(0);
+	return to_return;
+}
+
+/*  Every bank the group touches is checked before the first write so a bad
+	group never leaves its value half written.
+*/
+
+HOT Error_Returns gpio_group_write(const GPIO_Pin_Group *group, uint32_t value)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t set_mask[gpio_bank_count] = {0, 0};
+	do
+	{
+		if (!gpio_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if (group == NULL_PTR)
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		for (uint32_t bank = 0; bank < gpio_bank_count; bank++)
+		{
+			if (group->mask[bank] & ~pin_output_mask[bank])
+			{
+				to_return = RPi_InvalidParam;
+			}
+		}
+		if (to_return != RPi_Success)
+		{
+			break;
+		}
+		if (group->shift != GPIO_GROUP_NOT_CONSECUTIVE)
+		{
+			set_mask[group->bank] = (value << group->shift) & group->mask[group->bank];
+		}
+		else
+		{
+			for (uint32_t index = 0; index < group->count; index++)
+			{
+				if (value & (1 << index))
+				{
+					set_mask[group->pins[index] / ENABLE_PINS_PER_REGISTER] |= 1 << (group->pins[index] % ENABLE_PINS_PER_REGISTER);
+				}
+			}
+		}
+		for (uint32_t bank = 0; bank < gpio_bank_count; bank++)
+		{
+			if (group->mask[bank] != 0)
+			{
+				gpio_write_mask((GPIOBank)bank, set_mask[bank], group->mask[bank] & ~set_mask[bank]);
+			}
+		}
+	} while(0);
+	return to_return;
+}
+
+HOT Error_Returns gpio_group_read(const GPIO_Pin_Group *group, uint32_t *value)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t levels[gpio_bank_count] = {0, 0};
+	do
+	{
+		if ((group == NULL_PTR) || (value == NULL_PTR))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		for (uint32_t bank = 0; (bank < gpio_bank_count) && (to_return == RPi_Success); bank++)
+		{
+			if (group->mask[bank] != 0)
+			{
+				to_return = gpio_read_bank((GPIOBank)bank, &levels[bank]);
+			}
+		}
+		if (to_return != RPi_Success)
+		{
+			break;
+		}
+		if (group->shift != GPIO_GROUP_NOT_CONSECUTIVE)
+		{
+			*value = (levels[group->bank] & group->mask[group->bank]) >> group->shift;
+		}
+		else
+		{
+			*value = 0;
+			for (uint32_t index = 0; index < group->count; index++)
+			{
+				*value |= ((levels[group->pins[index] / ENABLE_PINS_PER_REGISTER] >>
+					(group->pins[index] % ENABLE_PINS_PER_REGISTER)) & SINGLE_BIT_MASK) << index;
+			}
+		}
+	} while(0);
+	return to_return;
+}
+
 Error_Returns gpio_set_high_detect_pin(GPIO_Pins pin)
 {
 	return gpio_set_detect_register("gpio_set_high_detect_pin: pin not input: ", 
 		gpio_registers->gpio_pin_high_detect_enable, pin);
 }
 
+Error_Returns gpio_clear_high_detect_pin(GPIO_Pins pin)
+{
+	return gpio_clear_detect_register("gpio_clear_high_detect_pin: pin not input: ", 
+		gpio_registers->gpio_pin_high_detect_enable, pin);
+}
+
 Error_Returns gpio_set_low_detect_pin(GPIO_Pins pin)
 {
 	return gpio_set_detect_register("gpio_set_low_detect_pin: pin not input: ", 
@@ -281,13 +644,135 @@ GPIOEventDetectStatus gpio_get_event_detect_status(GPIO_Pins pin)
 {
 	uint32_t in_use_index = pin / ENABLE_PINS_PER_REGISTER;
 	uint32_t in_use_pin_index = pin % ENABLE_PINS_PER_REGISTER;
-	uint32_t register_value = gpio_registers->gpio_event_detect_status[in_use_index];
-	GPIOEventDetectStatus to_return = (GPIOEventDetectStatus) register_value >> in_use_pin_index;
+	uint32_t register_value = REG_READ(gpio_registers->gpio_event_detect_status[in_use_index]);
+	GPIOEventDetectStatus to_return = (GPIOEventDetectStatus) ((register_value >> in_use_pin_index) & SINGLE_BIT_MASK);
 	return to_return;
 }
 
+/*  The event detect status register is write 1 to clear so only write the one
+	bit, a read-modify-write would clear every other pending event as well.
+*/
+
 Error_Returns gpio_clear_event_detect_status(GPIO_Pins pin)
 {
-	return gpio_set_detect_register("gpio_clear_event_detect_status: pin not input: ", 
-		gpio_registers->gpio_event_detect_status, pin);
-}
\ No newline at end of file
+	Error_Returns to_return = RPi_Success;
+	if (pin < GPIO_PIN_COUNT)
+	{
+		uint32_t index = pin / ENABLE_PINS_PER_REGISTER;
+		uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
+		REG_WRITE(gpio_registers->gpio_event_detect_status[index], (1 << pin_index));
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
+/*  Events are cleared in one write before the callbacks run so an edge that
+	comes in while they run isn't lost.  A level detect callback needs to turn
+	off its detect and then clear its pin's event itself.
+*/
+
+HOT static InterruptHandlerStatus gpio_bank_interrupt_handler(uint32_t bank)
+{
+	InterruptHandlerStatus to_return = Interrupt_Not_Claimed;
+	uint32_t timestamp = read_cycle_counter();
+	uint32_t events = REG_READ(gpio_registers->gpio_event_detect_status[bank]) & event_callback_pins[bank];
+	if (events)
+	{
+		REG_WRITE(gpio_registers->gpio_event_detect_status[bank], events);
+		while (events)
+		{
+			uint32_t pin = (bank * ENABLE_PINS_PER_REGISTER) + __builtin_ctz(events);
+			events &= events - 1;
+			event_callback_array[pin]((GPIO_Pins)pin, timestamp);
+		}
+		to_return = Interrupt_Claimed;
+	}
+	return to_return;
+}
+
+HOT static InterruptHandlerStatus gpio_bank_0_interrupt_handler(void)
+{
+	return gpio_bank_interrupt_handler(0);
+}
+
+HOT static InterruptHandlerStatus gpio_bank_1_interrupt_handler(void)
+{
+	return gpio_bank_interrupt_handler(1);
+}
+
+/*  Register a function to be called from interrupt context, at low priority,
+	when an event is detected on the pin.  The timestamp is the cycle counter when the bank's
+	events were read.  The detect type (edge, level...) is still set up with
+	the gpio_set_xxx_detect_pin functions.
+*/
+
+Error_Returns gpio_register_event_callback(GPIO_Pins pin, void (*callback_ptr)(GPIO_Pins pin, uint32_t timestamp))
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (!gpio_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((pin >= GPIO_PIN_COUNT) || (callback_ptr == NULL_PTR))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		if (event_callback_array[pin] != NULL_PTR)
+		{
+			to_return = RPi_InUse;
+			break;
+		}
+
+		uint32_t bank = pin / ENABLE_PINS_PER_REGISTER;
+		uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
+		if (bank_handler_index[bank] < 0)
+		{
+			bank_handler_index[bank] = interrupt_handler_add((bank == 0) ? gpio_bank_0_interrupt_handler :
+				gpio_bank_1_interrupt_handler, Int_GPIO_Pin, pin);
+			if (bank_handler_index[bank] < 0)
+			{
+				log_string_plus("gpio_register_event_callback:  failed to add bank handler ", bank);
+				to_return = RPi_OperationFailed;
+				break;
+			}
+			//Pin callbacks (the MPU6050 one reads the FIFO) can run long, let the timers preempt them
+			interrupt_handler_set_priority(bank_handler_index[bank], Int_Priority_Low);
+		}
+		uint32_t saved_cpsr = enter_critical_section();
+		event_callback_array[pin] = callback_ptr;
+		event_callback_pins[bank] |= (1 << pin_index);
+		exit_critical_section(saved_cpsr);
+	} while(0);
+	return to_return;
+}
+
+Error_Returns gpio_remove_event_callback(GPIO_Pins pin)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((pin < GPIO_PIN_COUNT) && (event_callback_array[pin] != NULL_PTR))
+	{
+		uint32_t bank = pin / ENABLE_PINS_PER_REGISTER;
+		uint32_t pin_index = pin % ENABLE_PINS_PER_REGISTER;
+		uint32_t saved_cpsr = enter_critical_section();
+		event_callback_pins[bank] &= ~(1 << pin_index);
+		event_callback_array[pin] = NULL_PTR;
+		exit_critical_section(saved_cpsr);
+		if (event_callback_pins[bank] == 0)
+		{
+			interrupt_handler_remove(bank_handler_index[bank]);
+			bank_handler_index[bank] = -1;
+		}
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
@@ -28,6 +28,7 @@ Serial Controller in the 2835.
 #include "log.h"
 #include "gpio.h"
 #include "reg_definitions.h"
+#include "reg_access.h"
 
 #define BSC_CONTROL_I2CEN		(1 << 15)
 #define BSC_CONTROL_INTR		(1 << 10)
@@ -69,74 +70,70 @@ typedef struct {
 static unsigned char i2c_ready = 0;
 static volatile BSC_Registers *bsc1_registers = (BSC_Registers *)BSC1_BASE;
 
-void i2c_dump_registers()
+//SDA1 and SCL1, the board has its own pull ups on the bus
+static const GPIO_Pin_Config i2c_pins[] = {
+	{gpio_pin_2, gpio_alt_0, pupd_disable},
+	{gpio_pin_3, gpio_alt_0, pupd_disable}
+};
+
+COLD void i2c_dump_registers()
 {
-	log_string_plus("BSC Control: ", bsc1_registers->bsc_control);
-	log_string_plus("BSC Status: ", bsc1_registers->bsc_status);
-	log_string_plus("BSC Data Length: ", bsc1_registers->bsc_data_length);
-	log_string_plus("BSC Slave Address: ", bsc1_registers->bsc_slave_address);
-	log_string_plus("BSC Clock Divider: ", bsc1_registers->bsc_clock_divider);
-	log_string_plus("BSC Data Delay: ", bsc1_registers->bsc_data_delay);
-	log_string_plus("BSC Clock Stretch: ", bsc1_registers->bsc_clock_stretch);
+	log_string_plus("BSC Control: ", REG_READ(bsc1_registers->bsc_control));
+	log_string_plus("BSC Status: ", REG_READ(bsc1_registers->bsc_status));
+	log_string_plus("BSC Data Length: ", REG_READ(bsc1_registers->bsc_data_length));
+	log_string_plus("BSC Slave Address: ", REG_READ(bsc1_registers->bsc_slave_address));
+	log_string_plus("BSC Clock Divider: ", REG_READ(bsc1_registers->bsc_clock_divider));
+	log_string_plus("BSC Data Delay: ", REG_READ(bsc1_registers->bsc_data_delay));
+	log_string_plus("BSC Clock Stretch: ", REG_READ(bsc1_registers->bsc_clock_stretch));
 }
 
-Error_Returns i2c_init() 
+COLD Error_Returns i2c_init()
 {
 	Error_Returns to_return = RPi_Success;
 	if (!i2c_ready)
 	{
 		do
 		{
-			to_return = gpio_set_function_select(gpio_pin_2, gpio_alt_0);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("i2c_init:  failed to set up pin ", gpio_pin_2);
-				break;
-			}
-			
-			to_return = gpio_set_function_select(gpio_pin_3, gpio_alt_0);
+			to_return = gpio_configure(i2c_pins, GPIO_CONFIG_COUNT(i2c_pins));
 			if (to_return != RPi_Success)
 			{
-				log_string_plus("i2c_init:  failed to set up pin ", gpio_pin_3);
+				log_string_plus("i2c_init:  failed to set up pins, status: ", to_return);
 				break;
 			}
-			
-			gpio_set_pullup_pulldown(gpio_pin_2, pupd_disable);
-			gpio_set_pullup_pulldown(gpio_pin_3, pupd_disable);
 
-			bsc1_registers->bsc_clock_divider = (BASE_CLOCK_SPEED / I2C_SPEED);
+			REG_WRITE(bsc1_registers->bsc_clock_divider, (BASE_CLOCK_SPEED / I2C_SPEED));
 			i2c_ready = 1;
 		} while(0);
 	}
 	return to_return;
 }
 
-Error_Returns i2c_read(uint32_t slave_address, unsigned char *data, 
+HOT Error_Returns i2c_read(uint32_t slave_address, unsigned char *data,
    uint32_t number_bytes)
 {
 	uint32_t count = 0;
 	Error_Returns to_return = RPi_Success;
 	
-	bsc1_registers->bsc_slave_address = slave_address;
-	bsc1_registers->bsc_control = BSC_CONTROL_CLEAR;
-	bsc1_registers->bsc_status = (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE);
-	bsc1_registers->bsc_data_length = number_bytes;
-	bsc1_registers->bsc_control = (BSC_CONTROL_I2CEN | BSC_CONTROL_ST | BSC_CONTROL_READ);
+	REG_WRITE(bsc1_registers->bsc_slave_address, slave_address);
+	REG_WRITE(bsc1_registers->bsc_control, BSC_CONTROL_CLEAR);
+	REG_WRITE(bsc1_registers->bsc_status, (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE));
+	REG_WRITE(bsc1_registers->bsc_data_length, number_bytes);
+	REG_WRITE(bsc1_registers->bsc_control, (BSC_CONTROL_I2CEN | BSC_CONTROL_ST | BSC_CONTROL_READ));
 	
 	do
 	{
-		while(!(bsc1_registers->bsc_status & (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE)))
+		while(!(REG_READ(bsc1_registers->bsc_status) & (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE)))
 		{
-			while(bsc1_registers->bsc_status & (BSC_STATUS_RXD))
+			while(REG_READ(bsc1_registers->bsc_status) & (BSC_STATUS_RXD))
 			{
-				*data++ = bsc1_registers->bsc_data_FIFO & BSC_BYTE_MASK;
+				*data++ = REG_READ(bsc1_registers->bsc_data_FIFO) & BSC_BYTE_MASK;
 				count++;
 			}
 		}
 		
-		if (bsc1_registers->bsc_status & (BSC_STATUS_CLKT | BSC_STATUS_ERR))
+		if (REG_READ(bsc1_registers->bsc_status) & (BSC_STATUS_CLKT | BSC_STATUS_ERR))
 		{
-			if (bsc1_registers->bsc_status & BSC_STATUS_CLKT)
+			if (REG_READ(bsc1_registers->bsc_status) & BSC_STATUS_CLKT)
 			{
 				to_return = I2CS_Clock_Timeout;
 			}
@@ -147,9 +144,9 @@ Error_Returns i2c_read(uint32_t slave_address, unsigned char *data,
 			break;
 		}
 		
-		while((count < number_bytes) && (bsc1_registers->bsc_status & BSC_STATUS_RXD))
+		while((count < number_bytes) && (REG_READ(bsc1_registers->bsc_status) & BSC_STATUS_RXD))
 		{
-			*data++ = bsc1_registers->bsc_data_FIFO & BSC_BYTE_MASK;
+			*data++ = REG_READ(bsc1_registers->bsc_data_FIFO) & BSC_BYTE_MASK;
 			count++;
 		}
 		
@@ -159,39 +156,39 @@ Error_Returns i2c_read(uint32_t slave_address, unsigned char *data,
 		}
 	} while (0);
 	
-	bsc1_registers->bsc_status = (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE);
-	bsc1_registers->bsc_control = BSC_CONTROL_RESET;
+	REG_WRITE(bsc1_registers->bsc_status, (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE));
+	REG_WRITE(bsc1_registers->bsc_control, BSC_CONTROL_RESET);
 	return to_return;
 }
 
-Error_Returns i2c_write(uint32_t slave_address, unsigned char *data, 
+HOT Error_Returns i2c_write(uint32_t slave_address, unsigned char *data,
    uint32_t number_bytes)
 {
 	uint32_t count = 0;
 	Error_Returns to_return = RPi_Success;
 	
-	bsc1_registers->bsc_slave_address = slave_address;
-	bsc1_registers->bsc_control = BSC_CONTROL_CLEAR;
-	bsc1_registers->bsc_status = (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE);
-	bsc1_registers->bsc_data_length = number_bytes;
-	bsc1_registers->bsc_control = (BSC_CONTROL_I2CEN | BSC_CONTROL_ST);
+	REG_WRITE(bsc1_registers->bsc_slave_address, slave_address);
+	REG_WRITE(bsc1_registers->bsc_control, BSC_CONTROL_CLEAR);
+	REG_WRITE(bsc1_registers->bsc_status, (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE));
+	REG_WRITE(bsc1_registers->bsc_data_length, number_bytes);
+	REG_WRITE(bsc1_registers->bsc_control, (BSC_CONTROL_I2CEN | BSC_CONTROL_ST));
 
 	do
 	{
 		//TODO:  Need to rework this to have a deadman counter.  Have seen a few instances
 		//where with my sketchy breadboard setup the I2C bus hangs on a write.
-		while(!(bsc1_registers->bsc_status & (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE)))
+		while(!(REG_READ(bsc1_registers->bsc_status) & (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE)))
 		{
-			while(count < number_bytes && bsc1_registers->bsc_status & BSC_STATUS_TXD)
+			while(count < number_bytes && REG_READ(bsc1_registers->bsc_status) & BSC_STATUS_TXD)
 			{
-				bsc1_registers->bsc_data_FIFO = *data++;
+				REG_WRITE(bsc1_registers->bsc_data_FIFO, *data++);
 				count++;
 			}
 		}
 		
-		if (bsc1_registers->bsc_status & (BSC_STATUS_CLKT | BSC_STATUS_ERR))
+		if (REG_READ(bsc1_registers->bsc_status) & (BSC_STATUS_CLKT | BSC_STATUS_ERR))
 		{
-			if (bsc1_registers->bsc_status & BSC_STATUS_CLKT)
+			if (REG_READ(bsc1_registers->bsc_status) & BSC_STATUS_CLKT)
 			{
 				to_return = I2CS_Clock_Timeout;
 			}
@@ -208,7 +205,7 @@ Error_Returns i2c_write(uint32_t slave_address, unsigned char *data,
 		}	
 	} while(0);
 	
-	bsc1_registers->bsc_status = (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE);
-	bsc1_registers->bsc_control = BSC_CONTROL_RESET;
+	REG_WRITE(bsc1_registers->bsc_status, (BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE));
+	REG_WRITE(bsc1_registers->bsc_control, BSC_CONTROL_RESET);
 	return to_return;
 }
@@ -26,15 +26,22 @@ processor interrupt function.
 
 #include "common.h"
 #include "reg_definitions.h"
+#include "reg_access.h"
 #include "interrupt_handler.h"
+#include "arm_timer.h"
 #include "log.h"
 
-#define MAX_INTERRUPT_HANDLER_FUNCTIONS 4
+#define MAX_INTERRUPT_HANDLER_FUNCTIONS 8
 #define GPIO_PINS_PER_INTERRUPT_REG 32
 #define GPIO_PIN_INTERRUPT_LOW_BANK 17
 #define GPIO_PIN_INTERRUPT_HIGH_BANK 18
 #define GPIO_PIN_INTERRUPT_ALL_EVENTS 20
 #define ARM_BASIC_INTERRUPT 0x01
+#define AUX_INTERRUPT 29  //IRQ 29 in irq_pending_1, the mini UART and both aux SPIs
+#define SYSTEM_TIMER_1_INTERRUPT 1  //The System Timer compare channels are IRQs 0-3
+#define SYSTEM_TIMER_3_INTERRUPT 3
+#define INTERRUPT_HISTOGRAM_BUCKETS 32  //One per power of two of the 32 bit cycle count
+#define INTERRUPT_BENCHMARK_PASSES 64
 
 typedef struct {
 	uint32_t irq_basic_pending;
@@ -49,31 +56,332 @@ typedef struct {
 	uint32_t disable_basic_irqs;
 } ARM_Interrupt_Registers;
 
+//The bits a handler's source occupies in the basic, 1 and 2 pending/enable registers
+typedef struct {
+	uint32_t basic;
+	uint32_t irq_1;
+	uint32_t irq_2;
+} Interrupt_Source_Mask;
+
 typedef struct {
 	InterruptHandlerStatus (*handler_ptr)(void);
 	InterruptType type;
 	GPIO_Pins pin;
+	InterruptPriority priority;
+	Interrupt_Source_Mask source;
 } InterruptHandlerInfo;
 
+//Cycle counts are taken from the ARM1176 cycle counter so durations are in CPU clocks
+typedef struct {
+	uint32_t count;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+	uint32_t histogram[INTERRUPT_HISTOGRAM_BUCKETS];
+} Interrupt_Duration_Stats;
+
+typedef struct {
+	uint32_t count;
+	uint32_t max_microseconds;
+	uint64_t total_microseconds;
+} Interrupt_Latency_Stats;
+
+//In init.s, runs the handler in SVC mode with CPU interrupts enabled
+extern InterruptHandlerStatus nested_interrupt_call(InterruptHandlerStatus (*handler_ptr)(void));
+
+//Also in init.s, copies of the IRQ entry that call an empty handler
+extern void irq_benchmark_lean(void);
+extern void irq_benchmark_full(void);
+extern uint32_t irq_round_trip_cycles(void (*stub)(void));
+
 static volatile ARM_Interrupt_Registers *arm_interrupt_registers = (ARM_Interrupt_Registers *)ARM_INTERRUPTS_BASE;
 
 //static InterruptHandlerStatus (*interrupt_handler_ptr_array[MAX_INTERRUPT_HANDLER_FUNCTIONS])(void);
 static InterruptHandlerInfo interrupt_handler_info_array[MAX_INTERRUPT_HANDLER_FUNCTIONS];
 static int number_of_handlers = 0;
-static uint32_t number_of_gpio_low_handlers = 0;
-static uint32_t number_of_gpio_high_handlers = 0;
-static uint32_t number_of_gpio_all_handlers = 0;
-static uint32_t number_of_basic_handlers = 0;
+
+/*  priority_masks[n] holds every source that has a handler at priority n or
+	lower, these are what get masked in the controller while a priority n
+	handler runs.  priority_masks[Int_Priority_Count] is always empty.
+*/
+static Interrupt_Source_Mask priority_masks[Int_Priority_Count + 1];
+static InterruptPriority current_priority = Int_Priority_Count;
 
 static unsigned char interrupt_handler_initialized = 0;
 
-void interrupt_handler_dump_registers(void)
+static Interrupt_Duration_Stats handler_stats[MAX_INTERRUPT_HANDLER_FUNCTIONS];
+static Interrupt_Duration_Stats irq_stats;  //From the irq entry in init.s to the end of dispatch
+static Interrupt_Latency_Stats timer_latency_stats;
+static uint32_t unhandled_interrupt_count = 0;
+
+static Error_Returns interrupt_handler_get_source(InterruptType type, GPIO_Pins pin, Interrupt_Source_Mask *source)
+{
+	Error_Returns to_return = RPi_Success;
+	source->basic = 0;
+	source->irq_1 = 0;
+	source->irq_2 = 0;
+	switch(type)
+	{
+		case Int_Basic:
+		{
+			source->basic = ARM_BASIC_INTERRUPT;
+			break;
+		}
+		case Int_GPIO_Pin:
+		{
+			//Note:  The raspberry pi zero only has 2 GPIO banks
+			uint32_t gpio_bank = pin / GPIO_PINS_PER_INTERRUPT_REG;
+			switch(gpio_bank)
+			{
+				case 0:
+				{
+					source->irq_2 = (1 << GPIO_PIN_INTERRUPT_LOW_BANK);
+					break;
+				}
+				case 1:
+				{
+					source->irq_2 = (1 << GPIO_PIN_INTERRUPT_HIGH_BANK);
+					break;
+				}
+				default:
+				{
+					log_string_plus("interrupt_handler_add: invalid bank: ", gpio_bank);
+					to_return = RPi_InvalidParam;
+					break;
+				}
+			}
+			break;
+		}
+		case Int_GPIO_All:
+		{
+			source->irq_2 = (1 << GPIO_PIN_INTERRUPT_ALL_EVENTS);
+			break;
+		}
+		case Int_Aux:
+		{
+			source->irq_1 = (1 << AUX_INTERRUPT);
+			break;
+		}
+		case Int_System_Timer_1:
+		{
+			source->irq_1 = (1 << SYSTEM_TIMER_1_INTERRUPT);
+			break;
+		}
+		case Int_System_Timer_3:
+		{
+			source->irq_1 = (1 << SYSTEM_TIMER_3_INTERRUPT);
+			break;
+		}
+		default:
+		{
+			log_string_plus("interrupt_handler_add: invalid parameter: ", type);
+			to_return = RPi_InvalidParam;
+			break;
+		}
+	}
+	return to_return;
+}
+
+static void interrupt_handler_update_priority_masks(void)
+{
+	for (uint32_t priority = 0; priority <= Int_Priority_Count; priority++)
+	{
+		priority_masks[priority].basic = 0;
+		priority_masks[priority].irq_1 = 0;
+		priority_masks[priority].irq_2 = 0;
+		for (uint32_t index = 0; index < MAX_INTERRUPT_HANDLER_FUNCTIONS; index++)
+		{
+			InterruptHandlerInfo *info = &interrupt_handler_info_array[index];
+			if ((info->handler_ptr != NULL_PTR) && (info->priority >= priority))
+			{
+				priority_masks[priority].basic |= info->source.basic;
+				priority_masks[priority].irq_1 |= info->source.irq_1;
+				priority_masks[priority].irq_2 |= info->source.irq_2;
+			}
+		}
+	}
+}
+
+/*  The enable and disable registers are write 1 to set, writing 0 leaves a
+	source as it was.
+*/
+
+HOT static void interrupt_handler_enable_source(Interrupt_Source_Mask *source)
+{
+	REG_WRITE(arm_interrupt_registers->enable_basic_irqs, source->basic);
+	REG_WRITE(arm_interrupt_registers->enable_irqs_1, source->irq_1);
+	REG_WRITE(arm_interrupt_registers->enable_irqs_2, source->irq_2);
+}
+
+HOT static void interrupt_handler_disable_source(Interrupt_Source_Mask *source)
+{
+	REG_WRITE(arm_interrupt_registers->disable_basic_irqs, source->basic);
+	REG_WRITE(arm_interrupt_registers->disable_irqs_1, source->irq_1);
+	REG_WRITE(arm_interrupt_registers->disable_irqs_2, source->irq_2);
+}
+
+HOT static uint32_t interrupt_handler_source_pending(Interrupt_Source_Mask *source)
+{
+	return (REG_READ(arm_interrupt_registers->irq_basic_pending) & source->basic) ||
+		(REG_READ(arm_interrupt_registers->irq_pending_1) & source->irq_1) ||
+		(REG_READ(arm_interrupt_registers->irq_pending_2) & source->irq_2);
+}
+
+/*  Run a handler below high priority with CPU interrupts enabled.  Every source
+	at its priority or lower is masked in the controller first so only more
+	important sources can preempt it.  nested_interrupt_call in init.s does the
+	switch to SVC mode so a nested IRQ can't trash this one's lr and spsr.
+*/
+
+HOT static InterruptHandlerStatus interrupt_handler_call_nested(InterruptHandlerInfo *info)
+{
+	InterruptPriority previous_priority = current_priority;
+	Interrupt_Source_Mask unmask;
+
+	current_priority = info->priority;
+	interrupt_handler_disable_source(&priority_masks[info->priority]);
+	InterruptHandlerStatus to_return = nested_interrupt_call(info->handler_ptr);
+
+	//Only turn back on what the level we preempted didn't have masked
+	unmask.basic = priority_masks[info->priority].basic & ~priority_masks[previous_priority].basic;
+	unmask.irq_1 = priority_masks[info->priority].irq_1 & ~priority_masks[previous_priority].irq_1;
+	unmask.irq_2 = priority_masks[info->priority].irq_2 & ~priority_masks[previous_priority].irq_2;
+	interrupt_handler_enable_source(&unmask);
+	current_priority = previous_priority;
+	return to_return;
+}
+
+static void interrupt_handler_clear_duration_stats(Interrupt_Duration_Stats *stats)
+{
+	stats->count = 0;
+	stats->min_cycles = 0xFFFFFFFF;
+	stats->max_cycles = 0;
+	stats->total_cycles = 0;
+	for (uint32_t bucket = 0; bucket < INTERRUPT_HISTOGRAM_BUCKETS; bucket++)
+	{
+		stats->histogram[bucket] = 0;
+	}
+}
+
+HOT static void interrupt_handler_record_duration(Interrupt_Duration_Stats *stats, uint32_t cycles)
+{
+	stats->count++;
+	stats->total_cycles += cycles;
+	if (cycles < stats->min_cycles)
+	{
+		stats->min_cycles = cycles;
+	}
+	if (cycles > stats->max_cycles)
+	{
+		stats->max_cycles = cycles;
+	}
+	//Bucket n holds durations of 2^n up to 2^(n+1) - 1 cycles
+	uint32_t bucket = (cycles == 0) ? 0 : (31 - __builtin_clz(cycles));
+	stats->histogram[bucket]++;
+}
+
+COLD static void interrupt_handler_dump_duration_stats(Interrupt_Duration_Stats *stats)
+{
+	log_string_plus("  count: ", stats->count);
+	if (stats->count != 0)
+	{
+		log_string_plus("  min cycles: ", stats->min_cycles);
+		log_string_plus("  avg cycles: ", (uint32_t)(stats->total_cycles / stats->count));
+		log_string_plus("  max cycles: ", stats->max_cycles);
+		for (uint32_t bucket = 0; bucket < INTERRUPT_HISTOGRAM_BUCKETS; bucket++)
+		{
+			if (stats->histogram[bucket] != 0)
+			{
+				log_string_plus("  cycles >= 2^", bucket);
+				log_string_plus("    hits: ", stats->histogram[bucket]);
+			}
+		}
+	}
+}
+
+void interrupt_handler_reset_stats(void)
+{
+	uint32_t saved_cpsr = enter_critical_section();
+	for (uint32_t index = 0; index < MAX_INTERRUPT_HANDLER_FUNCTIONS; index++)
+	{
+		interrupt_handler_clear_duration_stats(&handler_stats[index]);
+	}
+	interrupt_handler_clear_duration_stats(&irq_stats);
+	timer_latency_stats.count = 0;
+	timer_latency_stats.max_microseconds = 0;
+	timer_latency_stats.total_microseconds = 0;
+	unhandled_interrupt_count = 0;
+	exit_critical_section(saved_cpsr);
+}
+
+/*  Dump what the interrupt profiler has gathered so far.  Durations are in CPU
+	cycles, the timer latency is the time in microseconds from the earliest due
+	software timer deadline to the ARM timer handler running.
+*/
+
+COLD void interrupt_handler_dump_stats(void)
+{
+	log_string_plus("irq_basic_pending: ", REG_READ(arm_interrupt_registers->irq_basic_pending));
+	log_string_plus("enable_basic_irqs: ", REG_READ(arm_interrupt_registers->enable_basic_irqs));
+	log_string_plus("Unhandled interrupts: ", unhandled_interrupt_count);
+	log_string("IRQ entry to exit:");
+	interrupt_handler_dump_duration_stats(&irq_stats);
+	for (uint32_t index = 0; index < MAX_INTERRUPT_HANDLER_FUNCTIONS; index++)
+	{
+		if ((interrupt_handler_info_array[index].handler_ptr != NULL_PTR) || (handler_stats[index].count != 0))
+		{
+			log_string_plus("Handler: ", index);
+			log_string_plus("  function: ", (uint32_t)interrupt_handler_info_array[index].handler_ptr);
+			log_string_plus("  type: ", interrupt_handler_info_array[index].type);
+			log_string_plus("  priority: ", interrupt_handler_info_array[index].priority);
+			interrupt_handler_dump_duration_stats(&handler_stats[index]);
+		}
+	}
+	log_string_plus("Timer entry latency samples: ", timer_latency_stats.count);
+	if (timer_latency_stats.count != 0)
+	{
+		log_string_plus("  avg microseconds: ",
+			(uint32_t)(timer_latency_stats.total_microseconds / timer_latency_stats.count));
+		log_string_plus("  worst microseconds: ", timer_latency_stats.max_microseconds);
+	}
+}
+
+COLD static void interrupt_handler_benchmark_stub(const char *name, void (*stub)(void))
 {
-	log_string_plus("irq_basic_pending: ", arm_interrupt_registers->irq_basic_pending);
-	log_string_plus("enable_basic_irqs: ", arm_interrupt_registers->enable_basic_irqs);
+	uint32_t min_cycles = 0xFFFFFFFF;
+	uint32_t max_cycles = 0;
+	uint32_t total_cycles = 0;
+	for (uint32_t pass = 0; pass < INTERRUPT_BENCHMARK_PASSES; pass++)
+	{
+		uint32_t cycles = irq_round_trip_cycles(stub);
+		total_cycles += cycles;
+		if (cycles < min_cycles)
+		{
+			min_cycles = cycles;
+		}
+		if (cycles > max_cycles)
+		{
+			max_cycles = cycles;
+		}
+	}
+	log_string(name);
+	log_string_plus("  min cycles: ", min_cycles);
+	log_string_plus("  avg cycles: ", total_cycles / INTERRUPT_BENCHMARK_PASSES);
+	log_string_plus("  max cycles: ", max_cycles);
+}
+
+/*  Compare the IRQ entry/exit used before (all registers saved) with the lean
+	one now in use.  Both call an empty handler so this is purely the cost of
+	the entry code.  The first pass of each will include cache misses.
+*/
+
+COLD void interrupt_handler_benchmark_entry(void)
+{
+	interrupt_handler_benchmark_stub("IRQ round trip, full save:", irq_benchmark_full);
+	interrupt_handler_benchmark_stub("IRQ round trip, lean save:", irq_benchmark_lean);
 }
 
-Error_Returns interrupt_handler_init()
+COLD Error_Returns interrupt_handler_init()
 {
 	Error_Returns to_return = RPi_Success;
 	if (!interrupt_handler_initialized)
@@ -84,113 +392,106 @@ Error_Returns interrupt_handler_init()
 			interrupt_handler_info_array[index].handler_ptr = NULL_PTR;
 		}
 		number_of_handlers = 0;
+		current_priority = Int_Priority_Count;
+		interrupt_handler_update_priority_masks();
+		enable_cycle_counter();
+		interrupt_handler_reset_stats();
 		interrupt_handler_initialized = 1;
 	}
 	return to_return;
 }
 
-void interrupt_handler(void)
+/*  Called by the ARM timer handler once it has claimed an expiry, so there is
+	one sample per expiry however many other IRQs nest while it runs.
+*/
+
+HOT void interrupt_handler_record_timer_latency(uint32_t latency_microseconds)
+{
+	timer_latency_stats.count++;
+	timer_latency_stats.total_microseconds += latency_microseconds;
+	if (latency_microseconds > timer_latency_stats.max_microseconds)
+	{
+		timer_latency_stats.max_microseconds = latency_microseconds;
+	}
+}
+
+/*  Called from the irq entry in init.s with the cycle counter value read as
+	soon as the registers were saved.  Only handlers whose source is pending
+	and which are more important than whatever this IRQ preempted are run.
+	High priority handlers run with CPU interrupts masked, everything else is
+	run nested.
+*/
+
+HOT void interrupt_handler(uint32_t entry_cycles)
 {
 	uint32_t interrupt_handled = 0;
+
 	for(uint32_t index = 0; index < MAX_INTERRUPT_HANDLER_FUNCTIONS; index++)
 	{
-		if (interrupt_handler_info_array[index].handler_ptr != NULL_PTR)
+		InterruptHandlerInfo *info = &interrupt_handler_info_array[index];
+		if ((info->handler_ptr != NULL_PTR) && (info->priority < current_priority) &&
+			interrupt_handler_source_pending(&info->source))
 		{
-			InterruptHandlerStatus status = interrupt_handler_info_array[index].handler_ptr();
+			InterruptHandlerStatus status;
+			uint32_t start_cycles = read_cycle_counter();
+			if (info->priority == Int_Priority_High)
+			{
+				status = info->handler_ptr();
+			}
+			else
+			{
+				status = interrupt_handler_call_nested(info);
+			}
 			if (status == Interrupt_Claimed)
 			{
+				interrupt_handler_record_duration(&handler_stats[index], read_cycle_counter() - start_cycles);
 				interrupt_handled = 1;
 			}
 		}
 	}
 	if (!interrupt_handled)
 	{
-		log_string_plus("Interrupt not handled:  irq_basic_pending: ", arm_interrupt_registers->irq_basic_pending);
-		log_string_plus("Interrupt not handled:  irq_pending_1: ", arm_interrupt_registers->irq_pending_1);
-		log_string_plus("Interrupt not handled:  irq_pending_2: ", arm_interrupt_registers->irq_pending_2);
+		unhandled_interrupt_count++;
+		log_string_plus("Interrupt not handled:  irq_basic_pending: ", REG_READ(arm_interrupt_registers->irq_basic_pending));
+		log_string_plus("Interrupt not handled:  irq_pending_1: ", REG_READ(arm_interrupt_registers->irq_pending_1));
+		log_string_plus("Interrupt not handled:  irq_pending_2: ", REG_READ(arm_interrupt_registers->irq_pending_2));
 	}
+	interrupt_handler_record_duration(&irq_stats, read_cycle_counter() - entry_cycles);
 }
 
 /*  Add an interrupt handler and enable interrupts on both the peripheral section
-	and the CPU.
+	and the CPU.  New handlers start out at medium priority.
 */
 
 int interrupt_handler_add(InterruptHandlerStatus (*handler_ptr)(void), InterruptType type,
 GPIO_Pins pin)
 {
-	int to_return = number_of_handlers;
-	if (number_of_handlers < MAX_INTERRUPT_HANDLER_FUNCTIONS)
+	int to_return = -1;
+	Interrupt_Source_Mask source;
+	if ((number_of_handlers < MAX_INTERRUPT_HANDLER_FUNCTIONS) &&
+		(interrupt_handler_get_source(type, pin, &source) == RPi_Success))
 	{
+		uint32_t saved_cpsr = enter_critical_section();
 		int index = 0;
 		for(; interrupt_handler_info_array[index].handler_ptr != NULL_PTR; index++);
+		interrupt_handler_clear_duration_stats(&handler_stats[index]);
 		interrupt_handler_info_array[index].handler_ptr = handler_ptr;
 		interrupt_handler_info_array[index].type = type;
 		interrupt_handler_info_array[index].pin = pin;
+		interrupt_handler_info_array[index].priority = Int_Priority_Medium;
+		interrupt_handler_info_array[index].source = source;
 		number_of_handlers++;
-		switch(type)
-		{
-			case Int_Basic:
-			{
-				number_of_basic_handlers++;
-				arm_interrupt_registers->enable_basic_irqs |= ARM_BASIC_INTERRUPT;
-				break;
-			}
-			case Int_GPIO_Pin:
-			{
-				//Note:  The raspberry pi zero only has 2 GPIO banks
-				uint32_t gpio_bank = pin / GPIO_PINS_PER_INTERRUPT_REG;
-				switch(gpio_bank)
-				{
-					case 0:
-					{
-						number_of_gpio_low_handlers++;
-						arm_interrupt_registers->enable_irqs_2 |= (1 <<GPIO_PIN_INTERRUPT_LOW_BANK);
-						break;
-					}
-					case 1:
-					{
-						number_of_gpio_high_handlers++;
-						arm_interrupt_registers->enable_irqs_2 |= (1 <<GPIO_PIN_INTERRUPT_HIGH_BANK);
-						break;
-					}
-					default:
-					{
-						log_string_plus("interrupt_handler_add: invalid bank: ", gpio_bank);
-						interrupt_handler_info_array[index].handler_ptr = NULL_PTR;
-						to_return = -1;
-						break;
-					}
-				}
-				break;
-			}
-			case Int_GPIO_All:
-			{
-				number_of_gpio_all_handlers++;
-				arm_interrupt_registers->enable_irqs_2 |= (1 << GPIO_PIN_INTERRUPT_ALL_EVENTS);
-				break;
-			}
-			default:
-			{
-				log_string_plus("interrupt_handler_add: invalid parameter: ", type);
-				interrupt_handler_info_array[index].handler_ptr = NULL_PTR;
-				to_return = -1;
-				break;
-			}
-		}	
-		if (to_return > 0)
-		{
-			enable_cpu_interrupts();
-		}
-	}
-	else
-	{
-		to_return = -1;
+		interrupt_handler_update_priority_masks();
+		interrupt_handler_enable_source(&source);
+		exit_critical_section(saved_cpsr);
+		enable_cpu_interrupts();
+		to_return = index;
 	}
 	return to_return;
 }
 
-/*  Remove a handler and if no one else is expecting interrupts then
-	disable interrupts on both the peripherals section and the CPU.
+/*  Remove a handler and if no one else is expecting interrupts from its source
+	then disable the source, and if no one at all is then the CPU as well.
 */
 	
 Error_Returns interrupt_handler_remove(int handler_index)
@@ -199,58 +500,23 @@ Error_Returns interrupt_handler_remove(int handler_index)
 	if ((handler_index >= 0) &&
 	  (handler_index < MAX_INTERRUPT_HANDLER_FUNCTIONS) && 
 	  (interrupt_handler_info_array[handler_index].handler_ptr != NULL_PTR))
-	  {
-		  interrupt_handler_info_array[handler_index].handler_ptr = NULL_PTR;	  
-		  switch(interrupt_handler_info_array[handler_index].type)
-		  {
-			  case Int_Basic:
-			  {
-				  number_of_basic_handlers--;
-				  if (number_of_basic_handlers == 0)
-				  {
-					  arm_interrupt_registers->disable_basic_irqs &= ~(ARM_BASIC_INTERRUPT);
-				  }
-				  break;
-			  }
-			  case Int_GPIO_Pin:
-			  {		
-				//Note:  The raspberry pi zero only has 2 GPIO banks
-				uint32_t gpio_bank = interrupt_handler_info_array[handler_index].pin / GPIO_PINS_PER_INTERRUPT_REG;
-				switch(gpio_bank)
-				{
-					case 0:
-					{	
-						number_of_gpio_low_handlers--;
-						if (number_of_gpio_low_handlers == 0)
-						{		
-							arm_interrupt_registers->enable_irqs_2 &= ~(1 << GPIO_PIN_INTERRUPT_LOW_BANK);
-						}
-						break;
-					}
-					case 1:
-					{
-						number_of_gpio_high_handlers--;
-						if (number_of_gpio_high_handlers == 0)
-						{
-							arm_interrupt_registers->enable_irqs_2 &= ~(1 << GPIO_PIN_INTERRUPT_HIGH_BANK);
-						}
-						break;
-					}
-				}
-				break;
-			}
-			case Int_GPIO_All:
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		Interrupt_Source_Mask unused = interrupt_handler_info_array[handler_index].source;
+		interrupt_handler_info_array[handler_index].handler_ptr = NULL_PTR;
+		for (uint32_t index = 0; index < MAX_INTERRUPT_HANDLER_FUNCTIONS; index++)
+		{
+			if (interrupt_handler_info_array[index].handler_ptr != NULL_PTR)
 			{
-				number_of_gpio_all_handlers--;
-				if (number_of_gpio_all_handlers == 0)
-				{
-					arm_interrupt_registers->enable_irqs_2 &= ~(1 << GPIO_PIN_INTERRUPT_ALL_EVENTS);
-				}
-				break;
+				unused.basic &= ~interrupt_handler_info_array[index].source.basic;
+				unused.irq_1 &= ~interrupt_handler_info_array[index].source.irq_1;
+				unused.irq_2 &= ~interrupt_handler_info_array[index].source.irq_2;
 			}
 		}
-		  
+		interrupt_handler_disable_source(&unused);
+		interrupt_handler_update_priority_masks();
 		number_of_handlers--;
+		exit_critical_section(saved_cpsr);
 		if (number_of_handlers == 0)
 		{
 			disable_cpu_interrupts();
@@ -263,6 +529,31 @@ Error_Returns interrupt_handler_remove(int handler_index)
 	return to_return;
 }
 
+/*  Handlers sharing a controller source (the GPIO banks for instance) can't
+	preempt each other so in effect the source runs at the priority of its
+	least important handler.
+*/
+
+Error_Returns interrupt_handler_set_priority(int handler_index, InterruptPriority priority)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((handler_index >= 0) &&
+	  (handler_index < MAX_INTERRUPT_HANDLER_FUNCTIONS) && 
+	  (interrupt_handler_info_array[handler_index].handler_ptr != NULL_PTR) &&
+	  (priority < Int_Priority_Count))
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		interrupt_handler_info_array[handler_index].priority = priority;
+		interrupt_handler_update_priority_masks();
+		exit_critical_section(saved_cpsr);
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
 int interrupt_handler_basic_add(InterruptHandlerStatus (*handler_ptr)(void))
 {
 	return interrupt_handler_add(handler_ptr, Int_Basic, gpio_pin_0);
@@ -0,0 +1,478 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  pwm.c
+
+Implementation of the hardware PWM on the Broadcom 2835.  The PWM clock comes
+from the clock manager (PLLD through an integer divider).  Each channel runs in
+mark-space mode, the output is high for DAT ticks out of every RNG, which is
+what a servo or ESC wants.  A new pulse width written to DAT takes effect at
+the start of the next period so there are no runt pulses.
+
+When a DMA sequence is running its channel takes its pulse widths from the
+FIFO instead of DAT, one word per period, with the DMA engine topping the FIFO
+up on DREQ.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_access.h"
+#include "pwm.h"
+#include "gpio.h"
+#include "system_timer.h"
+#include "log.h"
+
+#define CM_PASSWORD			0x5A000000
+#define CM_SOURCE_PLLD		6
+#define CM_ENABLE			(1 << 4)
+#define CM_KILL				(1 << 5)
+#define CM_BUSY				(1 << 7)
+#define CM_DIVI_SHIFT		12
+#define CM_PWM_OFFSET		0xA0
+#define PLLD_CLOCK_HZ		500000000
+#define PWM_CLOCK_DIVISOR	(PLLD_CLOCK_HZ / PWM_CLOCK_HZ)
+#define PWM_CLOCK_TIMEOUT_US 1000
+
+//Per channel control bits, channel 2's are 8 up
+#define PWM_CONTROL_ENABLE			0x01
+#define PWM_CONTROL_SERIALIZE		0x02
+#define PWM_CONTROL_REPEAT_LAST		0x04
+#define PWM_CONTROL_SILENCE_HIGH	0x08
+#define PWM_CONTROL_INVERT			0x10
+#define PWM_CONTROL_USE_FIFO		0x20
+#define PWM_CONTROL_CLEAR_FIFO		0x40  //Only in channel 1's bits, clears the shared FIFO
+#define PWM_CONTROL_MARK_SPACE		0x80
+#define PWM_CONTROL_CHANNEL_BITS	0xFF
+#define PWM_CONTROL_CHANNEL_SHIFT	8
+
+#define PWM_FIFO_OFFSET				0x18
+#define PWM_STATUS_ERRORS			0x10C  //Bus error and FIFO read/write errors, write 1 to clear
+
+#define PWM_DMA_ENABLE				(1u << 31)
+#define PWM_DMA_PANIC_SHIFT			8
+#define PWM_DMA_THRESHOLD			7  //FIFO words, for both DREQ and panic
+#define PWM_MAX_PERIOD_US			(0xFFFFFFFF / PWM_TICKS_PER_MICROSECOND)
+
+//DMA channel 5 isn't one the firmware uses
+#define PWM_DMA_CHANNEL				5
+#define DMA_CHANNEL_SPACING			0x100
+#define DMA_ENABLE_OFFSET			0xFF0
+#define DMA_CS_ACTIVE				(1 << 0)
+#define DMA_CS_END					(1 << 1)
+#define DMA_CS_INTERRUPT			(1 << 2)
+#define DMA_CS_ERROR				(1 << 8)
+#define DMA_CS_PRIORITY_SHIFT		16
+#define DMA_CS_PANIC_PRIORITY_SHIFT	20
+#define DMA_CS_WAIT_FOR_WRITES		(1 << 28)
+#define DMA_CS_RESET				(1u << 31)
+#define DMA_PRIORITY				8
+#define DMA_TI_WAIT_RESPONSE		(1 << 3)
+#define DMA_TI_DEST_DREQ			(1 << 6)
+#define DMA_TI_SOURCE_INCREMENT		(1 << 8)
+#define DMA_TI_PERMAP_SHIFT			16
+#define DMA_TI_NO_WIDE_BURSTS		(1 << 26)
+#define DMA_PERMAP_PWM				5
+#define DMA_MAX_TRANSFER			0x3FFFFFFF
+#define DMA_DEBUG_ERRORS			0x7  //Read, FIFO and read last not set errors
+
+#define BUS_ADDRESS(pointer) ((uint32_t)(pointer) | BUS_RAM_ALIAS)
+
+typedef struct {
+	uint32_t control;
+	uint32_t status;
+	uint32_t dma_configuration;
+	uint32_t reserved_0;
+	uint32_t range_1;
+	uint32_t data_1;
+	uint32_t fifo;
+	uint32_t reserved_1;
+	uint32_t range_2;
+	uint32_t data_2;
+} PWM_Registers;
+
+typedef struct {
+	uint32_t control;
+	uint32_t divisor;
+} Clock_Manager_Registers;
+
+typedef struct {
+	uint32_t control_status;
+	uint32_t control_block_address;
+	uint32_t transfer_information;
+	uint32_t source_address;
+	uint32_t destination_address;
+	uint32_t transfer_length;
+	uint32_t stride;
+	uint32_t next_control_block;
+	uint32_t debug;
+} DMA_Channel_Registers;
+
+//Read by the DMA engine from memory, it has to be on a 32 byte boundary
+typedef struct {
+	uint32_t transfer_information;
+	uint32_t source_address;
+	uint32_t destination_address;
+	uint32_t transfer_length;
+	uint32_t stride;
+	uint32_t next_control_block;
+	uint32_t reserved[2];
+} __attribute__((aligned(32))) DMA_Control_Block;
+
+typedef struct {
+	uint32_t enabled;
+	GPIO_Pins pin;  //Kept set up once configured, the GPIO has no way to give a pin back
+	uint32_t pin_configured;
+	uint32_t range;  //Period in PWM clock ticks
+} PWM_Channel_Info;
+
+static volatile PWM_Registers *pwm_registers = (PWM_Registers *)PWM_BASE;
+static volatile Clock_Manager_Registers *pwm_clock_registers = (Clock_Manager_Registers *)(CM_BASE + CM_PWM_OFFSET);
+static volatile DMA_Channel_Registers *dma_registers =
+	(DMA_Channel_Registers *)(DMA_BASE + (PWM_DMA_CHANNEL * DMA_CHANNEL_SPACING));
+static volatile uint32_t *dma_enable_register = (uint32_t *)(DMA_BASE + DMA_ENABLE_OFFSET);
+
+static PWM_Channel_Info channel_info[pwm_channel_count];
+static DMA_Control_Block dma_control_block;
+static int dma_channel = -1;  //The PWM channel the DMA is feeding, if any
+static unsigned char pwm_initialized = 0;
+
+COLD void pwm_dump_registers(void)
+{
+	log_string_plus("PWM clock control: ", REG_READ(pwm_clock_registers->control));
+	log_string_plus("PWM clock divisor: ", REG_READ(pwm_clock_registers->divisor));
+	log_string_plus("PWM control: ", REG_READ(pwm_registers->control));
+	log_string_plus("PWM status: ", REG_READ(pwm_registers->status));
+	log_string_plus("PWM DMA configuration: ", REG_READ(pwm_registers->dma_configuration));
+	log_string_plus("PWM range 1: ", REG_READ(pwm_registers->range_1));
+	log_string_plus("PWM data 1: ", REG_READ(pwm_registers->data_1));
+	log_string_plus("PWM range 2: ", REG_READ(pwm_registers->range_2));
+	log_string_plus("PWM data 2: ", REG_READ(pwm_registers->data_2));
+	log_string_plus("PWM DMA control status: ", REG_READ(dma_registers->control_status));
+}
+
+static volatile uint32_t *pwm_range_register(PWMChannel channel)
+{
+	return (channel == pwm_channel_1) ? &pwm_registers->range_1 : &pwm_registers->range_2;
+}
+
+static volatile uint32_t *pwm_data_register(PWMChannel channel)
+{
+	return (channel == pwm_channel_1) ? &pwm_registers->data_1 : &pwm_registers->data_2;
+}
+
+static uint32_t pwm_control_bits(PWMChannel channel, uint32_t bits)
+{
+	return bits << (channel * PWM_CONTROL_CHANNEL_SHIFT);
+}
+
+/*  The clock manager must not be changed while it is running, so it is stopped
+	and given time to finish the cycle it is on before the divisor is set.
+	Every write carries the password or it is ignored.
+*/
+
+COLD static Error_Returns pwm_clock_start(void)
+{
+	Error_Returns to_return = RPi_Success;
+	REG_WRITE(pwm_clock_registers->control, CM_PASSWORD | CM_SOURCE_PLLD);
+	uint64_t deadline = timer_deadline_us(PWM_CLOCK_TIMEOUT_US);
+	while (REG_READ(pwm_clock_registers->control) & CM_BUSY)
+	{
+		if (timer_deadline_reached(deadline))
+		{
+			//Glitches the clock but the PWM is stopped so nothing sees it
+			REG_WRITE(pwm_clock_registers->control, CM_PASSWORD | CM_SOURCE_PLLD | CM_KILL);
+			break;
+		}
+	}
+	if (REG_READ(pwm_clock_registers->control) & CM_BUSY)
+	{
+		log_string_plus("pwm_clock_start: clock won't stop: ", REG_READ(pwm_clock_registers->control));
+		to_return = RPi_Timeout;
+	}
+	else
+	{
+		REG_WRITE(pwm_clock_registers->divisor, CM_PASSWORD | (PWM_CLOCK_DIVISOR << CM_DIVI_SHIFT));
+		REG_WRITE(pwm_clock_registers->control, CM_PASSWORD | CM_SOURCE_PLLD | CM_ENABLE);
+	}
+	return to_return;
+}
+
+COLD Error_Returns pwm_init(void)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!pwm_initialized)
+	{
+		do
+		{
+			to_return = gpio_init();
+			if (to_return != RPi_Success)
+			{
+				log_string_plus("pwm_init: gpio_init failed: ", to_return);
+				break;
+			}
+			REG_WRITE(pwm_registers->dma_configuration, 0);
+			REG_WRITE(pwm_registers->control, 0);
+			to_return = pwm_clock_start();
+			if (to_return != RPi_Success)
+			{
+				break;
+			}
+			REG_WRITE(pwm_registers->status, PWM_STATUS_ERRORS);
+			for (uint32_t channel = 0; channel < pwm_channel_count; channel++)
+			{
+				channel_info[channel].enabled = 0;
+				channel_info[channel].pin_configured = 0;
+				channel_info[channel].range = 0;
+			}
+			dma_channel = -1;
+			pwm_initialized = 1;
+		} while(0);
+	}
+	return to_return;
+}
+
+/*  Start a channel on one of its pins with the given period, the output stays
+	low until a pulse width is set.  A channel can be enabled again (to change
+	its period) but only on the pin it was first given.
+*/
+
+COLD Error_Returns pwm_channel_enable(PWMChannel channel, GPIO_Pins pin, uint32_t period_us)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (!pwm_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((channel >= pwm_channel_count) || (period_us == 0) || (period_us > PWM_MAX_PERIOD_US))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+
+		PWM_Channel_Info *info = &channel_info[channel];
+		GPIO_Pin_Config pin_config = {pin, gpio_alt_0, pupd_disable};
+		if ((pin == gpio_pin_18) || (pin == gpio_pin_19))
+		{
+			pin_config.function = gpio_alt_5;
+		}
+		if (((channel == pwm_channel_1) && (pin != gpio_pin_12) && (pin != gpio_pin_18)) ||
+			((channel == pwm_channel_2) && (pin != gpio_pin_13) && (pin != gpio_pin_19)) ||
+			(info->pin_configured && (pin != info->pin)))
+		{
+			log_string_plus("pwm_channel_enable: pin can't be used for this channel: ", pin);
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		if (!info->pin_configured)
+		{
+			to_return = gpio_configure(&pin_config, 1);
+			if (to_return != RPi_Success)
+			{
+				log_string_plus("pwm_channel_enable: failed to set up pin ", pin);
+				break;
+			}
+			info->pin = pin;
+			info->pin_configured = 1;
+		}
+
+		info->range = period_us * PWM_TICKS_PER_MICROSECOND;
+		REG_WRITE(*pwm_range_register(channel), info->range);
+		REG_WRITE(*pwm_data_register(channel), 0);
+		REG_WRITE(pwm_registers->control, (REG_READ(pwm_registers->control) &
+			~pwm_control_bits(channel, PWM_CONTROL_CHANNEL_BITS)) |
+			pwm_control_bits(channel, PWM_CONTROL_MARK_SPACE | PWM_CONTROL_ENABLE));
+		info->enabled = 1;
+	} while(0);
+	return to_return;
+}
+
+//The pin is left as a PWM output, low
+COLD Error_Returns pwm_channel_disable(PWMChannel channel)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!pwm_initialized)
+	{
+		to_return = RPi_NotInitialized;
+	}
+	else if (channel >= pwm_channel_count)
+	{
+		to_return = RPi_InvalidParam;
+	}
+	else
+	{
+		if (dma_channel == (int)channel)
+		{
+			pwm_dma_stop();
+		}
+		REG_WRITE(pwm_registers->control, REG_READ(pwm_registers->control) &
+			~pwm_control_bits(channel, PWM_CONTROL_CHANNEL_BITS));
+		channel_info[channel].enabled = 0;
+	}
+	return to_return;
+}
+
+/*  The pulse width in PWM clock ticks, it can't be longer than the period.
+	Not allowed while DMA is feeding the channel, DAT isn't used then.
+*/
+
+HOT static Error_Returns pwm_set_pulse_ticks(PWMChannel channel, uint32_t ticks)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!pwm_initialized)
+	{
+		to_return = RPi_NotInitialized;
+	}
+	else if ((channel >= pwm_channel_count) || !channel_info[channel].enabled ||
+		(ticks > channel_info[channel].range))
+	{
+		to_return = RPi_InvalidParam;
+	}
+	else if (dma_channel == (int)channel)
+	{
+		to_return = RPi_InUse;
+	}
+	else
+	{
+		REG_WRITE(*pwm_data_register(channel), ticks);
+	}
+	return to_return;
+}
+
+HOT Error_Returns pwm_set_pulse_us(PWMChannel channel, uint32_t pulse_us)
+{
+	Error_Returns to_return = RPi_InvalidParam;
+	if (pulse_us <= PWM_MAX_PERIOD_US)
+	{
+		to_return = pwm_set_pulse_ticks(channel, pulse_us * PWM_TICKS_PER_MICROSECOND);
+	}
+	return to_return;
+}
+
+HOT Error_Returns pwm_set_pulse_ns(PWMChannel channel, uint32_t pulse_ns)
+{
+	return pwm_set_pulse_ticks(channel, pulse_ns / PWM_NS_PER_TICK);
+}
+
+/*  The DMA engine reads the buffer and the control block from memory, not the
+	data cache, so both are cleaned out to memory before it starts.  With loop
+	set the control block points at itself.
+*/
+
+Error_Returns pwm_dma_start(PWMChannel channel, const uint32_t *pulse_ticks, uint32_t count, uint32_t loop)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t index;
+	do
+	{
+		if (!pwm_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((channel >= pwm_channel_count) || !channel_info[channel].enabled || (pulse_ticks == NULL_PTR) ||
+			((uint32_t)pulse_ticks & (sizeof(uint32_t) - 1)) || (count == 0) ||
+			(count > (DMA_MAX_TRANSFER / sizeof(uint32_t))))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		//A pulse longer than the period is refused the same as pwm_set_pulse_xx would
+		for (index = 0; (index < count) && (pulse_ticks[index] <= channel_info[channel].range); index++)
+		{
+		}
+		if (index < count)
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		if (dma_channel >= 0)
+		{
+			to_return = RPi_InUse;
+			break;
+		}
+
+		dma_control_block.transfer_information = DMA_TI_NO_WIDE_BURSTS | (DMA_PERMAP_PWM << DMA_TI_PERMAP_SHIFT) |
+			DMA_TI_SOURCE_INCREMENT | DMA_TI_DEST_DREQ | DMA_TI_WAIT_RESPONSE;
+		dma_control_block.source_address = BUS_ADDRESS(pulse_ticks);
+		dma_control_block.destination_address = BUS_PERIPHERAL_BASE + (PWM_BASE - P_BASE) + PWM_FIFO_OFFSET;
+		dma_control_block.transfer_length = count * sizeof(uint32_t);
+		dma_control_block.stride = 0;
+		dma_control_block.next_control_block = loop ? BUS_ADDRESS(&dma_control_block) : 0;
+		clean_dcache_range(pulse_ticks, count * sizeof(uint32_t));
+		clean_dcache_range(&dma_control_block, sizeof(dma_control_block));
+
+		//Empty the FIFO and switch the channel over to it, holding the last word when it runs dry
+		REG_WRITE(pwm_registers->dma_configuration, 0);
+		REG_WRITE(pwm_registers->control, REG_READ(pwm_registers->control) | PWM_CONTROL_CLEAR_FIFO);
+		REG_WRITE(pwm_registers->status, PWM_STATUS_ERRORS);
+		REG_WRITE(pwm_registers->control, REG_READ(pwm_registers->control) |
+			pwm_control_bits(channel, PWM_CONTROL_USE_FIFO | PWM_CONTROL_REPEAT_LAST));
+
+		REG_WRITE(*dma_enable_register, REG_READ(*dma_enable_register) | (1 << PWM_DMA_CHANNEL));
+		REG_WRITE(dma_registers->control_status, DMA_CS_RESET);
+		REG_WRITE(dma_registers->control_status, DMA_CS_END | DMA_CS_INTERRUPT);
+		REG_WRITE(dma_registers->control_block_address, BUS_ADDRESS(&dma_control_block));
+		REG_WRITE(dma_registers->control_status, DMA_CS_WAIT_FOR_WRITES | (DMA_PRIORITY << DMA_CS_PRIORITY_SHIFT) |
+			(DMA_PRIORITY << DMA_CS_PANIC_PRIORITY_SHIFT) | DMA_CS_ACTIVE);
+		REG_WRITE(pwm_registers->dma_configuration, PWM_DMA_ENABLE |
+			(PWM_DMA_THRESHOLD << PWM_DMA_PANIC_SHIFT) | PWM_DMA_THRESHOLD);
+		dma_channel = channel;
+	} while(0);
+	return to_return;
+}
+
+/*  Stop feeding the channel and go back to DAT, the output picks up the last
+	pulse width set with pwm_set_pulse_xx at the next period.
+*/
+
+Error_Returns pwm_dma_stop(void)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!pwm_initialized)
+	{
+		to_return = RPi_NotInitialized;
+	}
+	else if (dma_channel >= 0)
+	{
+		//The reset clears the error flag so latch it first
+		uint32_t dma_status = REG_READ(dma_registers->control_status);
+		REG_WRITE(dma_registers->control_status, 0);
+		REG_WRITE(dma_registers->control_status, DMA_CS_RESET);
+		REG_WRITE(pwm_registers->dma_configuration, 0);
+		REG_WRITE(pwm_registers->control, REG_READ(pwm_registers->control) &
+			~pwm_control_bits(dma_channel, PWM_CONTROL_USE_FIFO | PWM_CONTROL_REPEAT_LAST));
+		REG_WRITE(pwm_registers->control, REG_READ(pwm_registers->control) | PWM_CONTROL_CLEAR_FIFO);
+		if (dma_status & DMA_CS_ERROR)
+		{
+			log_string_plus("pwm_dma_stop: DMA debug: ", REG_READ(dma_registers->debug) & DMA_DEBUG_ERRORS);
+		}
+		dma_channel = -1;
+	}
+	return to_return;
+}
+
+//Still running through the buffer, always the case for a loop
+uint32_t pwm_dma_busy(void)
+{
+	return (dma_channel >= 0) && (REG_READ(dma_registers->control_status) & DMA_CS_ACTIVE);
+}
@@ -27,6 +27,7 @@ function.
 #include "spi.h"
 #include "log.h"
 #include "reg_definitions.h"
+#include "reg_access.h"
 #include "gpio.h"
 
 #define SPI_INIT_BIT 1
@@ -59,65 +60,40 @@ typedef struct {
 static unsigned char spi_ready = 0;
 static volatile SPI_Registers *spi_registers = (SPI_Registers *)SPI0_BASE;
 
-void spi_dump_registers()
+//CE1, CE0, MISO, MOSI and SCLK
+static const GPIO_Pin_Config spi_pins[] = {
+	{gpio_pin_7, gpio_alt_0, pupd_disable},
+	{gpio_pin_8, gpio_alt_0, pupd_disable},
+	{gpio_pin_9, gpio_alt_0, pupd_disable},
+	{gpio_pin_10, gpio_alt_0, pupd_disable},
+	{gpio_pin_11, gpio_alt_0, pupd_disable}
+};
+
+COLD void spi_dump_registers()
 {
-	log_string_plus("SPI Command Status: ", spi_registers->spi_command_status);
-	log_string_plus("SPI Clock Divider: ", spi_registers->spi_clock_divider);
-	log_string_plus("SPI Data Length: ", spi_registers->spi_data_length);
-	log_string_plus("SPI LOSSI TOH: ", spi_registers->spi_lossi_TOH);
-	log_string_plus("SPI DMA Control: ", spi_registers->spi_DMA_control);
+	log_string_plus("SPI Command Status: ", REG_READ(spi_registers->spi_command_status));
+	log_string_plus("SPI Clock Divider: ", REG_READ(spi_registers->spi_clock_divider));
+	log_string_plus("SPI Data Length: ", REG_READ(spi_registers->spi_data_length));
+	log_string_plus("SPI LOSSI TOH: ", REG_READ(spi_registers->spi_lossi_TOH));
+	log_string_plus("SPI DMA Control: ", REG_READ(spi_registers->spi_DMA_control));
 }
 
-Error_Returns spi_init()
+COLD Error_Returns spi_init()
 {
 	Error_Returns to_return = RPi_Success;
 	if (!spi_ready)
 	{
 		do
 		{
-			to_return = gpio_set_function_select(gpio_pin_7, gpio_alt_0);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("spi_init: failed to set up pin ", gpio_pin_7);
-				break;
-			}
-			
-			to_return = gpio_set_function_select(gpio_pin_8, gpio_alt_0);
+			to_return = gpio_configure(spi_pins, GPIO_CONFIG_COUNT(spi_pins));
 			if (to_return != RPi_Success)
 			{
-				log_string_plus("spi_init: failed to set up pin ", gpio_pin_8);
+				log_string_plus("spi_init: failed to set up pins, status: ", to_return);
 				break;
 			}
 
-			to_return = gpio_set_function_select(gpio_pin_9, gpio_alt_0);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("spi_init: failed to set up pin ", gpio_pin_9);
-				break;
-			}
-
-			to_return = gpio_set_function_select(gpio_pin_10, gpio_alt_0);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("spi_init: failed to set up pin ", gpio_pin_10);
-				break;
-			}
-
-			to_return = gpio_set_function_select(gpio_pin_11, gpio_alt_0);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("spi_init: failed to set up pin ", gpio_pin_11);
-				break;
-			}
-
-			gpio_set_pullup_pulldown(gpio_pin_7, pupd_disable);
-			gpio_set_pullup_pulldown(gpio_pin_8, pupd_disable);
-			gpio_set_pullup_pulldown(gpio_pin_9, pupd_disable);
-			gpio_set_pullup_pulldown(gpio_pin_10, pupd_disable);
-			gpio_set_pullup_pulldown(gpio_pin_11, pupd_disable);
-
-			spi_registers->spi_command_status = ( 1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT);
-			spi_registers->spi_clock_divider = SPI_CLOCK;
+			REG_WRITE(spi_registers->spi_command_status, ( 1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT));
+			REG_WRITE(spi_registers->spi_clock_divider, SPI_CLOCK);
 			spi_ready = 1;
 		} while(0);
 	}
@@ -131,16 +107,16 @@ Error_Returns spi_read(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA cloc
 	uint32_t index = 0;
 	Error_Returns to_return = RPi_Success;
 	
-	spi_registers->spi_command_status = (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT);
-	spi_registers->spi_command_status = (1 << SPI_CS_TA_BIT | chip_select_polarity << SPI_CS_CSPOL_BIT | 
-	   clock_polarity << SPI_CS_CPOL_BIT | clock_phase << SPI_CS_CPHA_BIT | chip_enable);
+	REG_WRITE(spi_registers->spi_command_status, (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT));
+	REG_WRITE(spi_registers->spi_command_status, (1 << SPI_CS_TA_BIT | chip_select_polarity << SPI_CS_CSPOL_BIT |
+	   clock_polarity << SPI_CS_CPOL_BIT | clock_phase << SPI_CS_CPHA_BIT | chip_enable));
 	
 	do
 	{	
 		deadman = 0;
 		while (deadman < DEADMAN_TIMEOUT)
 		{
-			if (spi_registers->spi_command_status & (1 << SPI_CS_TX_READY_BIT)) break;
+			if (REG_READ(spi_registers->spi_command_status) & (1 << SPI_CS_TX_READY_BIT)) break;
 			deadman++;	
 		}
 		
@@ -152,14 +128,14 @@ Error_Returns spi_read(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA cloc
 		}
 		
 		if (index < command_bytes)
-			spi_registers->spi_FIFOs = command_buffer[index];
+			REG_WRITE(spi_registers->spi_FIFOs, command_buffer[index]);
 		else
-			spi_registers->spi_FIFOs = 0;
+			REG_WRITE(spi_registers->spi_FIFOs, 0);
 				
 		deadman = 0;
 		while(deadman < DEADMAN_TIMEOUT) 
 		{
-			if(spi_registers->spi_command_status & (1 << SPI_CS_RX_DATA_BIT)) break;
+			if(REG_READ(spi_registers->spi_command_status) & (1 << SPI_CS_RX_DATA_BIT)) break;
 			deadman++;
 		}
 		
@@ -172,11 +148,11 @@ Error_Returns spi_read(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA cloc
 		
 		if (index == 0)  //Dump the first word out of the read FIFO, it is garbage
 		{
-			command_buffer[index] = spi_registers->spi_FIFOs;
+			command_buffer[index] = REG_READ(spi_registers->spi_FIFOs);
 		}
 		else
 		{
-			command_buffer[index - 1] = spi_registers->spi_FIFOs;
+			command_buffer[index - 1] = REG_READ(spi_registers->spi_FIFOs);
 		}
 		index++;
 	} while(index < command_bytes + 1);
@@ -186,7 +162,7 @@ Error_Returns spi_read(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA cloc
 		deadman = 0;
 		while (deadman < DEADMAN_TIMEOUT)
 		{
-			if (spi_registers->spi_command_status & (1 << SPI_CS_CMD_DONE_BIT)) break;
+			if (REG_READ(spi_registers->spi_command_status) & (1 << SPI_CS_CMD_DONE_BIT)) break;
 			deadman++;	
 		}		
 		if (deadman >= DEADMAN_TIMEOUT)
@@ -196,7 +172,7 @@ Error_Returns spi_read(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA cloc
 		}
 	}
 	
-	spi_registers->spi_command_status = (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT);
+	REG_WRITE(spi_registers->spi_command_status, (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT));
 	return to_return;
 }
 
@@ -207,16 +183,16 @@ Error_Returns spi_write(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA clo
 	uint32_t index = 0;
 	Error_Returns to_return = RPi_Success;
 	
-	spi_registers->spi_command_status = (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT);
-	spi_registers->spi_command_status = (1 << SPI_CS_TA_BIT | chip_select_polarity << SPI_CS_CSPOL_BIT | 
-	   clock_polarity << SPI_CS_CPOL_BIT | clock_phase << SPI_CS_CPHA_BIT | chip_enable);
+	REG_WRITE(spi_registers->spi_command_status, (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT));
+	REG_WRITE(spi_registers->spi_command_status, (1 << SPI_CS_TA_BIT | chip_select_polarity << SPI_CS_CSPOL_BIT |
+	   clock_polarity << SPI_CS_CPOL_BIT | clock_phase << SPI_CS_CPHA_BIT | chip_enable));
 	
 	do
 	{	
 		deadman = 0;
 		while (deadman < DEADMAN_TIMEOUT)
 		{
-			if (spi_registers->spi_command_status & (1 << SPI_CS_TX_READY_BIT)) break;
+			if (REG_READ(spi_registers->spi_command_status) & (1 << SPI_CS_TX_READY_BIT)) break;
 			deadman++;	
 		}
 		
@@ -227,7 +203,7 @@ Error_Returns spi_write(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA clo
 			break;  //Jump to clean up and return
 		}
 		
-		spi_registers->spi_FIFOs = command_buffer[index++];
+		REG_WRITE(spi_registers->spi_FIFOs, command_buffer[index++]);
 	} while(index < command_bytes);
 	
 	if (to_return == RPi_Success)
@@ -235,7 +211,7 @@ Error_Returns spi_write(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA clo
 		deadman = 0;
 		while (deadman < DEADMAN_TIMEOUT)
 		{
-			if (spi_registers->spi_command_status & (1 << SPI_CS_CMD_DONE_BIT)) break;
+			if (REG_READ(spi_registers->spi_command_status) & (1 << SPI_CS_CMD_DONE_BIT)) break;
 			deadman++;	
 		}		
 		if (deadman >= DEADMAN_TIMEOUT)
@@ -245,6 +221,6 @@ Error_Returns spi_write(SPI_CE chip_enable, SPI_POL clock_polarity, SPI_CPHA clo
 		}
 	}
 
-	spi_registers->spi_command_status = (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT);
+	REG_WRITE(spi_registers->spi_command_status, (1 << SPI_CS_CLEAR_RX_BIT | 1 << SPI_CS_CLEAR_TX_BIT));
 	return to_return;
 }
\ No newline at end of file
@@ -0,0 +1,222 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  system_timer.c
+
+Implementation of the System Timer support on the Broadcom 2835.  The counter
+is read as two 32 bit halves so the high half is read either side of the low
+half to catch a carry in between.  The compare registers only match on the low
+32 bits so a one shot can be at most about 71 minutes out.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_access.h"
+#include "system_timer.h"
+#include "interrupt_handler.h"
+#include "log.h"
+
+#define SYSTEM_TIMER_CHANNELS 4
+#define SYSTEM_TIMER_MAX_ONE_SHOT 0xFFFFFFFF
+
+typedef struct {
+	uint32_t control_status;
+	uint32_t counter_low;
+	uint32_t counter_high;
+	uint32_t compare[SYSTEM_TIMER_CHANNELS];
+} System_Timer_Registers;
+
+typedef struct {
+	void (*handler_ptr)(uint32_t argument);
+	uint32_t argument;
+	int interrupt_handler_index;
+} System_Timer_Channel_Info;
+
+static volatile System_Timer_Registers *system_timer_registers = (System_Timer_Registers *)SYSTEM_TIMER_BASE;
+static System_Timer_Channel_Info channel_info[SYSTEM_TIMER_CHANNELS];
+static unsigned char system_timer_initialized = 0;
+
+/*  The match bits in control_status are write 1 to clear.  A one shot is
+	finished once it fires so the handler is dropped before it is called, it
+	can set up the next one if it wants.
+*/
+
+HOT static InterruptHandlerStatus system_timer_channel_interrupt(uint32_t channel)
+{
+	InterruptHandlerStatus to_return = Interrupt_Not_Claimed;
+	if (REG_READ(system_timer_registers->control_status) & (1 << channel))
+	{
+		REG_WRITE(system_timer_registers->control_status, (1 << channel));
+		void (*handler_ptr)(uint32_t argument) = channel_info[channel].handler_ptr;
+		channel_info[channel].handler_ptr = NULL_PTR;
+		if (handler_ptr != NULL_PTR)
+		{
+			handler_ptr(channel_info[channel].argument);
+		}
+		to_return = Interrupt_Claimed;
+	}
+	return to_return;
+}
+
+HOT static InterruptHandlerStatus system_timer_channel_1_interrupt(void)
+{
+	return system_timer_channel_interrupt(system_timer_channel_1);
+}
+
+HOT static InterruptHandlerStatus system_timer_channel_3_interrupt(void)
+{
+	return system_timer_channel_interrupt(system_timer_channel_3);
+}
+
+COLD Error_Returns system_timer_init(void)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!system_timer_initialized)
+	{
+		do
+		{
+			to_return = interrupt_handler_init();
+			if (to_return != RPi_Success)
+			{
+				log_string_plus("system_timer_init: interrupt_handler_init failed: ", to_return);
+				break;
+			}
+			for (uint32_t channel = 0; channel < SYSTEM_TIMER_CHANNELS; channel++)
+			{
+				channel_info[channel].handler_ptr = NULL_PTR;
+				channel_info[channel].interrupt_handler_index = -1;
+			}
+			REG_WRITE(system_timer_registers->control_status, (1 << system_timer_channel_1) | (1 << system_timer_channel_3));
+
+			//One shots are short and want to be on time so run them at the top priority
+			channel_info[system_timer_channel_1].interrupt_handler_index =
+				interrupt_handler_add(system_timer_channel_1_interrupt, Int_System_Timer_1, gpio_pin_0);
+			channel_info[system_timer_channel_3].interrupt_handler_index =
+				interrupt_handler_add(system_timer_channel_3_interrupt, Int_System_Timer_3, gpio_pin_0);
+			if ((channel_info[system_timer_channel_1].interrupt_handler_index < 0) ||
+				(channel_info[system_timer_channel_3].interrupt_handler_index < 0))
+			{
+				log_string("system_timer_init: failed to add interrupt handlers");
+				to_return = RPi_OperationFailed;
+				break;
+			}
+			interrupt_handler_set_priority(channel_info[system_timer_channel_1].interrupt_handler_index, Int_Priority_High);
+			interrupt_handler_set_priority(channel_info[system_timer_channel_3].interrupt_handler_index, Int_Priority_High);
+			system_timer_initialized = 1;
+		} while(0);
+	}
+	return to_return;
+}
+
+/*  Microseconds since the GPU started the counter.  This needs no set up so it
+	can be used before system_timer_init.
+*/
+
+HOT uint64_t timer_now_us(void)
+{
+	uint32_t high = REG_READ(system_timer_registers->counter_high);
+	uint32_t low = REG_READ(system_timer_registers->counter_low);
+	uint32_t check_high = REG_READ(system_timer_registers->counter_high);
+	if (check_high != high)
+	{
+		//The low half wrapped between the reads, read it again under the new high half
+		high = check_high;
+		low = REG_READ(system_timer_registers->counter_low);
+	}
+	return ((uint64_t)high << 32) | low;
+}
+
+/*  A deadline is just a point on the timer_now_us() time line, polling it with
+	timer_deadline_reached() lets a caller get on with something else while it
+	waits instead of blocking in a delay.
+*/
+
+HOT uint64_t timer_deadline_us(uint32_t microseconds)
+{
+	return timer_now_us() + microseconds;
+}
+
+HOT uint32_t timer_deadline_reached(uint64_t deadline_us)
+{
+	return timer_now_us() >= deadline_us;
+}
+
+/*  Call the handler (from interrupt context) once timer_now_us() reaches the
+	deadline.  Setting a channel that is already running replaces it.  If the
+	deadline has already gone by by the time the compare is set RPi_Timeout is
+	returned and the handler won't be called.
+*/
+
+Error_Returns system_timer_set_one_shot(SystemTimerChannel channel, uint64_t deadline_us,
+		void (*handler_ptr)(uint32_t argument), uint32_t argument)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (!system_timer_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if (((channel != system_timer_channel_1) && (channel != system_timer_channel_3)) ||
+			(handler_ptr == NULL_PTR))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		uint64_t now = timer_now_us();
+		if ((deadline_us > now) && ((deadline_us - now) > SYSTEM_TIMER_MAX_ONE_SHOT))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+
+		uint32_t saved_cpsr = enter_critical_section();
+		channel_info[channel].handler_ptr = handler_ptr;
+		channel_info[channel].argument = argument;
+		REG_WRITE(system_timer_registers->control_status, (1 << channel));
+		REG_WRITE(system_timer_registers->compare[channel], (uint32_t)deadline_us);
+		//The compare only matches on equal so check it wasn't passed while setting it up
+		if ((timer_now_us() >= deadline_us) && !(REG_READ(system_timer_registers->control_status) & (1 << channel)))
+		{
+			channel_info[channel].handler_ptr = NULL_PTR;
+			to_return = RPi_Timeout;
+		}
+		exit_critical_section(saved_cpsr);
+	} while(0);
+	return to_return;
+}
+
+Error_Returns system_timer_cancel(SystemTimerChannel channel)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((channel == system_timer_channel_1) || (channel == system_timer_channel_3))
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		channel_info[channel].handler_ptr = NULL_PTR;
+		REG_WRITE(system_timer_registers->control_status, (1 << channel));
+		exit_critical_section(saved_cpsr);
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
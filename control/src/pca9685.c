@@ -90,7 +90,7 @@ static Error_Returns pca9685_write(uint32_t id, unsigned char *buffer, unsigned
 
 //TODO:  Pass parameters for invert/no invert and output driver.
 
-Error_Returns pca9685_init(uint32_t i2c_id, PCA9685_Clock_Source clk_src,
+COLD Error_Returns pca9685_init(uint32_t i2c_id, PCA9685_Clock_Source clk_src,
 		uint32_t input_clk_frequency, uint32_t output_frequency, uint32_t *pca9685_idx)
 {
 	Error_Returns to_return = RPi_Success;
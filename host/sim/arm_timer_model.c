@@ -0,0 +1,201 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  arm_timer_model.c
+
+Behavioural model of the ARM timer (the SP804 derivative at 0xB400).  The
+counter is clocked from the 250MHz core clock through the predivider and
+counts down whenever it is enabled.  On reaching zero it sets the raw
+interrupt and starts again from the reload value.  Only the 32 bit mode
+is modelled.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_sim.h"
+
+#define CORE_CLOCKS_PER_MICROSECOND 250
+
+//Offsets of the ARM timer registers
+#define ARM_TIMER_LOAD			0x00
+#define ARM_TIMER_VALUE			0x04
+#define ARM_TIMER_CONTROL		0x08
+#define ARM_TIMER_IRQ_CLEAR		0x0C
+#define ARM_TIMER_RAW_IRQ		0x10
+#define ARM_TIMER_MASKED_IRQ	0x14
+#define ARM_TIMER_RELOAD		0x18
+#define ARM_TIMER_PREDIVIDER	0x1C
+#define ARM_TIMER_FREE_RUNNING	0x20
+#define ARM_TIMER_REGISTERS_SIZE 0x24
+
+#define ARM_TIMER_ENABLE			(1 << 7)
+#define ARM_TIMER_INTERRUPT_ENABLE	(1 << 5)
+#define ARM_TIMER_FREE_RUNNING_ENABLE (1 << 9)
+#define ARM_TIMER_FREE_RUNNING_SHIFT 16
+#define ARM_TIMER_IRQ_CLEAR_READ	0x544D5241  //"ARMT", what the ack register reads as
+
+typedef struct {
+	uint32_t load;
+	uint32_t value;
+	uint32_t control;
+	uint32_t raw_irq;
+	uint32_t reload;
+	uint32_t predivider;
+	uint32_t free_running_counter;
+	uint64_t core_clocks;  //Left over from the last step, less than one timer clock
+	uint64_t free_running_clocks;
+} ARM_Timer_Model_State;
+
+static ARM_Timer_Model_State timer;
+
+static void arm_timer_update_irq(void)
+{
+	reg_sim_set_irq(REG_SIM_ARM_TIMER_IRQ, timer.raw_irq && (timer.control & ARM_TIMER_INTERRUPT_ENABLE));
+}
+
+static uint32_t arm_timer_read(uint32_t offset)
+{
+	uint32_t to_return = 0;
+	switch (offset)
+	{
+		case ARM_TIMER_LOAD:
+			to_return = timer.load;
+			break;
+		case ARM_TIMER_VALUE:
+			to_return = timer.value;
+			break;
+		case ARM_TIMER_CONTROL:
+			to_return = timer.control;
+			break;
+		case ARM_TIMER_IRQ_CLEAR:
+			to_return = ARM_TIMER_IRQ_CLEAR_READ;
+			break;
+		case ARM_TIMER_RAW_IRQ:
+			to_return = timer.raw_irq;
+			break;
+		case ARM_TIMER_MASKED_IRQ:
+			to_return = (timer.control & ARM_TIMER_INTERRUPT_ENABLE) ? timer.raw_irq : 0;
+			break;
+		case ARM_TIMER_RELOAD:
+			to_return = timer.reload;
+			break;
+		case ARM_TIMER_PREDIVIDER:
+			to_return = timer.predivider;
+			break;
+		case ARM_TIMER_FREE_RUNNING:
+			to_return = timer.free_running_counter;
+			break;
+		default:
+			break;
+	}
+	return to_return;
+}
+
+//Load and reload are the same register underneath, only a write to load restarts the count
+static void arm_timer_write(uint32_t offset, uint32_t value)
+{
+	switch (offset)
+	{
+		case ARM_TIMER_LOAD:
+			timer.load = value;
+			timer.reload = value;
+			timer.value = value;
+			timer.core_clocks = 0;
+			break;
+		case ARM_TIMER_CONTROL:
+			timer.control = value;
+			break;
+		case ARM_TIMER_IRQ_CLEAR:
+			timer.raw_irq = 0;
+			break;
+		case ARM_TIMER_RELOAD:
+			timer.load = value;
+			timer.reload = value;
+			break;
+		case ARM_TIMER_PREDIVIDER:
+			timer.predivider = value & 0x3FF;
+			break;
+		default:
+			break;
+	}
+	arm_timer_update_irq();
+}
+
+static void arm_timer_advance(uint64_t now_us, uint32_t microseconds)
+{
+	if (timer.control & ARM_TIMER_FREE_RUNNING_ENABLE)
+	{
+		uint32_t divider = ((timer.control >> ARM_TIMER_FREE_RUNNING_SHIFT) & 0xFF) + 1;
+		timer.free_running_clocks += (uint64_t)microseconds * CORE_CLOCKS_PER_MICROSECOND;
+		timer.free_running_counter += (uint32_t)(timer.free_running_clocks / divider);
+		timer.free_running_clocks %= divider;
+	}
+	if (timer.control & ARM_TIMER_ENABLE)
+	{
+		uint32_t divider = timer.predivider + 1;
+		timer.core_clocks += (uint64_t)microseconds * CORE_CLOCKS_PER_MICROSECOND;
+		uint64_t ticks = timer.core_clocks / divider;
+		timer.core_clocks %= divider;
+		if (ticks >= timer.value)
+		{
+			ticks -= timer.value;
+			timer.raw_irq = 1;
+			timer.value = timer.reload;
+			if (timer.reload != 0)
+			{
+				timer.value -= (uint32_t)(ticks % timer.reload);
+			}
+		}
+		else
+		{
+			timer.value -= (uint32_t)ticks;
+		}
+		arm_timer_update_irq();
+	}
+}
+
+static uint64_t arm_timer_next_event(uint64_t now_us)
+{
+	uint64_t to_return = 0;
+	if ((timer.control & ARM_TIMER_ENABLE) && (timer.control & ARM_TIMER_INTERRUPT_ENABLE) && !timer.raw_irq)
+	{
+		uint64_t core_clocks = ((uint64_t)timer.value * (timer.predivider + 1)) - timer.core_clocks;
+		uint64_t microseconds = (core_clocks + CORE_CLOCKS_PER_MICROSECOND - 1) / CORE_CLOCKS_PER_MICROSECOND;
+		to_return = now_us + ((microseconds != 0) ? microseconds : 1);
+	}
+	return to_return;
+}
+
+static Reg_Sim_Model arm_timer_model = {
+	.name = "ARM timer",
+	.base = ARM_TIMER_BASE,
+	.size = ARM_TIMER_REGISTERS_SIZE,
+	.read_ptr = arm_timer_read,
+	.write_ptr = arm_timer_write,
+	.advance_ptr = arm_timer_advance,
+	.next_event_ptr = arm_timer_next_event,
+};
+
+void arm_timer_model_install(void)
+{
+	timer.control = 0x003E0020;  //Reset value, 16 bit, interrupt enabled but stopped
+	timer.predivider = 0x7D;
+	reg_sim_add_model(&arm_timer_model);
+}
@@ -0,0 +1,162 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  aux_model.c
+
+Behavioural model of the mini UART in the auxiliary peripherals, enough for
+the log to come out on stdout and for a test to type commands at the driver.
+The transmitter is always idle, characters go straight out.  Received
+characters queue up, setting data ready and the AUX interrupt if the receive
+interrupt is enabled.  The two auxiliary SPI masters are plain memory.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_sim.h"
+
+#define AUX_RX_QUEUE_SIZE 64
+#define AUX_IRQ 29
+
+//Word offsets of the mini UART registers
+#define AUX_IRQ_STATUS	0
+#define AUX_ENABLES		1
+#define AUX_MU_IO		16
+#define AUX_MU_IER		17
+#define AUX_MU_IIR		18
+#define AUX_MU_LSR		21
+#define AUX_MU_STAT		25
+#define AUX_MU_WORDS	27
+
+#define AUX_MINI_UART_ENABLE	0x01
+#define IER_RX_INTERRUPT		0x02
+#define IIR_NO_INTERRUPT		0xC1  //FIFOs enabled, nothing pending
+#define IIR_RX_INTERRUPT		0xC4
+#define IIR_CLEAR_RX			0x02
+#define LSR_DATA_READY			0x01
+#define LSR_TX_EMPTY			0x20
+#define LSR_TX_IDLE				0x40
+
+typedef struct {
+	uint32_t registers[AUX_MU_WORDS];  //What was last written, for the plain ones
+	char rx_queue[AUX_RX_QUEUE_SIZE];
+	uint32_t rx_read;
+	uint32_t rx_write;
+} AUX_Model_State;
+
+static AUX_Model_State aux;
+
+static uint32_t aux_rx_pending(void)
+{
+	return aux.rx_write != aux.rx_read;
+}
+
+static uint32_t aux_interrupt_active(void)
+{
+	return (aux.registers[AUX_ENABLES] & AUX_MINI_UART_ENABLE) &&
+		(aux.registers[AUX_MU_IER] & IER_RX_INTERRUPT) && aux_rx_pending();
+}
+
+static void aux_update_irq(void)
+{
+	reg_sim_set_irq(AUX_IRQ, aux_interrupt_active());
+}
+
+static uint32_t aux_read(uint32_t offset)
+{
+	uint32_t word = offset / sizeof(uint32_t);
+	uint32_t to_return = 0;
+	switch (word)
+	{
+		case AUX_IRQ_STATUS:
+			to_return = aux_interrupt_active() ? AUX_MINI_UART_ENABLE : 0;
+			break;
+		case AUX_MU_IO:
+			if (aux_rx_pending())
+			{
+				to_return = (unsigned char)aux.rx_queue[aux.rx_read++ % AUX_RX_QUEUE_SIZE];
+				aux_update_irq();
+			}
+			break;
+		case AUX_MU_IIR:
+			to_return = aux_interrupt_active() ? IIR_RX_INTERRUPT : IIR_NO_INTERRUPT;
+			break;
+		case AUX_MU_LSR:
+			to_return = LSR_TX_EMPTY | LSR_TX_IDLE | (aux_rx_pending() ? LSR_DATA_READY : 0);
+			break;
+		case AUX_MU_STAT:
+			to_return = ((aux.rx_write - aux.rx_read) << 16) | (aux_rx_pending() ? 0x01 : 0) | 0x30C;
+			break;
+		default:
+			to_return = aux.registers[word];
+			break;
+	}
+	return to_return;
+}
+
+//The log ends lines with CR LF, only the LF is passed on so host output reads normally
+static void aux_write(uint32_t offset, uint32_t value)
+{
+	uint32_t word = offset / sizeof(uint32_t);
+	switch (word)
+	{
+		case AUX_MU_IO:
+			if ((value & 0xFF) != '\r')
+			{
+				putchar(value & 0xFF);
+			}
+			break;
+		case AUX_MU_IIR:
+			if (value & IIR_CLEAR_RX)
+			{
+				aux.rx_read = aux.rx_write;
+			}
+			break;
+		case AUX_IRQ_STATUS:
+		case AUX_MU_LSR:
+		case AUX_MU_STAT:
+			break;  //Read only
+		default:
+			aux.registers[word] = value;
+			break;
+	}
+	aux_update_irq();
+}
+
+static Reg_Sim_Model aux_model = {
+	.name = "AUX mini UART",
+	.base = AUX_BASE,
+	.size = AUX_MU_WORDS * sizeof(uint32_t),
+	.read_ptr = aux_read,
+	.write_ptr = aux_write,
+};
+
+void aux_model_install(void)
+{
+	reg_sim_add_model(&aux_model);
+}
+
+void aux_model_receive(char c)
+{
+	if ((aux.rx_write - aux.rx_read) < AUX_RX_QUEUE_SIZE)
+	{
+		aux.rx_queue[aux.rx_write++ % AUX_RX_QUEUE_SIZE] = c;
+	}
+	aux_update_irq();
+}
@@ -0,0 +1,355 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bsc_model.c
+
+Behavioural model of BSC1, the I2C master the sensors are on.  Transfers take
+no simulated time, the FIFO moves bytes to or from the addressed device as
+soon as there is room or data.  The status bits are worked out from the state
+of the transfer so the driver sees the same sequences it does on the target.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_sim.h"
+
+#define BSC_MODEL_DEVICES 8
+#define BSC_FIFO_SIZE 16
+
+//Offsets of the BSC registers
+#define BSC_CONTROL			0x00
+#define BSC_STATUS			0x04
+#define BSC_DATA_LENGTH		0x08
+#define BSC_SLAVE_ADDRESS	0x0C
+#define BSC_DATA_FIFO		0x10
+#define BSC_CLOCK_DIVIDER	0x14
+#define BSC_DATA_DELAY		0x18
+#define BSC_CLOCK_STRETCH	0x1C
+#define BSC_REGISTERS_SIZE	0x20
+
+#define BSC_CONTROL_I2CEN		(1 << 15)
+#define BSC_CONTROL_ST			(1 << 7)
+#define BSC_CONTROL_CLEAR		((1 << 5) | (1 << 4))
+#define BSC_CONTROL_READ		(1 << 0)
+#define BSC_CONTROL_STORED		(~(BSC_CONTROL_ST | BSC_CONTROL_CLEAR))  //ST and CLEAR read back as 0
+
+#define BSC_STATUS_CLKT			(1 << 9)
+#define BSC_STATUS_ERR			(1 << 8)
+#define BSC_STATUS_RXF			(1 << 7)
+#define BSC_STATUS_TXE			(1 << 6)
+#define BSC_STATUS_RXD			(1 << 5)
+#define BSC_STATUS_TXD			(1 << 4)
+#define BSC_STATUS_RXR			(1 << 3)
+#define BSC_STATUS_TXW			(1 << 2)
+#define BSC_STATUS_DONE			(1 << 1)
+#define BSC_STATUS_TA			(1 << 0)
+#define BSC_STATUS_CLEARABLE	(BSC_STATUS_CLKT | BSC_STATUS_ERR | BSC_STATUS_DONE)
+
+#define BSC_FIFO_THREE_QUARTERS	12
+#define BSC_FIFO_QUARTER		4
+
+typedef struct {
+	uint32_t slave_address;
+	unsigned char *register_map;
+	uint32_t size;
+	uint32_t register_pointer;
+} BSC_Model_Device;
+
+typedef struct {
+	uint32_t control;
+	uint32_t status;  //Only the sticky CLKT, ERR and DONE bits
+	uint32_t data_length;
+	uint32_t slave_address;
+	uint32_t clock_divider;
+	uint32_t data_delay;
+	uint32_t clock_stretch;
+	unsigned char fifo[BSC_FIFO_SIZE];
+	uint32_t fifo_read;  //Free running indices
+	uint32_t fifo_write;
+	uint32_t active;
+	uint32_t reading;
+	uint32_t transferred;  //Bytes moved over the bus so far this transfer
+	BSC_Model_Device *device;
+} BSC_Model_State;
+
+static BSC_Model_Device devices[BSC_MODEL_DEVICES];
+static BSC_Model_State bsc;
+
+static uint32_t bsc_fifo_count(void)
+{
+	return bsc.fifo_write - bsc.fifo_read;
+}
+
+//The first byte of a write sets the register pointer, as on most sensors
+static void bsc_device_write(BSC_Model_Device *device, unsigned char value)
+{
+	if (bsc.transferred == 0)
+	{
+		device->register_pointer = value % device->size;
+	}
+	else
+	{
+		device->register_map[device->register_pointer] = value;
+		device->register_pointer = (device->register_pointer + 1) % device->size;
+	}
+}
+
+static unsigned char bsc_device_read(BSC_Model_Device *device)
+{
+	unsigned char to_return = device->register_map[device->register_pointer];
+	device->register_pointer = (device->register_pointer + 1) % device->size;
+	return to_return;
+}
+
+static void bsc_finish(uint32_t status)
+{
+	bsc.active = 0;
+	bsc.status |= status | BSC_STATUS_DONE;
+}
+
+//Read data goes into the FIFO as long as there is room for it
+static void bsc_fill_fifo(void)
+{
+	while (bsc.active && bsc.reading && (bsc_fifo_count() < BSC_FIFO_SIZE))
+	{
+		if (bsc.transferred == bsc.data_length)
+		{
+			bsc_finish(0);
+			break;
+		}
+		bsc.fifo[bsc.fifo_write++ % BSC_FIFO_SIZE] = bsc_device_read(bsc.device);
+		bsc.transferred++;
+	}
+	if (bsc.active && bsc.reading && (bsc.transferred == bsc.data_length))
+	{
+		bsc_finish(0);
+	}
+}
+
+static void bsc_start(void)
+{
+	bsc.device = NULL_PTR;
+	for (uint32_t index = 0; index < BSC_MODEL_DEVICES; index++)
+	{
+		if ((devices[index].register_map != NULL_PTR) && (devices[index].slave_address == bsc.slave_address))
+		{
+			bsc.device = &devices[index];
+		}
+	}
+	bsc.active = 1;
+	bsc.reading = bsc.control & BSC_CONTROL_READ;
+	bsc.transferred = 0;
+	if (bsc.device == NULL_PTR)
+	{
+		bsc_finish(BSC_STATUS_ERR);  //Nobody acked the address
+	}
+	else if (bsc.data_length == 0)
+	{
+		bsc_finish(0);
+	}
+	else
+	{
+		bsc_fill_fifo();
+	}
+}
+
+static uint32_t bsc_status(void)
+{
+	uint32_t count = bsc_fifo_count();
+	uint32_t to_return = bsc.status;
+	if (bsc.active)
+	{
+		to_return |= BSC_STATUS_TA;
+	}
+	if (count == 0)
+	{
+		to_return |= BSC_STATUS_TXE;
+	}
+	if (count == BSC_FIFO_SIZE)
+	{
+		to_return |= BSC_STATUS_RXF;
+	}
+	if (count != 0)
+	{
+		to_return |= BSC_STATUS_RXD;
+	}
+	if (count < BSC_FIFO_SIZE)
+	{
+		to_return |= BSC_STATUS_TXD;
+	}
+	if (bsc.active && bsc.reading && (count >= BSC_FIFO_THREE_QUARTERS))
+	{
+		to_return |= BSC_STATUS_RXR;
+	}
+	if (bsc.active && !bsc.reading && (count < BSC_FIFO_QUARTER))
+	{
+		to_return |= BSC_STATUS_TXW;
+	}
+	return to_return;
+}
+
+static uint32_t bsc_read(uint32_t offset)
+{
+	uint32_t to_return = 0;
+	switch (offset)
+	{
+		case BSC_CONTROL:
+			to_return = bsc.control;
+			break;
+		case BSC_STATUS:
+			to_return = bsc_status();
+			break;
+		case BSC_DATA_LENGTH:
+			//Counts down while a transfer is running
+			to_return = bsc.active ? (bsc.data_length - bsc.transferred) : bsc.data_length;
+			break;
+		case BSC_SLAVE_ADDRESS:
+			to_return = bsc.slave_address;
+			break;
+		case BSC_DATA_FIFO:
+			if (bsc_fifo_count() != 0)
+			{
+				to_return = bsc.fifo[bsc.fifo_read++ % BSC_FIFO_SIZE];
+				bsc_fill_fifo();
+			}
+			break;
+		case BSC_CLOCK_DIVIDER:
+			to_return = bsc.clock_divider;
+			break;
+		case BSC_DATA_DELAY:
+			to_return = bsc.data_delay;
+			break;
+		case BSC_CLOCK_STRETCH:
+			to_return = bsc.clock_stretch;
+			break;
+		default:
+			break;
+	}
+	return to_return;
+}
+
+static void bsc_write(uint32_t offset, uint32_t value)
+{
+	switch (offset)
+	{
+		case BSC_CONTROL:
+			bsc.control = value & BSC_CONTROL_STORED;
+			if (value & BSC_CONTROL_CLEAR)
+			{
+				bsc.fifo_read = bsc.fifo_write;
+			}
+			if (!(value & BSC_CONTROL_I2CEN))
+			{
+				bsc.active = 0;
+			}
+			else if (value & BSC_CONTROL_ST)
+			{
+				bsc_start();
+			}
+			break;
+		case BSC_STATUS:
+			bsc.status &= ~(value & BSC_STATUS_CLEARABLE);
+			break;
+		case BSC_DATA_LENGTH:
+			bsc.data_length = value & 0xFFFF;
+			break;
+		case BSC_SLAVE_ADDRESS:
+			bsc.slave_address = value & 0x7F;
+			break;
+		case BSC_DATA_FIFO:
+			if (bsc.active && !bsc.reading)
+			{
+				bsc_device_write(bsc.device, value);
+				if (++bsc.transferred == bsc.data_length)
+				{
+					bsc_finish(0);
+				}
+			}
+			else if (!bsc.active && (bsc_fifo_count() < BSC_FIFO_SIZE))
+			{
+				bsc.fifo[bsc.fifo_write++ % BSC_FIFO_SIZE] = value;  //Preloaded, not sent
+			}
+			break;
+		case BSC_CLOCK_DIVIDER:
+			bsc.clock_divider = value & 0xFFFF;
+			break;
+		case BSC_DATA_DELAY:
+			bsc.data_delay = value;
+			break;
+		case BSC_CLOCK_STRETCH:
+			bsc.clock_stretch = value & 0xFFFF;
+			break;
+		default:
+			break;
+	}
+}
+
+static Reg_Sim_Model bsc_model = {
+	.name = "BSC1",
+	.base = BSC1_BASE,
+	.size = BSC_REGISTERS_SIZE,
+	.read_ptr = bsc_read,
+	.write_ptr = bsc_write,
+};
+
+void bsc_model_install(void)
+{
+	bsc.clock_divider = 0x5DC;  //Reset values
+	bsc.data_delay = 0x00300030;
+	bsc.clock_stretch = 0x40;
+	reg_sim_add_model(&bsc_model);
+}
+
+Error_Returns bsc_model_attach(uint32_t slave_address, unsigned char *register_map, uint32_t size)
+{
+	Error_Returns to_return = RPi_InsufficientResources;
+	if ((register_map == NULL_PTR) || (size == 0))
+	{
+		to_return = RPi_InvalidParam;
+	}
+	else
+	{
+		bsc_model_detach(slave_address);
+		for (uint32_t index = 0; index < BSC_MODEL_DEVICES; index++)
+		{
+			if (devices[index].register_map == NULL_PTR)
+			{
+				devices[index].slave_address = slave_address;
+				devices[index].register_map = register_map;
+				devices[index].size = size;
+				devices[index].register_pointer = 0;
+				to_return = RPi_Success;
+				break;
+			}
+		}
+	}
+	return to_return;
+}
+
+void bsc_model_detach(uint32_t slave_address)
+{
+	for (uint32_t index = 0; index < BSC_MODEL_DEVICES; index++)
+	{
+		if ((devices[index].register_map != NULL_PTR) && (devices[index].slave_address == slave_address))
+		{
+			devices[index].register_map = NULL_PTR;
+		}
+	}
+}
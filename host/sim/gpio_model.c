@@ -0,0 +1,281 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  gpio_model.c
+
+Behavioural model of the GPIO block.  A pin's level is its output latch when
+it is an output and whatever the test drives (or its pull) otherwise, GPLEV
+reads the levels back.  Edges and levels are detected on every change the way
+the enables ask, they set the event status and raise the bank interrupts.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_sim.h"
+
+#define GPIO_PIN_COUNT 54
+#define GPIO_BANKS 2
+#define PINS_PER_BANK 32
+#define FUNCTION_SELECT_REGISTERS 6
+#define FUNCTION_SELECT_PINS_PER_REGISTER 10
+#define BITS_PER_FUNCTION_SELECT 3
+#define FUNCTION_OUTPUT 1
+#define PULL_UP 2
+#define HIGH_BANK_MASK 0x003FFFFF  //Pins 32-53
+
+//Word offsets of the GPIO registers, each bank register is followed by the next bank's
+#define GPFSEL		0
+#define GPSET		7
+#define GPCLR		10
+#define GPLEV		13
+#define GPEDS		16
+#define GPREN		19
+#define GPFEN		22
+#define GPHEN		25
+#define GPLEN		28
+#define GPAREN		31
+#define GPAFEN		34
+#define GPPUD		37
+#define GPPUDCLK	38
+#define GPIO_REGISTERS_SIZE (40 * sizeof(uint32_t))
+
+//GPU IRQs the bank events come in on, as interrupt_handler.c expects
+#define GPIO_IRQ_BANK_0 49
+#define GPIO_IRQ_BANK_1 50
+#define GPIO_IRQ_ALL 52
+
+typedef struct {
+	uint32_t function_select[FUNCTION_SELECT_REGISTERS];
+	uint32_t output_latch[GPIO_BANKS];
+	uint32_t driven[GPIO_BANKS];  //Input levels set by the test
+	uint32_t input_level[GPIO_BANKS];
+	uint32_t level[GPIO_BANKS];  //As last seen by the detectors
+	uint32_t event_status[GPIO_BANKS];
+	uint32_t rising_enable[GPIO_BANKS];
+	uint32_t falling_enable[GPIO_BANKS];
+	uint32_t high_enable[GPIO_BANKS];
+	uint32_t low_enable[GPIO_BANKS];
+	uint32_t async_rising_enable[GPIO_BANKS];
+	uint32_t async_falling_enable[GPIO_BANKS];
+	uint32_t pull_control;
+	unsigned char pull[GPIO_PIN_COUNT];
+} GPIO_Model_State;
+
+static GPIO_Model_State gpio;
+
+static uint32_t gpio_function(uint32_t pin)
+{
+	return (gpio.function_select[pin / FUNCTION_SELECT_PINS_PER_REGISTER] >>
+		((pin % FUNCTION_SELECT_PINS_PER_REGISTER) * BITS_PER_FUNCTION_SELECT)) & 0x07;
+}
+
+static uint32_t gpio_output_mask(uint32_t bank)
+{
+	uint32_t to_return = 0;
+	for (uint32_t bit = 0; bit < PINS_PER_BANK; bit++)
+	{
+		uint32_t pin = (bank * PINS_PER_BANK) + bit;
+		if (pin >= GPIO_PIN_COUNT)
+		{
+			break;
+		}
+		if (gpio_function(pin) == FUNCTION_OUTPUT)
+		{
+			to_return |= 1 << bit;
+		}
+	}
+	return to_return;
+}
+
+static uint32_t gpio_current_level(uint32_t bank)
+{
+	uint32_t outputs = gpio_output_mask(bank);
+	return (gpio.output_latch[bank] & outputs) | (gpio.input_level[bank] & ~outputs);
+}
+
+//Run the detectors over whatever changed and raise the interrupts for any events
+static void gpio_update(void)
+{
+	for (uint32_t bank = 0; bank < GPIO_BANKS; bank++)
+	{
+		uint32_t level = gpio_current_level(bank);
+		uint32_t rising = level & ~gpio.level[bank];
+		uint32_t falling = ~level & gpio.level[bank];
+		gpio.event_status[bank] |= rising & (gpio.rising_enable[bank] | gpio.async_rising_enable[bank]);
+		gpio.event_status[bank] |= falling & (gpio.falling_enable[bank] | gpio.async_falling_enable[bank]);
+		gpio.event_status[bank] |= level & gpio.high_enable[bank];
+		gpio.event_status[bank] |= ~level & gpio.low_enable[bank];
+		if (bank == 1)
+		{
+			gpio.event_status[bank] &= HIGH_BANK_MASK;
+		}
+		gpio.level[bank] = level;
+	}
+	reg_sim_set_irq(GPIO_IRQ_BANK_0, gpio.event_status[0] != 0);
+	reg_sim_set_irq(GPIO_IRQ_BANK_1, gpio.event_status[1] != 0);
+	reg_sim_set_irq(GPIO_IRQ_ALL, (gpio.event_status[0] | gpio.event_status[1]) != 0);
+}
+
+static uint32_t *gpio_bank_register(uint32_t word)
+{
+	uint32_t *to_return = NULL_PTR;
+	if ((word >= GPREN) && (word < GPPUD) && (((word - GPREN) % 3) < GPIO_BANKS))
+	{
+		uint32_t *bank_registers[] = {gpio.rising_enable, gpio.falling_enable, gpio.high_enable,
+			gpio.low_enable, gpio.async_rising_enable, gpio.async_falling_enable};
+		to_return = &bank_registers[(word - GPREN) / 3][(word - GPREN) % 3];
+	}
+	return to_return;
+}
+
+static uint32_t gpio_read(uint32_t offset)
+{
+	uint32_t word = offset / sizeof(uint32_t);
+	uint32_t to_return = 0;
+	uint32_t *bank_register = gpio_bank_register(word);
+	if (word < FUNCTION_SELECT_REGISTERS)
+	{
+		to_return = gpio.function_select[word];
+	}
+	else if ((word == GPLEV) || (word == GPLEV + 1))
+	{
+		to_return = gpio_current_level(word - GPLEV);
+	}
+	else if ((word == GPEDS) || (word == GPEDS + 1))
+	{
+		to_return = gpio.event_status[word - GPEDS];
+	}
+	else if (bank_register != NULL_PTR)
+	{
+		to_return = *bank_register;
+	}
+	else if (word == GPPUD)
+	{
+		to_return = gpio.pull_control;
+	}
+	return to_return;  //GPSET, GPCLR and GPPUDCLK are write only
+}
+
+static void gpio_write(uint32_t offset, uint32_t value)
+{
+	uint32_t word = offset / sizeof(uint32_t);
+	uint32_t *bank_register = gpio_bank_register(word);
+	if (word < FUNCTION_SELECT_REGISTERS)
+	{
+		gpio.function_select[word] = value;
+	}
+	else if ((word == GPSET) || (word == GPSET + 1))
+	{
+		gpio.output_latch[word - GPSET] |= value;
+	}
+	else if ((word == GPCLR) || (word == GPCLR + 1))
+	{
+		gpio.output_latch[word - GPCLR] &= ~value;
+	}
+	else if ((word == GPEDS) || (word == GPEDS + 1))
+	{
+		gpio.event_status[word - GPEDS] &= ~value;
+	}
+	else if (bank_register != NULL_PTR)
+	{
+		*bank_register = value;
+	}
+	else if (word == GPPUD)
+	{
+		gpio.pull_control = value & 0x03;
+	}
+	else if ((word == GPPUDCLK) || (word == GPPUDCLK + 1))
+	{
+		uint32_t bank = word - GPPUDCLK;
+		for (uint32_t bit = 0; bit < PINS_PER_BANK; bit++)
+		{
+			uint32_t pin = (bank * PINS_PER_BANK) + bit;
+			if ((pin < GPIO_PIN_COUNT) && (value & (1 << bit)))
+			{
+				gpio.pull[pin] = gpio.pull_control;
+				//An input nobody drives floats to its pull
+				if (!(gpio.driven[bank] & (1 << bit)))
+				{
+					if (gpio.pull_control == PULL_UP)
+					{
+						gpio.input_level[bank] |= 1 << bit;
+					}
+					else
+					{
+						gpio.input_level[bank] &= ~(1 << bit);
+					}
+				}
+			}
+		}
+	}
+	gpio_update();
+}
+
+static Reg_Sim_Model gpio_model = {
+	.name = "GPIO",
+	.base = GPIO_BASE,
+	.size = GPIO_REGISTERS_SIZE,
+	.read_ptr = gpio_read,
+	.write_ptr = gpio_write,
+};
+
+void gpio_model_install(void)
+{
+	reg_sim_add_model(&gpio_model);
+}
+
+void gpio_model_drive_pin(uint32_t pin, uint32_t level)
+{
+	if (pin < GPIO_PIN_COUNT)
+	{
+		uint32_t bank = pin / PINS_PER_BANK;
+		uint32_t bit = 1 << (pin % PINS_PER_BANK);
+		gpio.driven[bank] |= bit;
+		if (level)
+		{
+			gpio.input_level[bank] |= bit;
+		}
+		else
+		{
+			gpio.input_level[bank] &= ~bit;
+		}
+		gpio_update();
+	}
+}
+
+uint32_t gpio_model_get_level(uint32_t pin)
+{
+	uint32_t to_return = 0;
+	if (pin < GPIO_PIN_COUNT)
+	{
+		to_return = (gpio_current_level(pin / PINS_PER_BANK) >> (pin % PINS_PER_BANK)) & 0x01;
+	}
+	return to_return;
+}
+
+uint32_t gpio_model_get_function(uint32_t pin)
+{
+	return (pin < GPIO_PIN_COUNT) ? gpio_function(pin) : 0;
+}
+
+uint32_t gpio_model_get_pull(uint32_t pin)
+{
+	return (pin < GPIO_PIN_COUNT) ? gpio.pull[pin] : 0;
+}
@@ -0,0 +1,186 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  host_platform.c
+
+Host stand ins for the assembly language routines in init.s and mem_ops.s and
+for the symbols the linker script would provide.  The CPSR is reduced to its
+I bit, which the simulated interrupt controller honours, and the cycle counter
+runs off the host's monotonic clock at one count per nanosecond.
+
+*/
+
+#include <time.h>
+#include <string.h>
+#include "common.h"
+#include "interrupt_handler.h"
+#include "mem_ops.h"
+#include "reg_sim.h"
+
+#define HOST_ARENA_SIZE 0x100000
+#define HOST_SVC_STACK_SIZE 0x4000
+#define CPSR_SVC_MODE 0x13
+#define CPSR_IRQ_MASKED 0x80
+#define STRINGIFY(value) #value
+#define TO_STRING(value) STRINGIFY(value)
+
+unsigned char host_arena[HOST_ARENA_SIZE] __attribute__((aligned(32)));
+unsigned char host_svc_stack[HOST_SVC_STACK_SIZE] __attribute__((aligned(8)));
+
+__asm__(
+	".globl __arena_start__\n"
+	".set __arena_start__, host_arena\n"
+	".globl __arena_end__\n"
+	".set __arena_end__, host_arena + " TO_STRING(HOST_ARENA_SIZE) "\n"
+	".globl __svc_stack_top__\n"
+	".set __svc_stack_top__, host_svc_stack + " TO_STRING(HOST_SVC_STACK_SIZE) "\n");
+
+static uint32_t pmu_control = 0;
+
+void dummy()
+{
+}
+
+void enable_cpu_interrupts(void)
+{
+	reg_sim_mask_cpu_interrupts(0);
+}
+
+void disable_cpu_interrupts(void)
+{
+	reg_sim_mask_cpu_interrupts(1);
+}
+
+uint32_t get_cpsr(void)
+{
+	return CPSR_SVC_MODE | (reg_sim_cpu_interrupts_masked() ? CPSR_IRQ_MASKED : 0);
+}
+
+uint32_t enter_critical_section(void)
+{
+	uint32_t to_return = get_cpsr();
+	reg_sim_mask_cpu_interrupts(1);
+	return to_return;
+}
+
+void exit_critical_section(uint32_t saved_cpsr)
+{
+	reg_sim_mask_cpu_interrupts(saved_cpsr & CPSR_IRQ_MASKED);
+}
+
+void enable_cycle_counter(void)
+{
+}
+
+uint32_t read_cycle_counter(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec);
+}
+
+uint32_t read_pmu_control(void)
+{
+	return pmu_control;
+}
+
+void write_pmu_control(uint32_t control)
+{
+	pmu_control = control;
+}
+
+//There is no portable way to count cache misses or branches so the events never happen
+uint32_t read_event_counter_0(void)
+{
+	return 0;
+}
+
+uint32_t read_event_counter_1(void)
+{
+	return 0;
+}
+
+/*  Sleeping is where simulated time passes.  WFI wakes on a pending interrupt
+	even when it is masked, so rather than wait for one this runs time on to
+	the next model event and lets the caller look again.
+*/
+
+void wait_for_interrupt(void)
+{
+	reg_sim_idle();
+}
+
+//There is no data cache to keep coherent with a DMA engine that isn't there
+void clean_dcache_range(const void *start, uint32_t length)
+{
+}
+
+void invalidate_dcache_range(void *start, uint32_t length)
+{
+}
+
+void clean_invalidate_dcache_range(void *start, uint32_t length)
+{
+}
+
+void data_sync_barrier(void)
+{
+	__sync_synchronize();
+}
+
+void data_memory_barrier(void)
+{
+	__sync_synchronize();
+}
+
+//MMU and caches off, as without MMU_ENABLE
+uint32_t get_system_control(void)
+{
+	return 0;
+}
+
+/*  The simulator delivers one interrupt at a time so a handler is simply run
+	with interrupts left masked, priorities still mask sources in the
+	controller but nothing preempts.
+*/
+
+InterruptHandlerStatus nested_interrupt_call(InterruptHandlerStatus (*handler_ptr)(void))
+{
+	return handler_ptr();
+}
+
+void irq_benchmark_lean(void)
+{
+}
+
+void irq_benchmark_full(void)
+{
+}
+
+uint32_t irq_round_trip_cycles(void (*stub)(void))
+{
+	uint32_t start_cycles = read_cycle_counter();
+	stub();
+	return read_cycle_counter() - start_cycles;
+}
+
+void memclr(void *dst, size_t length)
+{
+	memset(dst, 0, length);
+}
@@ -0,0 +1,379 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  reg_sim.c
+
+The simulated register file, simulated time and the interrupt controller for
+the host build.  The rest of the peripherals are modelled in their own files
+and installed by reg_sim_init.
+
+*/
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <stdlib.h>
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_access.h"
+#include "reg_sim.h"
+#include "log.h"
+
+#define REG_SIM_WINDOW_SIZE 0x01000000
+#define REG_SIM_IDLE_LIMIT 1000  //Longest single step of reg_sim_idle in microseconds
+#define REG_SIM_MAX_DELIVERIES 64  //Interrupts delivered in a row before giving up on a stuck source
+#define IRQ_LINES_PER_REGISTER 32
+#define BASIC_PENDING_1 (1 << 8)  //Something in irq_pending_1
+#define BASIC_PENDING_2 (1 << 9)
+
+//Offsets of the ARM interrupt controller registers
+#define IRQ_BASIC_PENDING	0x00
+#define IRQ_PENDING_1		0x04
+#define IRQ_PENDING_2		0x08
+#define FIQ_CONTROL			0x0C
+#define ENABLE_IRQS_1		0x10
+#define ENABLE_IRQS_2		0x14
+#define ENABLE_BASIC_IRQS	0x18
+#define DISABLE_IRQS_1		0x1C
+#define DISABLE_IRQS_2		0x20
+#define DISABLE_BASIC_IRQS	0x24
+#define ARM_INTERRUPTS_SIZE	0x28
+
+typedef struct {
+	uint32_t lines[2];  //Raw state of GPU IRQs 0-31 and 32-63
+	uint32_t basic;  //Raw state of the ARM timer
+	uint32_t enable[2];
+	uint32_t enable_basic;
+	uint32_t fiq_control;
+} Interrupt_Controller_State;
+
+extern void interrupt_handler(uint32_t entry_cycles);
+
+extern void bsc_model_install(void);
+extern void spi_model_install(void);
+extern void gpio_model_install(void);
+extern void arm_timer_model_install(void);
+extern void system_timer_model_install(void);
+extern void aux_model_install(void);
+
+static Reg_Sim_Model *model_list = NULL_PTR;
+static uint64_t sim_now_us = 0;
+static uint32_t cpu_interrupts_masked = 1;  //Out of reset, as on the target
+static uint32_t in_interrupt = 0;
+static unsigned char reg_sim_initialized = 0;
+static Interrupt_Controller_State controller;
+
+static Reg_Sim_Model *reg_sim_find_model(uint32_t address)
+{
+	Reg_Sim_Model *model = model_list;
+	while ((model != NULL_PTR) && ((address < model->base) || (address >= (model->base + model->size))))
+	{
+		model = model->next_ptr;
+	}
+	return model;
+}
+
+uint32_t reg_sim_read(volatile uint32_t *register_ptr)
+{
+	uint32_t address = (uint32_t)(uintptr_t)register_ptr;
+	Reg_Sim_Model *model = reg_sim_find_model(address);
+	if ((model != NULL_PTR) && (model->read_ptr != NULL_PTR))
+	{
+		return model->read_ptr(address - model->base);
+	}
+	return *register_ptr;
+}
+
+void reg_sim_write(volatile uint32_t *register_ptr, uint32_t value)
+{
+	uint32_t address = (uint32_t)(uintptr_t)register_ptr;
+	Reg_Sim_Model *model = reg_sim_find_model(address);
+	if ((model != NULL_PTR) && (model->write_ptr != NULL_PTR))
+	{
+		model->write_ptr(address - model->base, value);
+	}
+	else
+	{
+		*register_ptr = value;
+	}
+}
+
+void reg_sim_add_model(Reg_Sim_Model *model)
+{
+	model->next_ptr = model_list;
+	model_list = model;
+}
+
+volatile uint32_t *reg_sim_register(uint32_t address)
+{
+	return (volatile uint32_t *)(uintptr_t)address;
+}
+
+uint64_t reg_sim_now_us(void)
+{
+	return sim_now_us;
+}
+
+static uint32_t controller_pending(uint32_t bank)
+{
+	return controller.lines[bank] & controller.enable[bank];
+}
+
+static uint32_t controller_basic_pending(void)
+{
+	uint32_t to_return = controller.basic & controller.enable_basic;
+	if (controller_pending(0))
+	{
+		to_return |= BASIC_PENDING_1;
+	}
+	if (controller_pending(1))
+	{
+		to_return |= BASIC_PENDING_2;
+	}
+	return to_return;
+}
+
+static uint32_t controller_read(uint32_t offset)
+{
+	uint32_t to_return = 0;
+	switch (offset)
+	{
+		case IRQ_BASIC_PENDING:
+			to_return = controller_basic_pending();
+			break;
+		case IRQ_PENDING_1:
+			to_return = controller_pending(0);
+			break;
+		case IRQ_PENDING_2:
+			to_return = controller_pending(1);
+			break;
+		case FIQ_CONTROL:
+			to_return = controller.fiq_control;
+			break;
+		case ENABLE_IRQS_1:
+		case DISABLE_IRQS_1:
+			to_return = controller.enable[0];
+			break;
+		case ENABLE_IRQS_2:
+		case DISABLE_IRQS_2:
+			to_return = controller.enable[1];
+			break;
+		case ENABLE_BASIC_IRQS:
+		case DISABLE_BASIC_IRQS:
+			to_return = controller.enable_basic;
+			break;
+		default:
+			break;
+	}
+	return to_return;
+}
+
+//The enables are write 1 to set and the disables write 1 to clear
+static void controller_write(uint32_t offset, uint32_t value)
+{
+	switch (offset)
+	{
+		case FIQ_CONTROL:
+			controller.fiq_control = value;
+			break;
+		case ENABLE_IRQS_1:
+			controller.enable[0] |= value;
+			break;
+		case ENABLE_IRQS_2:
+			controller.enable[1] |= value;
+			break;
+		case ENABLE_BASIC_IRQS:
+			controller.enable_basic |= value;
+			break;
+		case DISABLE_IRQS_1:
+			controller.enable[0] &= ~value;
+			break;
+		case DISABLE_IRQS_2:
+			controller.enable[1] &= ~value;
+			break;
+		case DISABLE_BASIC_IRQS:
+			controller.enable_basic &= ~value;
+			break;
+		default:
+			break;
+	}
+	reg_sim_service_interrupts();
+}
+
+static Reg_Sim_Model controller_model = {
+	.name = "interrupt controller",
+	.base = ARM_INTERRUPTS_BASE,
+	.size = ARM_INTERRUPTS_SIZE,
+	.read_ptr = controller_read,
+	.write_ptr = controller_write,
+};
+
+void reg_sim_set_irq(uint32_t irq, uint32_t active)
+{
+	uint32_t *state = &controller.basic;
+	uint32_t bit = 1;
+	if (irq < REG_SIM_ARM_TIMER_IRQ)
+	{
+		state = &controller.lines[irq / IRQ_LINES_PER_REGISTER];
+		bit = 1 << (irq % IRQ_LINES_PER_REGISTER);
+	}
+	if (active)
+	{
+		*state |= bit;
+		reg_sim_service_interrupts();
+	}
+	else
+	{
+		*state &= ~bit;
+	}
+}
+
+/*  Take the IRQ exception as the CPU would, with the I bit set for the handler
+	and restored afterwards.  A source the handler fails to quiet would hang the
+	target, here it is reported and left for the next chance.
+*/
+
+void reg_sim_service_interrupts(void)
+{
+	uint32_t deliveries = 0;
+	while (!in_interrupt && !cpu_interrupts_masked && controller_basic_pending())
+	{
+		if (deliveries++ == REG_SIM_MAX_DELIVERIES)
+		{
+			log_string_plus("reg_sim: interrupt source stuck, basic pending: ", controller_basic_pending());
+			break;
+		}
+		in_interrupt = 1;
+		cpu_interrupts_masked = 1;
+		interrupt_handler(read_cycle_counter());
+		cpu_interrupts_masked = 0;
+		in_interrupt = 0;
+	}
+}
+
+uint32_t reg_sim_cpu_interrupts_masked(void)
+{
+	return cpu_interrupts_masked;
+}
+
+void reg_sim_mask_cpu_interrupts(uint32_t masked)
+{
+	cpu_interrupts_masked = masked;
+	if (!masked)
+	{
+		reg_sim_service_interrupts();
+	}
+}
+
+static uint64_t reg_sim_next_event(void)
+{
+	uint64_t to_return = 0;
+	for (Reg_Sim_Model *model = model_list; model != NULL_PTR; model = model->next_ptr)
+	{
+		if (model->next_event_ptr != NULL_PTR)
+		{
+			uint64_t event = model->next_event_ptr(sim_now_us);
+			if ((event > sim_now_us) && ((to_return == 0) || (event < to_return)))
+			{
+				to_return = event;
+			}
+		}
+	}
+	return to_return;
+}
+
+/*  Time is moved on in steps that end on each model event so an interrupt a
+	model raises part way through is taken (and can reprogram the model) at
+	the right time.
+*/
+
+void reg_sim_advance_us(uint32_t microseconds)
+{
+	uint64_t target = sim_now_us + microseconds;
+	while (sim_now_us < target)
+	{
+		uint64_t step_end = reg_sim_next_event();
+		if ((step_end == 0) || (step_end > target))
+		{
+			step_end = target;
+		}
+		uint32_t step = (uint32_t)(step_end - sim_now_us);
+		sim_now_us = step_end;
+		for (Reg_Sim_Model *model = model_list; model != NULL_PTR; model = model->next_ptr)
+		{
+			if (model->advance_ptr != NULL_PTR)
+			{
+				model->advance_ptr(sim_now_us, step);
+			}
+		}
+		reg_sim_service_interrupts();
+	}
+}
+
+void reg_sim_idle(void)
+{
+	uint64_t next_event = reg_sim_next_event();
+	uint32_t step = REG_SIM_IDLE_LIMIT;
+	if ((next_event != 0) && ((next_event - sim_now_us) < REG_SIM_IDLE_LIMIT))
+	{
+		step = (uint32_t)(next_event - sim_now_us);
+	}
+	reg_sim_advance_us(step);
+}
+
+/*  The window is mapped at the real peripheral address, the drivers' register
+	pointers are constants so there is nowhere else it could go.  That is also
+	why the host build is linked -no-pie, the program has to stay out of the way.
+*/
+
+Error_Returns reg_sim_init(void)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!reg_sim_initialized)
+	{
+		do
+		{
+			void *window = mmap((void *)P_BASE, REG_SIM_WINDOW_SIZE, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+			if (window != (void *)P_BASE)
+			{
+				fprintf(stderr, "reg_sim_init: unable to map the peripherals at 0x%08X\n", P_BASE);
+				to_return = RPi_InsufficientResources;
+				break;
+			}
+			reg_sim_add_model(&controller_model);
+			bsc_model_install();
+			spi_model_install();
+			gpio_model_install();
+			arm_timer_model_install();
+			system_timer_model_install();
+			aux_model_install();
+			reg_sim_initialized = 1;
+		} while(0);
+	}
+	return to_return;
+}
+
+//Up before main so the drivers' statics can be touched from the first line of a test
+__attribute__((constructor)) static void reg_sim_startup(void)
+{
+	if (reg_sim_init() != RPi_Success)
+	{
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,103 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  reg_sim.h
+
+The simulated register file for the host build.  The whole peripheral window
+(P_BASE up, 16M) is mapped at its real address as ordinary memory, so the
+drivers' register structure pointers work unchanged, and every REG_READ and
+REG_WRITE comes through here.  An access to a block that a model has claimed
+goes to the model, anything else just reads or writes the memory.
+
+Time is simulated too.  It only moves when reg_sim_advance_us is called, when
+the drivers wait for an interrupt, or by a microsecond each time the System
+Timer counter is read so busy waits finish.  Interrupts are delivered to
+interrupt_handler as soon as one is pending, enabled in the interrupt
+controller and not masked in the (simulated) CPSR.
+
+*/
+
+#pragma once
+#include "common.h"
+
+#define REG_SIM_ARM_TIMER_IRQ 64  //The ARM timer is in the basic pending register
+
+typedef struct Reg_Sim_Model_Struct {
+	const char *name;
+	uint32_t base;
+	uint32_t size;
+	uint32_t (*read_ptr)(uint32_t offset);  //NULL_PTR reads the memory
+	void (*write_ptr)(uint32_t offset, uint32_t value);  //NULL_PTR writes the memory
+	void (*advance_ptr)(uint64_t now_us, uint32_t microseconds);  //Time has moved on
+	uint64_t (*next_event_ptr)(uint64_t now_us);  //When the model next changes by itself, 0 for never
+	struct Reg_Sim_Model_Struct *next_ptr;
+} Reg_Sim_Model;
+
+//Maps the register file and installs all of the models, this is run before main
+Error_Returns reg_sim_init(void);
+
+void reg_sim_add_model(Reg_Sim_Model *model);
+
+//A model's own view of its registers, this bypasses the models
+volatile uint32_t *reg_sim_register(uint32_t address);
+
+uint64_t reg_sim_now_us(void);
+
+void reg_sim_advance_us(uint32_t microseconds);
+
+//Runs time forward to the next thing any model has scheduled (at most a millisecond)
+void reg_sim_idle(void);
+
+//Interrupt lines 0-63 are the GPU IRQs, REG_SIM_ARM_TIMER_IRQ the ARM timer
+void reg_sim_set_irq(uint32_t irq, uint32_t active);
+
+void reg_sim_service_interrupts(void);
+
+//Simulated CPSR I bit, used by the host versions of the init.s routines
+uint32_t reg_sim_cpu_interrupts_masked(void);
+
+void reg_sim_mask_cpu_interrupts(uint32_t masked);
+
+/*  The models.  Each has a few calls for a test to play the part of the
+	outside world.
+*/
+
+/*  BSC1 (I2C).  A device is a register map with an auto incrementing pointer
+	the way most sensors work, the first byte of a write sets the pointer and
+	the rest are written from there, a read returns bytes from the pointer on.
+	A transfer to an address with no device attached fails with ERR.
+*/
+Error_Returns bsc_model_attach(uint32_t slave_address, unsigned char *register_map, uint32_t size);
+
+void bsc_model_detach(uint32_t slave_address);
+
+//SPI0.  Each byte written to the FIFO is passed to transfer_ptr and what it returns is read back
+void spi_model_set_device(unsigned char (*transfer_ptr)(unsigned char mosi));
+
+//GPIO.  Outputs follow GPSET/GPCLR, inputs follow gpio_model_drive_pin and raise edge/level events
+void gpio_model_drive_pin(uint32_t pin, uint32_t level);
+
+uint32_t gpio_model_get_level(uint32_t pin);
+
+uint32_t gpio_model_get_function(uint32_t pin);
+
+uint32_t gpio_model_get_pull(uint32_t pin);  //0 none, 1 pull down, 2 pull up as clocked in by GPPUDCLK
+
+//Mini UART.  Transmitted characters go to stdout, received ones queue up for the driver
+void aux_model_receive(char c);
@@ -0,0 +1,174 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  spi_model.c
+
+Behavioural model of SPI0.  While TA is set every byte written to the FIFO is
+clocked out to the device callback at once and the byte it returns is queued
+in the receive FIFO, so TXD and DONE are always set during a transfer.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_sim.h"
+
+#define SPI_FIFO_SIZE 16
+
+//Offsets of the SPI registers
+#define SPI_COMMAND_STATUS	0x00
+#define SPI_FIFOS			0x04
+#define SPI_CLOCK_DIVIDER	0x08
+#define SPI_DATA_LENGTH		0x0C
+#define SPI_LOSSI_TOH		0x10
+#define SPI_DMA_CONTROL		0x14
+#define SPI_REGISTERS_SIZE	0x18
+
+#define SPI_CS_RX_FULL		(1 << 20)
+#define SPI_CS_RX_READ		(1 << 19)
+#define SPI_CS_TX_READY		(1 << 18)
+#define SPI_CS_RX_DATA		(1 << 17)
+#define SPI_CS_CMD_DONE		(1 << 16)
+#define SPI_CS_TA			(1 << 7)
+#define SPI_CS_CLEAR_RX		(1 << 5)
+#define SPI_CS_CLEAR_TX		(1 << 4)
+#define SPI_CS_STATUS_BITS	(0x1F << 16)
+
+typedef struct {
+	uint32_t command_status;  //Without the status and clear bits
+	uint32_t clock_divider;
+	uint32_t data_length;
+	uint32_t lossi_toh;
+	uint32_t dma_control;
+	unsigned char rx_fifo[SPI_FIFO_SIZE];
+	uint32_t rx_read;
+	uint32_t rx_write;
+	unsigned char (*transfer_ptr)(unsigned char mosi);
+} SPI_Model_State;
+
+static SPI_Model_State spi;
+
+static uint32_t spi_rx_count(void)
+{
+	return spi.rx_write - spi.rx_read;
+}
+
+static uint32_t spi_read(uint32_t offset)
+{
+	uint32_t to_return = 0;
+	switch (offset)
+	{
+		case SPI_COMMAND_STATUS:
+			to_return = spi.command_status;
+			if (spi.command_status & SPI_CS_TA)
+			{
+				to_return |= SPI_CS_TX_READY | SPI_CS_CMD_DONE;
+			}
+			if (spi_rx_count() != 0)
+			{
+				to_return |= SPI_CS_RX_DATA;
+			}
+			if (spi_rx_count() >= (SPI_FIFO_SIZE * 3 / 4))
+			{
+				to_return |= SPI_CS_RX_READ;
+			}
+			if (spi_rx_count() == SPI_FIFO_SIZE)
+			{
+				to_return |= SPI_CS_RX_FULL;
+			}
+			break;
+		case SPI_FIFOS:
+			if (spi_rx_count() != 0)
+			{
+				to_return = spi.rx_fifo[spi.rx_read++ % SPI_FIFO_SIZE];
+			}
+			break;
+		case SPI_CLOCK_DIVIDER:
+			to_return = spi.clock_divider;
+			break;
+		case SPI_DATA_LENGTH:
+			to_return = spi.data_length;
+			break;
+		case SPI_LOSSI_TOH:
+			to_return = spi.lossi_toh;
+			break;
+		case SPI_DMA_CONTROL:
+			to_return = spi.dma_control;
+			break;
+		default:
+			break;
+	}
+	return to_return;
+}
+
+static void spi_write(uint32_t offset, uint32_t value)
+{
+	switch (offset)
+	{
+		case SPI_COMMAND_STATUS:
+			if (value & SPI_CS_CLEAR_RX)
+			{
+				spi.rx_read = spi.rx_write;
+			}
+			spi.command_status = value & ~(SPI_CS_STATUS_BITS | SPI_CS_CLEAR_RX | SPI_CS_CLEAR_TX);
+			break;
+		case SPI_FIFOS:
+			if (spi.command_status & SPI_CS_TA)
+			{
+				unsigned char miso = (spi.transfer_ptr != NULL_PTR) ? spi.transfer_ptr(value) : 0;
+				if (spi_rx_count() < SPI_FIFO_SIZE)
+				{
+					spi.rx_fifo[spi.rx_write++ % SPI_FIFO_SIZE] = miso;
+				}
+			}
+			break;
+		case SPI_CLOCK_DIVIDER:
+			spi.clock_divider = value & 0xFFFF;
+			break;
+		case SPI_DATA_LENGTH:
+			spi.data_length = value & 0xFFFF;
+			break;
+		case SPI_LOSSI_TOH:
+			spi.lossi_toh = value;
+			break;
+		case SPI_DMA_CONTROL:
+			spi.dma_control = value;
+			break;
+		default:
+			break;
+	}
+}
+
+static Reg_Sim_Model spi_model = {
+	.name = "SPI0",
+	.base = SPI0_BASE,
+	.size = SPI_REGISTERS_SIZE,
+	.read_ptr = spi_read,
+	.write_ptr = spi_write,
+};
+
+void spi_model_install(void)
+{
+	reg_sim_add_model(&spi_model);
+}
+
+void spi_model_set_device(unsigned char (*transfer_ptr)(unsigned char mosi))
+{
+	spi.transfer_ptr = transfer_ptr;
+}
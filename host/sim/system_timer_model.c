@@ -0,0 +1,145 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  system_timer_model.c
+
+Behavioural model of the System Timer.  The counter is simulated time in
+microseconds.  Reading the low half moves time on by a microsecond, so a
+driver polling for a deadline gets there.  A compare register matches when
+the low half passes its value, setting the channel's status bit and raising
+its interrupt until the bit is cleared.
+
+*/
+
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_sim.h"
+
+#define SYSTEM_TIMER_CHANNELS 4
+
+//Offsets of the System Timer registers
+#define SYSTEM_TIMER_CONTROL_STATUS	0x00
+#define SYSTEM_TIMER_COUNTER_LOW	0x04
+#define SYSTEM_TIMER_COUNTER_HIGH	0x08
+#define SYSTEM_TIMER_COMPARE		0x0C
+#define SYSTEM_TIMER_REGISTERS_SIZE	0x1C
+
+typedef struct {
+	uint32_t control_status;
+	uint32_t compare[SYSTEM_TIMER_CHANNELS];
+} System_Timer_Model_State;
+
+static System_Timer_Model_State system_timer;
+
+//The compare channels are GPU IRQs 0-3
+static void system_timer_update_irq(void)
+{
+	for (uint32_t channel = 0; channel < SYSTEM_TIMER_CHANNELS; channel++)
+	{
+		reg_sim_set_irq(channel, system_timer.control_status & (1 << channel));
+	}
+}
+
+static uint32_t system_timer_read(uint32_t offset)
+{
+	uint32_t to_return = 0;
+	switch (offset)
+	{
+		case SYSTEM_TIMER_CONTROL_STATUS:
+			to_return = system_timer.control_status;
+			break;
+		case SYSTEM_TIMER_COUNTER_LOW:
+			reg_sim_advance_us(1);
+			to_return = (uint32_t)reg_sim_now_us();
+			break;
+		case SYSTEM_TIMER_COUNTER_HIGH:
+			to_return = (uint32_t)(reg_sim_now_us() >> 32);
+			break;
+		default:
+			if (offset < SYSTEM_TIMER_REGISTERS_SIZE)
+			{
+				to_return = system_timer.compare[(offset - SYSTEM_TIMER_COMPARE) / sizeof(uint32_t)];
+			}
+			break;
+	}
+	return to_return;
+}
+
+static void system_timer_write(uint32_t offset, uint32_t value)
+{
+	switch (offset)
+	{
+		case SYSTEM_TIMER_CONTROL_STATUS:
+			system_timer.control_status &= ~value;
+			system_timer_update_irq();
+			break;
+		case SYSTEM_TIMER_COUNTER_LOW:
+		case SYSTEM_TIMER_COUNTER_HIGH:
+			break;  //Read only
+		default:
+			if (offset < SYSTEM_TIMER_REGISTERS_SIZE)
+			{
+				system_timer.compare[(offset - SYSTEM_TIMER_COMPARE) / sizeof(uint32_t)] = value;
+			}
+			break;
+	}
+}
+
+static void system_timer_advance(uint64_t now_us, uint32_t microseconds)
+{
+	uint32_t previous = (uint32_t)(now_us - microseconds);
+	for (uint32_t channel = 0; channel < SYSTEM_TIMER_CHANNELS; channel++)
+	{
+		uint32_t distance = system_timer.compare[channel] - previous;
+		if ((distance != 0) && (distance <= microseconds))
+		{
+			system_timer.control_status |= 1 << channel;
+		}
+	}
+	system_timer_update_irq();
+}
+
+static uint64_t system_timer_next_event(uint64_t now_us)
+{
+	uint64_t to_return = 0;
+	for (uint32_t channel = 0; channel < SYSTEM_TIMER_CHANNELS; channel++)
+	{
+		uint32_t distance = system_timer.compare[channel] - (uint32_t)now_us;
+		if ((distance != 0) && ((to_return == 0) || ((now_us + distance) < to_return)))
+		{
+			to_return = now_us + distance;
+		}
+	}
+	return to_return;
+}
+
+static Reg_Sim_Model system_timer_model = {
+	.name = "System Timer",
+	.base = SYSTEM_TIMER_BASE,
+	.size = SYSTEM_TIMER_REGISTERS_SIZE,
+	.read_ptr = system_timer_read,
+	.write_ptr = system_timer_write,
+	.advance_ptr = system_timer_advance,
+	.next_event_ptr = system_timer_next_event,
+};
+
+void system_timer_model_install(void)
+{
+	reg_sim_add_model(&system_timer_model);
+}
@@ -0,0 +1,143 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  allocator_smoke.c
+
+Host check of the arena and the fixed block pools: alignment and running the
+arena out, a pool allocated to exhaustion and freed again with its in use
+count, high water mark and failures, and the calls that have to be refused.
+Returns non zero if any check fails.
+
+*/
+
+#include <stdio.h>
+#include "common.h"
+#include "allocator.h"
+
+#define POOL_BLOCKS 4
+#define POOL_BLOCK_SIZE 12  //Rounded up to 16
+
+static uint32_t failures = 0;
+
+#define CHECK(condition) do { \
+		if (!(condition)) \
+		{ \
+			printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while(0)
+
+static uint64_t static_storage[(POOL_BLOCKS * 16) / sizeof(uint64_t)];
+
+static void check_arena(void)
+{
+	unsigned char *first_ptr = arena_alloc(3, 1);
+	CHECK(first_ptr != NULL_PTR);
+	unsigned char *aligned_ptr = arena_alloc(64, 32);
+	CHECK(aligned_ptr != NULL_PTR);
+	CHECK(((uint32_t)aligned_ptr & 31) == 0);
+	CHECK(aligned_ptr >= first_ptr + 3);
+	CHECK(arena_used() == (uint32_t)(aligned_ptr + 64 - __arena_start__));
+	CHECK(arena_used() + arena_available() == (uint32_t)(__arena_end__ - __arena_start__));
+
+	CHECK(arena_alloc(16, 0) == NULL_PTR);
+	CHECK(arena_alloc(16, 3) == NULL_PTR);
+	uint32_t used = arena_used();
+	CHECK(arena_alloc(arena_available() + 1, 1) == NULL_PTR);
+	CHECK(arena_alloc(UINT32_MAX, 1) == NULL_PTR);
+	CHECK(arena_alloc(16, 0x80000000) == NULL_PTR);
+	CHECK(arena_used() == used);
+}
+
+static void check_pool(Memory_Pool *pool)
+{
+	void *blocks[POOL_BLOCKS];
+
+	for (uint32_t block = 0; block < POOL_BLOCKS; block++)
+	{
+		blocks[block] = pool_alloc(pool);
+		CHECK(blocks[block] != NULL_PTR);
+		CHECK(((uint32_t)blocks[block] & 7) == 0);
+		for (uint32_t other = 0; other < block; other++)
+		{
+			CHECK(blocks[block] != blocks[other]);
+		}
+	}
+	CHECK(pool->in_use == POOL_BLOCKS);
+	CHECK(pool_alloc(pool) == NULL_PTR);
+	CHECK(pool->failures == 1);
+
+	CHECK(pool_free(pool, blocks[1]) == RPi_Success);
+	CHECK(pool_free(pool, blocks[2]) == RPi_Success);
+	CHECK(pool->in_use == POOL_BLOCKS - 2);
+	CHECK(pool->high_water == POOL_BLOCKS);
+	//Last freed, first given out
+	CHECK(pool_alloc(pool) == blocks[2]);
+	CHECK(pool_alloc(pool) == blocks[1]);
+
+	//Not the start of a block, before and past the pool
+	CHECK(pool_free(pool, (unsigned char *)blocks[0] + 8) == RPi_InvalidParam);
+	CHECK(pool_free(pool, pool->storage_ptr - pool->block_size) == RPi_InvalidParam);
+	CHECK(pool_free(pool, pool->storage_ptr + (POOL_BLOCKS * pool->block_size)) == RPi_InvalidParam);
+	CHECK(pool->in_use == POOL_BLOCKS);
+
+	for (uint32_t block = 0; block < POOL_BLOCKS; block++)
+	{
+		CHECK(pool_free(pool, blocks[block]) == RPi_Success);
+	}
+	CHECK(pool->in_use == 0);
+	CHECK(pool->high_water == POOL_BLOCKS);
+	CHECK(pool->failures == 1);
+}
+
+int main(void)
+{
+	static Memory_Pool arena_pool;
+	static Memory_Pool static_pool;
+	static Memory_Pool bad_pool;
+
+	check_arena();
+
+	uint32_t used = arena_used();
+	CHECK(pool_init(&arena_pool, "arena pool", NULL_PTR, POOL_BLOCK_SIZE, POOL_BLOCKS) == RPi_Success);
+	CHECK(arena_pool.block_size == 16);
+	CHECK(arena_used() >= used + (POOL_BLOCKS * 16));
+	check_pool(&arena_pool);
+
+	CHECK(pool_init(&static_pool, "static pool", static_storage, POOL_BLOCK_SIZE, POOL_BLOCKS) == RPi_Success);
+	CHECK(static_pool.storage_ptr == (unsigned char *)static_storage);
+	check_pool(&static_pool);
+
+	//Already registered, a second pool_init would link it to itself
+	CHECK(pool_init(&arena_pool, "arena pool", NULL_PTR, POOL_BLOCK_SIZE, POOL_BLOCKS) == RPi_InUse);
+	CHECK(pool_init(NULL_PTR, "bad pool", NULL_PTR, 8, 1) == RPi_InvalidParam);
+	CHECK(pool_init(&bad_pool, NULL_PTR, NULL_PTR, 8, 1) == RPi_InvalidParam);
+	CHECK(pool_init(&bad_pool, "bad pool", NULL_PTR, 0, 1) == RPi_InvalidParam);
+	CHECK(pool_init(&bad_pool, "bad pool", NULL_PTR, 8, 0) == RPi_InvalidParam);
+	//Rounding the block size up, or the total size, would wrap
+	CHECK(pool_init(&bad_pool, "bad pool", NULL_PTR, UINT32_MAX, 1) == RPi_InvalidParam);
+	CHECK(pool_init(&bad_pool, "bad pool", NULL_PTR, 0x10000, 0x10000) == RPi_InvalidParam);
+	//Bigger than what is left of the arena
+	CHECK(pool_init(&bad_pool, "bad pool", NULL_PTR, 0x10000, 0x1000) == RPi_InsufficientResources);
+
+	//Has to come back, the list of pools must not have a cycle
+	allocator_dump_stats();
+	printf("allocator_smoke: %s\n", (failures == 0) ? "passed" : "FAILED");
+	return failures != 0;
+}
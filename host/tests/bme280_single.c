@@ -0,0 +1,42 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_single.c
+
+The BME 280 driver built a second time with real_t as float, for the
+pressure_accuracy test to compare with the library's double build.  The
+public functions are renamed bme280_single_xxx so both can be linked into one
+program.
+
+*/
+
+#ifndef SINGLE_PRECISION_MATH
+#define SINGLE_PRECISION_MATH
+#endif
+
+#define bme280_init bme280_single_init
+#define bme280_init_pt bme280_single_init_pt
+#define bme280_reset bme280_single_reset
+#define bme280_print_compensated_values bme280_single_print_compensated_values
+#define bme280_get_current_pressure bme280_single_get_current_pressure
+#define bme280_get_current_temperature bme280_single_get_current_temperature
+#define bme280_get_current_temperature_pressure bme280_single_get_current_temperature_pressure
+#define bme280_pressure_to_altitude bme280_single_pressure_to_altitude
+
+#include "../../sensors/src/bme280.c"
@@ -0,0 +1,241 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  peripheral_smoke.c
+
+Host check of the drivers against the simulated peripherals.  Each driver is
+run the way the target uses it and the results are checked in the models:
+I2C through the BSC model, SPI, GPIO functions, pulls, groups and pin events,
+the software timers and delays on simulated time, a System Timer one shot and
+UART receive.  Returns non zero if any check fails.
+
+*/
+
+#include <stdio.h>
+#include "common.h"
+#include "reg_sim.h"
+#include "gpio.h"
+#include "i2c.h"
+#include "spi.h"
+#include "aux_peripherals.h"
+#include "arm_timer.h"
+#include "system_timer.h"
+
+#define SIM_PULL_DOWN 1  //The GPPUD codes the GPIO model reports
+#define SIM_PULL_UP 2
+
+static uint32_t failures = 0;
+
+#define CHECK(condition) do { \
+		if (!(condition)) \
+		{ \
+			printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while(0)
+
+static unsigned char i2c_device[256];
+static volatile uint32_t timer_ticks = 0;
+static volatile uint32_t pin_events = 0;
+static volatile uint32_t one_shot_argument = 0;
+static volatile uint32_t characters_received = 0;
+
+static unsigned char spi_invert(unsigned char byte)
+{
+	return byte ^ 0xFF;
+}
+
+static void timer_tick(uint32_t argument)
+{
+	timer_ticks++;
+}
+
+static void pin_event(GPIO_Pins pin, uint32_t timestamp)
+{
+	pin_events++;
+}
+
+static void one_shot(uint32_t argument)
+{
+	one_shot_argument = argument;
+}
+
+static void character_received(void)
+{
+	characters_received++;
+}
+
+static void check_gpio(void)
+{
+	static const GPIO_Pin_Config pin_table[] = {
+		{gpio_pin_4, gpio_output, pupd_pull_up},
+		{gpio_pin_5, gpio_alt_2, pupd_pull_down},
+		{gpio_pin_40, gpio_input, pupd_pull_up},
+		{gpio_pin_20, gpio_output, pupd_disable},
+		{gpio_pin_21, gpio_output, pupd_disable},
+		{gpio_pin_22, gpio_output, pupd_disable},
+		{gpio_pin_23, gpio_output, pupd_disable},
+		{gpio_pin_24, gpio_output, pupd_disable},
+		{gpio_pin_41, gpio_input, pupd_disable},
+		{gpio_pin_26, gpio_input, pupd_disable}
+	};
+	static const GPIO_Pin_Config clashing_table[] = {
+		{gpio_pin_6, gpio_output, pupd_disable},
+		{gpio_pin_5, gpio_output, pupd_disable}
+	};
+	static const GPIO_Pin_Config bad_function_table[] = {
+		{gpio_pin_6, gpio_output, pupd_disable},
+		{gpio_pin_7, (GPIOFunction)8, pupd_disable}
+	};
+	static const GPIO_Pins bus_pins[] = {gpio_pin_20, gpio_pin_21, gpio_pin_22, gpio_pin_23};
+	static const GPIO_Pins split_pins[] = {gpio_pin_24, gpio_pin_41};
+	GPIO_Pin_Group group;
+	uint32_t value = 0;
+
+	CHECK(gpio_configure(pin_table, GPIO_CONFIG_COUNT(pin_table)) == RPi_Success);
+	CHECK(gpio_model_get_function(4) == gpio_output);
+	CHECK(gpio_model_get_function(5) == gpio_alt_2);
+	CHECK(gpio_model_get_function(40) == gpio_input);
+	CHECK(gpio_model_get_pull(4) == SIM_PULL_UP);
+	CHECK(gpio_model_get_pull(5) == SIM_PULL_DOWN);
+	CHECK(gpio_model_get_pull(40) == SIM_PULL_UP);
+	CHECK(gpio_model_get_pull(20) == 0);
+	//Nothing in a table is applied if any of it is bad
+	CHECK(gpio_configure(clashing_table, GPIO_CONFIG_COUNT(clashing_table)) == GPIO_Pin_In_Use);
+	CHECK(gpio_model_get_function(6) == gpio_input);
+	CHECK(gpio_configure(bad_function_table, GPIO_CONFIG_COUNT(bad_function_table)) == RPi_InvalidParam);
+	CHECK(gpio_model_get_function(6) == gpio_input);
+	CHECK(gpio_model_get_function(7) == gpio_input);
+
+	CHECK(gpio_set_pin(gpio_pin_4) == RPi_Success);
+	CHECK(gpio_model_get_level(4) == 1);
+	CHECK(gpio_clear_pin(gpio_pin_4) == RPi_Success);
+	CHECK(gpio_model_get_level(4) == 0);
+	gpio_model_drive_pin(26, 1);
+	CHECK((gpio_get_level(gpio_pin_26, &value) == RPi_Success) && (value == 1));
+
+	CHECK(gpio_group_init(&group, bus_pins, 4) == RPi_Success);
+	CHECK(group.shift == 20);
+	CHECK(gpio_group_write(&group, 0xA) == RPi_Success);
+	CHECK(!gpio_model_get_level(20) && gpio_model_get_level(21) && !gpio_model_get_level(22) && gpio_model_get_level(23));
+	CHECK((gpio_group_read(&group, &value) == RPi_Success) && (value == 0xA));
+	CHECK(gpio_write_mask(gpio_bank_0, 1 << 20, 1 << 21) == RPi_Success);
+	CHECK(gpio_model_get_level(20) && !gpio_model_get_level(21));
+	CHECK(gpio_write_mask(gpio_bank_0, 1 << 26, 0) == RPi_InvalidParam);
+
+	//Pin 41 is an input so the write is refused before pin 24 in the other bank is touched
+	CHECK(gpio_group_init(&group, split_pins, 2) == RPi_Success);
+	CHECK(group.shift == GPIO_GROUP_NOT_CONSECUTIVE);
+	CHECK(gpio_group_write(&group, 3) == RPi_InvalidParam);
+	CHECK(gpio_model_get_level(24) == 0);
+	CHECK(gpio_group_write(NULL_PTR, 3) == RPi_InvalidParam);
+	CHECK(gpio_group_read(NULL_PTR, &value) == RPi_InvalidParam);
+
+	CHECK(gpio_set_rising_detect_pin(gpio_pin_40) == RPi_Success);
+	CHECK(gpio_register_event_callback(gpio_pin_40, pin_event) == RPi_Success);
+	//Pulled up, so it starts high
+	gpio_model_drive_pin(40, 0);
+	gpio_model_drive_pin(40, 1);
+	gpio_model_drive_pin(40, 0);
+	gpio_model_drive_pin(40, 1);
+	CHECK(pin_events == 2);
+}
+
+static void check_serial(void)
+{
+	static const unsigned char register_write[] = {0x10, 1, 2, 3};
+	unsigned char address = 0x20;
+	unsigned char read_back[40];
+	unsigned char spi_buffer[3] = {0x01, 0x02, 0x03};
+	uint32_t matches = 1;
+
+	CHECK(i2c_init() == RPi_Success);
+	CHECK(gpio_model_get_function(2) == gpio_alt_0);
+	CHECK(bsc_model_attach(0x68, i2c_device, sizeof(i2c_device)) == RPi_Success);
+	CHECK(i2c_write(0x68, (unsigned char *)register_write, sizeof(register_write)) == RPi_Success);
+	CHECK((i2c_device[0x10] == 1) && (i2c_device[0x11] == 2) && (i2c_device[0x12] == 3));
+	//Longer than the 16 byte FIFO so the read has to be drained as it goes
+	for (uint32_t index = 0; index < sizeof(read_back); index++)
+	{
+		i2c_device[address + index] = index * 3;
+	}
+	CHECK(i2c_write(0x68, &address, 1) == RPi_Success);
+	CHECK(i2c_read(0x68, read_back, sizeof(read_back)) == RPi_Success);
+	for (uint32_t index = 0; index < sizeof(read_back); index++)
+	{
+		matches &= (read_back[index] == (unsigned char)(index * 3));
+	}
+	CHECK(matches);
+	CHECK(i2c_write(0x50, (unsigned char *)register_write, sizeof(register_write)) == I2CS_Ack_Error);
+
+	CHECK(spi_init() == RPi_Success);
+	CHECK(gpio_model_get_function(11) == gpio_alt_0);
+	spi_model_set_device(spi_invert);
+	CHECK(spi_read(spi_ce_zero, spi_cpol_low, spi_cpha_middle, spi_cpol_low, spi_buffer, 3) == RPi_Success);
+	//spi_read drops the byte clocked in with the first command byte, the rest move down one
+	CHECK((spi_buffer[0] == 0xFD) && (spi_buffer[1] == 0xFC) && (spi_buffer[2] == 0xFF));
+
+	uart_set_rx_handler(character_received);
+	aux_model_receive('x');
+	CHECK(characters_received == 1);
+	CHECK(aux_getchar() == 'x');
+}
+
+static void check_timers(void)
+{
+	Soft_Timer timer;
+	CHECK(arm_timer_init() == RPi_Success);
+	CHECK(system_timer_init() == RPi_Success);
+
+	CHECK(arm_timer_init_soft_timer(&timer, timer_tick, 0) == RPi_Success);
+	CHECK(arm_timer_start_us(&timer, 1000, Soft_Timer_Periodic) == RPi_Success);
+	reg_sim_advance_us(10000);
+	CHECK((timer_ticks >= 9) && (timer_ticks <= 11));
+
+	uint64_t start = timer_now_us();
+	timer_delay_ms(5);
+	uint64_t elapsed = timer_now_us() - start;
+	CHECK((elapsed >= 5000) && (elapsed < 5200));
+	arm_timer_cancel(&timer);
+	//Milliseconds that don't fit in 32 bits of microseconds
+	CHECK(arm_timer_start(&timer, (UINT32_MAX / 1000) + 1, Soft_Timer_One_Shot) == RPi_InvalidParam);
+	CHECK(arm_timer_start(&timer, 2, Soft_Timer_One_Shot) == RPi_Success);
+	CHECK(arm_timer_cancel(&timer) == RPi_Success);
+
+	//A wake time that has already gone by returns straight away
+	start = timer_now_us();
+	timer_delay_until_us(start - 10);
+	CHECK((timer_now_us() - start) < 100);
+
+	CHECK(system_timer_set_one_shot(system_timer_channel_1, timer_now_us() + 300, one_shot, 7) == RPi_Success);
+	reg_sim_advance_us(299);
+	reg_sim_advance_us(10);
+	CHECK(one_shot_argument == 7);
+}
+
+int main(void)
+{
+	CHECK(gpio_init() == RPi_Success);
+	CHECK(uart_init() == RPi_Success);
+	check_timers();  //Sets up the interrupt handler the pin events need
+	check_gpio();
+	check_serial();
+	printf("peripheral_smoke: %s\n", (failures == 0) ? "passed" : "FAILED");
+	return failures != 0;
+}
@@ -0,0 +1,156 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  pressure_accuracy.c
+
+Bounds what single precision (SINGLE_PRECISION_MATH) costs the BME 280
+pressure compensation and the barometric altitude.  A simulated BME 280 on
+the I2C bus is swept over its raw temperature and pressure range, each
+reading is compensated by the library (double) and by bme280_single.c
+(float), and the test fails if they are further apart than the limits.  The
+limits are well inside the sensor's own relative accuracy of 12 Pa (about
+1 m).  Building the libraries with MATHOPS=-DSINGLE_PRECISION_MATH makes
+both sides float and the test meaningless.
+
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include "common.h"
+#include "reg_sim.h"
+#include "gpio.h"
+#include "bme280.h"
+
+#define PRESSURE_ERROR_LIMIT 0.5  //Pa
+#define ALTITUDE_ERROR_LIMIT 0.05  //m
+#define BME280_ADDRESS 0x76
+#define BME280_TRIM_REGISTER 0x88
+#define BME280_CHIP_ID_REGISTER 0xD0
+#define BME280_DATA_REGISTER 0xF7
+#define BME280_CHIP_ID 0x60
+#define LOWEST_PRESSURE 30000.0  //The BME 280's operating range, in Pa
+#define HIGHEST_PRESSURE 110000.0
+#define BASE_ADC_P 415148  //About 1007 hPa at 25C with these trim values
+#define ADC_T_FIRST 420000
+#define ADC_T_LAST 620000
+#define ADC_T_STEP 20000
+#define ADC_P_FIRST 150000
+#define ADC_P_LAST 700000
+#define ADC_P_STEP 997
+
+//The float build in bme280_single.c
+Error_Returns bme280_single_init(uint32_t id, BME280_mode mode);
+Error_Returns bme280_single_get_current_pressure(uint32_t id, float *pressure_ptr);
+float bme280_single_pressure_to_altitude(float base_pressure, float current_pressure);
+
+//Trim values from the Bosch datasheet's worked example, dig_T1 to dig_P9
+static const int32_t trim_values[] = {
+	27504, 26435, -1000,
+	36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000
+};
+
+static unsigned char bme280_registers[256];
+
+//Altitude mode reads the xlsb nibble from the top of the register
+static void set_raw_reading(int32_t adc_T, int32_t adc_P)
+{
+	unsigned char *data = &bme280_registers[BME280_DATA_REGISTER];
+	data[0] = (adc_P >> 12) & 0xFF;
+	data[1] = (adc_P >> 4) & 0xFF;
+	data[2] = (adc_P & 0x0F) << 4;
+	data[3] = (adc_T >> 12) & 0xFF;
+	data[4] = (adc_T >> 4) & 0xFF;
+	data[5] = (adc_T & 0x0F) << 4;
+}
+
+static uint32_t read_both(int32_t adc_T, int32_t adc_P, double *double_pressure, float *single_pressure)
+{
+	set_raw_reading(adc_T, adc_P);
+	return (bme280_get_current_pressure(0, double_pressure) == RPi_Success) &&
+		(bme280_single_get_current_pressure(0, single_pressure) == RPi_Success);
+}
+
+int main(void)
+{
+	uint32_t failures = 0;
+	uint32_t samples = 0;
+	double worst_pressure = 0;
+	double worst_altitude = 0;
+
+	for (uint32_t index = 0; index < sizeof(trim_values) / sizeof(trim_values[0]); index++)
+	{
+		bme280_registers[BME280_TRIM_REGISTER + (2 * index)] = trim_values[index] & 0xFF;
+		bme280_registers[BME280_TRIM_REGISTER + (2 * index) + 1] = (trim_values[index] >> 8) & 0xFF;
+	}
+	bme280_registers[BME280_CHIP_ID_REGISTER] = BME280_CHIP_ID;
+	if ((gpio_init() != RPi_Success) ||
+		(bsc_model_attach(BME280_ADDRESS, bme280_registers, sizeof(bme280_registers)) != RPi_Success) ||
+		(bme280_init(0, bme280_altitude_mode) != RPi_Success) ||
+		(bme280_single_init(0, bme280_altitude_mode) != RPi_Success))
+	{
+		printf("pressure_accuracy: couldn't bring up the simulated BME280\n");
+		return 1;
+	}
+
+	for (int32_t adc_T = ADC_T_FIRST; adc_T <= ADC_T_LAST; adc_T += ADC_T_STEP)
+	{
+		double double_base;
+		float single_base;
+		if (!read_both(adc_T, BASE_ADC_P, &double_base, &single_base))
+		{
+			failures++;
+			continue;
+		}
+		for (int32_t adc_P = ADC_P_FIRST; adc_P <= ADC_P_LAST; adc_P += ADC_P_STEP)
+		{
+			double double_pressure;
+			float single_pressure;
+			if (!read_both(adc_T, adc_P, &double_pressure, &single_pressure))
+			{
+				failures++;
+				continue;
+			}
+			if ((double_pressure < LOWEST_PRESSURE) || (double_pressure > HIGHEST_PRESSURE))
+			{
+				continue;
+			}
+			double pressure_error = fabs(double_pressure - single_pressure);
+			double altitude_error = fabs(bme280_pressure_to_altitude(double_base, double_pressure) -
+				bme280_single_pressure_to_altitude(single_base, single_pressure));
+			if (pressure_error > worst_pressure)
+			{
+				worst_pressure = pressure_error;
+			}
+			if (altitude_error > worst_altitude)
+			{
+				worst_altitude = altitude_error;
+			}
+			samples++;
+		}
+	}
+
+	printf("pressure_accuracy: %u samples, worst pressure error %.4f Pa, worst altitude error %.4f m\n",
+		samples, worst_pressure, worst_altitude);
+	if ((samples == 0) || (worst_pressure > PRESSURE_ERROR_LIMIT) || (worst_altitude > ALTITUDE_ERROR_LIMIT))
+	{
+		failures++;
+	}
+	printf("pressure_accuracy: %s\n", (failures == 0) ? "passed" : "FAILED");
+	return failures != 0;
+}
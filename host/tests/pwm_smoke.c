@@ -0,0 +1,177 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  pwm_smoke.c
+
+Host check of the PWM driver.  There is no PWM, clock manager or DMA model so
+their registers are plain memory in the simulated register file, which is
+enough to check what the driver writes: the clock set up, a channel's range
+and pulse width, its pin function, and the control block and register
+sequence for a DMA sequence, along with the parameter checks.  Returns non
+zero if any check fails.
+
+*/
+
+#include <stdio.h>
+#include "common.h"
+#include "reg_definitions.h"
+#include "reg_sim.h"
+#include "gpio.h"
+#include "pwm.h"
+
+//Register addresses as the driver has them, it keeps its layout to itself
+#define PWM_CONTROL (PWM_BASE + 0x00)
+#define PWM_DMA_CONFIGURATION (PWM_BASE + 0x08)
+#define PWM_RANGE_1 (PWM_BASE + 0x10)
+#define PWM_DATA_1 (PWM_BASE + 0x14)
+#define PWM_RANGE_2 (PWM_BASE + 0x20)
+#define PWM_DATA_2 (PWM_BASE + 0x24)
+#define CM_PWM_CONTROL (CM_BASE + 0xA0)
+#define CM_PWM_DIVISOR (CM_BASE + 0xA4)
+#define DMA_CONTROL_STATUS (DMA_BASE + 0x500)
+#define DMA_CONTROL_BLOCK_ADDRESS (DMA_BASE + 0x504)
+#define DMA_ENABLE (DMA_BASE + 0xFF0)
+
+#define CM_ENABLE (1 << 4)
+#define PWM_CONTROL_ENABLE 0x01
+#define PWM_CONTROL_USE_FIFO 0x20
+#define PWM_CONTROL_MARK_SPACE 0x80
+#define PWM_DMA_ENABLE (1u << 31)
+#define DMA_CS_ACTIVE (1 << 0)
+#define DMA_CS_ERROR (1 << 8)
+
+//The control block as the DMA engine reads it
+typedef struct {
+	uint32_t transfer_information;
+	uint32_t source_address;
+	uint32_t destination_address;
+	uint32_t transfer_length;
+	uint32_t stride;
+	uint32_t next_control_block;
+} Control_Block;
+
+static uint32_t failures = 0;
+
+#define CHECK(condition) do { \
+		if (!(condition)) \
+		{ \
+			printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while(0)
+
+static uint32_t pulse_sequence[4] __attribute__((aligned(4))) = {10000, 12500, 15000, 20000};
+static uint32_t too_long_sequence[2] __attribute__((aligned(4))) = {10000, 200001};
+
+static uint32_t reg(uint32_t address)
+{
+	return *reg_sim_register(address);
+}
+
+static void check_channels(void)
+{
+	CHECK(pwm_channel_enable(pwm_channel_1, gpio_pin_18, 20000) == RPi_Success);
+	CHECK(gpio_model_get_function(18) == gpio_alt_5);
+	CHECK(reg(PWM_RANGE_1) == 20000 * PWM_TICKS_PER_MICROSECOND);
+	CHECK((reg(PWM_CONTROL) & (PWM_CONTROL_MARK_SPACE | PWM_CONTROL_ENABLE)) ==
+		(PWM_CONTROL_MARK_SPACE | PWM_CONTROL_ENABLE));
+	CHECK(pwm_set_pulse_us(pwm_channel_1, 1500) == RPi_Success);
+	CHECK(reg(PWM_DATA_1) == 1500 * PWM_TICKS_PER_MICROSECOND);
+	CHECK(pwm_set_pulse_ns(pwm_channel_1, 1000500) == RPi_Success);
+	CHECK(reg(PWM_DATA_1) == 10005);
+	//Longer than the period
+	CHECK(pwm_set_pulse_us(pwm_channel_1, 20001) == RPi_InvalidParam);
+	CHECK(reg(PWM_DATA_1) == 10005);
+
+	//Channel 2 can't have channel 1's pins, and a channel keeps its first pin
+	CHECK(pwm_channel_enable(pwm_channel_2, gpio_pin_18, 2500) == RPi_InvalidParam);
+	CHECK(pwm_set_pulse_us(pwm_channel_2, 1000) == RPi_InvalidParam);
+	CHECK(pwm_channel_enable(pwm_channel_2, gpio_pin_13, 2500) == RPi_Success);
+	CHECK(gpio_model_get_function(13) == gpio_alt_0);
+	CHECK(reg(PWM_RANGE_2) == 2500 * PWM_TICKS_PER_MICROSECOND);
+	CHECK(pwm_set_pulse_us(pwm_channel_2, 1000) == RPi_Success);
+	CHECK(reg(PWM_DATA_2) == 1000 * PWM_TICKS_PER_MICROSECOND);
+	CHECK(pwm_channel_enable(pwm_channel_1, gpio_pin_12, 20000) == RPi_InvalidParam);
+	CHECK(pwm_channel_enable(pwm_channel_1, gpio_pin_18, 0) == RPi_InvalidParam);
+}
+
+static void check_dma(void)
+{
+	Control_Block *control_block;
+
+	CHECK(pwm_dma_start(pwm_channel_1, NULL_PTR, 4, 0) == RPi_InvalidParam);
+	CHECK(pwm_dma_start(pwm_channel_1, pulse_sequence, 0, 0) == RPi_InvalidParam);
+	CHECK(pwm_dma_start(pwm_channel_1, (uint32_t *)((uint32_t)pulse_sequence + 2), 2, 0) == RPi_InvalidParam);
+	//The second pulse is longer than the 20ms period
+	CHECK(pwm_dma_start(pwm_channel_1, too_long_sequence, 2, 0) == RPi_InvalidParam);
+	CHECK(!(reg(PWM_DMA_CONFIGURATION) & PWM_DMA_ENABLE));
+
+	CHECK(pwm_dma_start(pwm_channel_1, pulse_sequence, 4, 1) == RPi_Success);
+	CHECK(pwm_dma_busy());
+	CHECK(reg(DMA_ENABLE) & (1 << 5));
+	CHECK(reg(DMA_CONTROL_STATUS) & DMA_CS_ACTIVE);
+	CHECK(reg(PWM_DMA_CONFIGURATION) & PWM_DMA_ENABLE);
+	CHECK(reg(PWM_CONTROL) & PWM_CONTROL_USE_FIFO);
+	CHECK(!(reg(PWM_CONTROL) & (PWM_CONTROL_USE_FIFO << 8)));
+	control_block = (Control_Block *)(reg(DMA_CONTROL_BLOCK_ADDRESS) & ~BUS_RAM_ALIAS);
+	CHECK(((uint32_t)control_block & 31) == 0);
+	CHECK(control_block->source_address == ((uint32_t)pulse_sequence | BUS_RAM_ALIAS));
+	CHECK(control_block->destination_address == BUS_PERIPHERAL_BASE + (PWM_BASE - P_BASE) + 0x18);
+	CHECK(control_block->transfer_length == sizeof(pulse_sequence));
+	//Looping, so it points back at itself
+	CHECK(control_block->next_control_block == reg(DMA_CONTROL_BLOCK_ADDRESS));
+
+	//One sequence at a time and DAT is left alone while the channel is fed
+	CHECK(pwm_dma_start(pwm_channel_2, pulse_sequence, 1, 0) == RPi_InUse);
+	CHECK(pwm_set_pulse_us(pwm_channel_1, 1000) == RPi_InUse);
+	CHECK(pwm_set_pulse_us(pwm_channel_2, 500) == RPi_Success);
+
+	//An error the engine flagged is cleared by the reset but the stop still completes
+	*reg_sim_register(DMA_CONTROL_STATUS) |= DMA_CS_ERROR;
+	CHECK(pwm_dma_stop() == RPi_Success);
+	CHECK(!pwm_dma_busy());
+	CHECK(!(reg(DMA_CONTROL_STATUS) & DMA_CS_ACTIVE));
+	CHECK(!(reg(PWM_DMA_CONFIGURATION) & PWM_DMA_ENABLE));
+	CHECK(!(reg(PWM_CONTROL) & PWM_CONTROL_USE_FIFO));
+	CHECK(pwm_set_pulse_us(pwm_channel_1, 1000) == RPi_Success);
+	CHECK(pwm_dma_stop() == RPi_Success);
+
+	//Once through, then the channel is disabled with it still running
+	CHECK(pwm_dma_start(pwm_channel_1, pulse_sequence, 2, 0) == RPi_Success);
+	control_block = (Control_Block *)(reg(DMA_CONTROL_BLOCK_ADDRESS) & ~BUS_RAM_ALIAS);
+	CHECK(control_block->next_control_block == 0);
+	CHECK(control_block->transfer_length == 2 * sizeof(uint32_t));
+	CHECK(pwm_channel_disable(pwm_channel_1) == RPi_Success);
+	CHECK(!pwm_dma_busy());
+	CHECK(!(reg(PWM_CONTROL) & PWM_CONTROL_ENABLE));
+	CHECK(pwm_dma_start(pwm_channel_1, pulse_sequence, 2, 0) == RPi_InvalidParam);
+}
+
+int main(void)
+{
+	CHECK(pwm_set_pulse_us(pwm_channel_1, 1000) == RPi_NotInitialized);
+	CHECK(pwm_dma_stop() == RPi_NotInitialized);
+	CHECK(pwm_init() == RPi_Success);
+	CHECK(reg(CM_PWM_CONTROL) & CM_ENABLE);
+	CHECK(reg(CM_PWM_DIVISOR) == (0x5A000000 | (50 << 12)));
+	check_channels();
+	check_dma();
+	printf("pwm_smoke: %s\n", (failures == 0) ? "passed" : "FAILED");
+	return failures != 0;
+}
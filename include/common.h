@@ -29,9 +29,52 @@ language code for CPU operations.
 #include <stdio.h>
 
 #define NULL_PTR 0
-#define SVC_INITIAL_STACK 0x8000000
 #define	BITS_IN_BYTE	8
 
+/*  Symbols from the linker script (test_controller/src/memmap), only their
+	addresses mean anything.
+*/
+extern unsigned char __svc_stack_top__[];
+extern unsigned char __arena_start__[];
+extern unsigned char __arena_end__[];
+
+#define SVC_INITIAL_STACK ((uint32_t)__svc_stack_top__)
+
+/*  Place a variable in the big data region instead of bss.  BIGDATA is cleared
+	at reset like bss, NOINIT is left as it was so it survives a warm reset
+	(a recorder can be read back after a crash) but starts out as garbage.
+*/
+#define BIGDATA __attribute__((section(".bigdata")))
+#define NOINIT __attribute__((section(".noinit")))
+
+/*  Code placement for the 16K I cache, see memmap.  HOT functions are linked
+	together right after the vectors and the build fails if they outgrow the
+	cache, they are the interrupt handlers and whatever runs for every sample.
+	COLD is for init, dumps and benchmarks, it goes after the rest of the code.
+	FIRMWARE puts a constant table that is only read at boot at the very end.
+*/
+#define HOT __attribute__((section(".text.hot")))
+#define COLD __attribute__((section(".text.cold")))
+#define FIRMWARE __attribute__((section(".firmware")))
+
+/*  Sensor and filter math is done in real_t.  That is double unless the build
+	defines SINGLE_PRECISION_MATH (see MATHOPS in Makefile.inc), the VFP11 does
+	single precision in about half the cycles of double.  Floating point
+	constants in real_t code go through REAL() so they don't drag the
+	arithmetic back up to double.
+*/
+#ifdef SINGLE_PRECISION_MATH
+typedef float real_t;
+#define REAL(constant) constant##f
+#define REAL_POW powf
+#define REAL_FABS fabsf
+#else
+typedef double real_t;
+#define REAL(constant) constant
+#define REAL_POW pow
+#define REAL_FABS fabs
+#endif
+
 typedef enum {
 	RPi_Success,
 	RPi_Timeout,
@@ -69,3 +112,46 @@ extern void enable_cpu_interrupts(void);
 
 extern void disable_cpu_interrupts(void);
 
+//Masks CPU interrupts and returns the previous CPSR so the caller can restore it
+extern uint32_t enter_critical_section(void);
+
+extern void exit_critical_section(uint32_t saved_cpsr);
+
+//Returns the CPSR without changing it
+extern uint32_t get_cpsr(void);
+
+//Starts the ARM1176 cycle counter (CCNT) if it isn't already running
+extern void enable_cycle_counter(void);
+
+extern uint32_t read_cycle_counter(void);
+
+//The rest of the ARM1176 performance monitor, used by utilities/profile.c
+extern uint32_t read_pmu_control(void);
+
+extern void write_pmu_control(uint32_t control);
+
+extern uint32_t read_event_counter_0(void);
+
+extern uint32_t read_event_counter_1(void);
+
+//Sleeps until an interrupt is pending, it wakes even if IRQs are masked in the CPSR
+extern void wait_for_interrupt(void);
+
+/*  Data cache maintenance for memory shared with a DMA engine (or the GPU).
+	The range is rounded out to whole 32 byte lines, so a buffer that is going
+	to be invalidated shouldn't share a line with anything else.  All of these
+	finish with a data synchronization barrier.
+*/
+extern void clean_dcache_range(const void *start, uint32_t length);
+
+extern void invalidate_dcache_range(void *start, uint32_t length);
+
+extern void clean_invalidate_dcache_range(void *start, uint32_t length);
+
+extern void data_sync_barrier(void);
+
+extern void data_memory_barrier(void);
+
+//CP15 c1 control register, shows whether the MMU and caches were turned on at boot
+extern uint32_t get_system_control(void);
+
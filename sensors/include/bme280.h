@@ -26,6 +26,7 @@ and barometric pressure chip.
 
 #pragma once
 #include "common.h"
+#include "protothread.h"
 
 #define BME280_NUMBER_SUPPORTED_DEVICES 2
 
@@ -41,12 +42,16 @@ typedef enum {
 
 Error_Returns bme280_init(uint32_t id, BME280_mode mode);
 
+ProtothreadStatus bme280_init_pt(Protothread *pt, uint32_t id, BME280_mode mode, Error_Returns *status_ptr);
+
 Error_Returns bme280_reset(uint32_t id);
 
 Error_Returns bme280_print_compensated_values(uint32_t id);
 
-Error_Returns bme280_get_current_pressure(uint32_t id, double *pressure_ptr);
+Error_Returns bme280_get_current_pressure(uint32_t id, real_t *pressure_ptr);
+
+Error_Returns bme280_get_current_temperature(uint32_t id, real_t *temperature_ptr);
 
-Error_Returns bme280_get_current_temperature(uint32_t id, double *temperature_ptr);
+Error_Returns bme280_get_current_temperature_pressure(uint32_t id, real_t *temperature_ptr, real_t *pressure_ptr);
 
-Error_Returns bme280_get_current_temperature_pressure(uint32_t id, double *temperature_ptr, double *pressure_ptr);
+real_t bme280_pressure_to_altitude(real_t base_pressure, real_t current_pressure);
@@ -25,6 +25,7 @@ Interface into the support software for the InvenSense MPU 6050 motion processin
 
 #pragma once
 #include "common.h"
+#include "protothread.h"
 
 //TODO:  REMOVE!  This is here so the client knows how large this is
 #define DMP_PACKET_SIZE 42
@@ -47,6 +48,8 @@ typedef struct {
 
 Error_Returns mpu6050_init();
 
+ProtothreadStatus mpu6050_init_pt(Protothread *pt, Error_Returns *status_ptr);
+
 Error_Returns mpu6050_reset();
 
 Error_Returns mpu6050_retrieve_values(MPU6050_Accel_Gyro_Values *values);
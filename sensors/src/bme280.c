@@ -26,11 +26,13 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 */
 
 #include <stdio.h>
+#include <math.h>
 #include "spi.h"
 #include "i2c.h"
 #include "log.h"
 #include "bme280.h"
 #include "arm_timer.h"
+#include "protothread.h"
 
 #define I2C_FIRST_SLAVE_ADDRESS 0x76
 
@@ -65,7 +67,7 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 
 #define BME280_STATUS_MEASURING_BIT	3
 
-#define TIME_DELAY 900000
+#define BME280_SETTLE_DELAY 250  //In milliseconds
 #define BME280_STATUS_READ_ATTEMPTS	10
 #define BME280_UPPER_WORD_MASK		12
 #define BME280_MIDDLE_WORD_MASK		4
@@ -73,6 +75,10 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 #define BME280_IIR_DISABLED_1X_SAMPLING_MASK	0
 #define BME280_REGISTER_BIT_SIZE	8
 
+//The barometric formula from the Bosch BMP180 datasheet
+#define BAROMETRIC_EXPONENT			REAL(0.1902225603956629)  //Basically 1/5.22
+#define BAROMETRIC_MULTIPLIER		44330
+
 typedef struct Comp_Params {
 	unsigned short dig_T1;
 	signed short dig_T2;
@@ -105,7 +111,7 @@ static unsigned char bme280_ready = 0;
 static uint32_t pressure_temperature_xlsb_mask = 0;
 
 //Communication routine with the BME 280 depending on how it is wired
-static Error_Returns bme280_write(uint32_t id, unsigned char *buffer, unsigned int tx_bytes)
+HOT static Error_Returns bme280_write(uint32_t id, unsigned char *buffer, unsigned int tx_bytes)
 #ifndef SPI_MODE
 {
 	return i2c_write(id + I2C_FIRST_SLAVE_ADDRESS, buffer, tx_bytes);
@@ -120,7 +126,7 @@ static Error_Returns bme280_write(uint32_t id, unsigned char *buffer, unsigned i
 #endif
 
 //Communication routine with the BME 280 depending on how it is wired
-static Error_Returns bme280_read(uint32_t id, unsigned char *buffer, unsigned int rx_bytes)
+HOT static Error_Returns bme280_read(uint32_t id, unsigned char *buffer, unsigned int rx_bytes)
 {
 	Error_Returns to_return = RPi_Success;
 #ifndef SPI_MODE
@@ -137,69 +143,69 @@ static Error_Returns bme280_read(uint32_t id, unsigned char *buffer, unsigned in
 }
 
 //Taken straight from the Bosch manual.
-static double compensateTemperature(uint32_t id, int32_t adc_T)
+HOT static real_t compensateTemperature(uint32_t id, int32_t adc_T)
 {
-  double v_x1_u32;
-  double v_x2_u32;
-  double temperature;
+  real_t v_x1_u32;
+  real_t v_x2_u32;
+  real_t temperature;
   
   Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
   
-  v_x1_u32  = (((double)adc_T) / 16384.0 - ((double)params_ptr->dig_T1) / 1024.0) * ((double)params_ptr->dig_T2);
-  v_x2_u32  = ((((double)adc_T) / 131072.0 - ((double)params_ptr->dig_T1) / 8192.0) * (((double)adc_T) / 131072.0 - ((double)params_ptr->dig_T1) / 8192.0)) * ((double)params_ptr->dig_T3);
+  v_x1_u32  = (((real_t)adc_T) / REAL(16384.0) - ((real_t)params_ptr->dig_T1) / REAL(1024.0)) * ((real_t)params_ptr->dig_T2);
+  v_x2_u32  = ((((real_t)adc_T) / REAL(131072.0) - ((real_t)params_ptr->dig_T1) / REAL(8192.0)) * (((real_t)adc_T) / REAL(131072.0) - ((real_t)params_ptr->dig_T1) / REAL(8192.0))) * ((real_t)params_ptr->dig_T3);
   params_ptr->t_fine = (BME280_S32_t)(v_x1_u32 + v_x2_u32);
-  temperature  = (v_x1_u32 + v_x2_u32) / 5120.0;
+  temperature  = (v_x1_u32 + v_x2_u32) / REAL(5120.0);
   return temperature;
 }
 
 //Taken straight from the Bosch manual.
-static double compensatePressure(uint32_t id, int32_t adc_P)
+HOT static real_t compensatePressure(uint32_t id, int32_t adc_P)
 {
-  double v_x1_u32;
-  double v_x2_u32;
-  double pressure;
+  real_t v_x1_u32;
+  real_t v_x2_u32;
+  real_t pressure;
   
   Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
   
-  v_x1_u32 = ((double)params_ptr->t_fine / 2.0) - 64000.0;
-  v_x2_u32 = v_x1_u32 * v_x1_u32 * ((double)params_ptr->dig_P6) / 32768.0;
-  v_x2_u32 = v_x2_u32 + v_x1_u32 * ((double)params_ptr->dig_P5) * 2.0;
-  v_x2_u32 = (v_x2_u32 / 4.0) + (((double)params_ptr->dig_P4) * 65536.0);
-  v_x1_u32 = (((double)params_ptr->dig_P3) * v_x1_u32 * v_x1_u32 / 524288.0 + ((double)params_ptr->dig_P2) * v_x1_u32) / 524288.0;
-  v_x1_u32 = (1.0 + v_x1_u32 / 32768.0) * ((double)params_ptr->dig_P1);
-  pressure = 1048576.0 - (double)adc_P;
+  v_x1_u32 = ((real_t)params_ptr->t_fine / REAL(2.0)) - REAL(64000.0);
+  v_x2_u32 = v_x1_u32 * v_x1_u32 * ((real_t)params_ptr->dig_P6) / REAL(32768.0);
+  v_x2_u32 = v_x2_u32 + v_x1_u32 * ((real_t)params_ptr->dig_P5) * REAL(2.0);
+  v_x2_u32 = (v_x2_u32 / REAL(4.0)) + (((real_t)params_ptr->dig_P4) * REAL(65536.0));
+  v_x1_u32 = (((real_t)params_ptr->dig_P3) * v_x1_u32 * v_x1_u32 / REAL(524288.0) + ((real_t)params_ptr->dig_P2) * v_x1_u32) / REAL(524288.0);
+  v_x1_u32 = (REAL(1.0) + v_x1_u32 / REAL(32768.0)) * ((real_t)params_ptr->dig_P1);
+  pressure = REAL(1048576.0) - (real_t)adc_P;
   // Avoid exception caused by division by zero.
-  if (v_x1_u32 != 0) pressure = (pressure - (v_x2_u32 / 4096.0)) * 6250.0 / v_x1_u32;
+  if (v_x1_u32 != 0) pressure = (pressure - (v_x2_u32 / REAL(4096.0))) * REAL(6250.0) / v_x1_u32;
   else return 0;
-  v_x1_u32 = ((double)params_ptr->dig_P9) * pressure * pressure / 2147483648.0;
-  v_x2_u32 = pressure * ((double)params_ptr->dig_P8) / 32768.0;
-  pressure = pressure + (v_x1_u32 + v_x2_u32 + ((double)params_ptr->dig_P7)) / 16.0;
+  v_x1_u32 = ((real_t)params_ptr->dig_P9) * pressure * pressure / REAL(2147483648.0);
+  v_x2_u32 = pressure * ((real_t)params_ptr->dig_P8) / REAL(32768.0);
+  pressure = pressure + (v_x1_u32 + v_x2_u32 + ((real_t)params_ptr->dig_P7)) / REAL(16.0);
   
   return pressure;
 }
 
 //Taken straight from the Bosch manual.
-static double compensateHumidity(uint32_t id, int32_t adc_H)
+static real_t compensateHumidity(uint32_t id, int32_t adc_H)
 {
-  double var_h;
+  real_t var_h;
   
   Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
   
-  var_h = (((double)params_ptr->t_fine) - 76800.0);
+  var_h = (((real_t)params_ptr->t_fine) - REAL(76800.0));
   if (var_h != 0)
   {
-    var_h = (adc_H - (((double)params_ptr->dig_H4) * 64.0 + ((double)params_ptr->dig_H5) / 16384.0 * var_h)) * 
-      (((double)params_ptr->dig_H2) / 65536.0 * (1.0 + ((double)params_ptr->dig_H6) / 67108864.0 * 
-      var_h * (1.0 + ((double)params_ptr->dig_H3) / 67108864.0 * var_h)));
+    var_h = (adc_H - (((real_t)params_ptr->dig_H4) * REAL(64.0) + ((real_t)params_ptr->dig_H5) / REAL(16384.0) * var_h)) * 
+      (((real_t)params_ptr->dig_H2) / REAL(65536.0) * (REAL(1.0) + ((real_t)params_ptr->dig_H6) / REAL(67108864.0) * 
+      var_h * (REAL(1.0) + ((real_t)params_ptr->dig_H3) / REAL(67108864.0) * var_h)));
   }
   else return 0;
-  var_h = var_h * (1.0 - ((double)params_ptr->dig_H1)*var_h / 524288.0);
-  if (var_h > 100.0) var_h = 100.0;
-  else if (var_h < 0.0) var_h = 0.0;
+  var_h = var_h * (REAL(1.0) - ((real_t)params_ptr->dig_H1)*var_h / REAL(524288.0));
+  if (var_h > REAL(100.0)) var_h = REAL(100.0);
+  else if (var_h < REAL(0.0)) var_h = REAL(0.0);
   return var_h;
 }
 
-static void bme280_extract_long_data(unsigned char *buffer, BME280_S32_t *data_ptr)
+HOT static void bme280_extract_long_data(unsigned char *buffer, BME280_S32_t *data_ptr)
 {
 	unsigned int data_xlsb = 0;
 	unsigned int data_lsb = 0;
@@ -212,7 +218,7 @@ static void bme280_extract_long_data(unsigned char *buffer, BME280_S32_t *data_p
 }
 
 //Read all the data from the chip
-static Error_Returns bme280_read_data(uint32_t id, BME280_S32_t *adc_T_ptr, BME280_S32_t *adc_P_ptr, BME280_S32_t *adc_H_ptr)
+HOT static Error_Returns bme280_read_data(uint32_t id, BME280_S32_t *adc_T_ptr, BME280_S32_t *adc_P_ptr, BME280_S32_t *adc_H_ptr)
 {
 	Error_Returns to_return = RPi_NotInitialized;
     unsigned int data_lsb = 0;
@@ -248,24 +254,19 @@ static Error_Returns bme280_read_data(uint32_t id, BME280_S32_t *adc_T_ptr, BME2
 	return to_return;
 }
 
-Error_Returns bme280_init(uint32_t id, BME280_mode mode)
-{	
+COLD static Error_Returns bme280_read_chip_id(uint32_t id)
+{
 	Error_Returns to_return = RPi_Success;
-	unsigned char buffer[BME280_TRIM_PARAMETER_BYTES];
-	unsigned int index = 0;
-	
-	Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
+	unsigned char buffer[1] = {0};
 	
 	do
-	{	
+	{
 #ifndef SPI_MODE
 		i2c_init();
 #else
 		spi_init();
 #endif
 		
-		for(index = 0; index < BME280_TRIM_PARAMETER_BYTES; index++) buffer[index] = 0;
-		
 		buffer[0] = BME280_CHIP_RPi_REGISTER;
 		to_return = bme280_read(id, buffer, 1);
 		if (to_return != RPi_Success)
@@ -277,7 +278,21 @@ Error_Returns bme280_init(uint32_t id, BME280_mode mode)
 		{
 			log_string_plus("bme280_init():  Error chip ID read was ", buffer[0]);
 		}
-		
+	} while(0);
+	
+	return to_return;
+}
+
+COLD static Error_Returns bme280_read_trim_parameters(uint32_t id)
+{
+	Error_Returns to_return = RPi_Success;
+	unsigned char buffer[BME280_TRIM_PARAMETER_BYTES];
+	unsigned int index = 0;
+	
+	Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
+	
+	do
+	{
 		for(index = 0; index < BME280_TRIM_PARAMETER_BYTES; index++) buffer[index] = 0;
 		buffer[0] = BME280_FIRST_TRIM_PARAMETER;
 		to_return = bme280_read(id, buffer, BME280_TRIM_PARAMETER_BYTES);
@@ -334,7 +349,18 @@ Error_Returns bme280_init(uint32_t id, BME280_mode mode)
 		params_ptr->dig_H5 = (buffer[index++] >> 4) & 0x0F;
 		params_ptr->dig_H5 |= buffer[index++]<<4;
 		params_ptr->dig_H6 = buffer[index++] & 0xFF;
-		
+	} while(0);
+	
+	return to_return;
+}
+
+COLD static Error_Returns bme280_configure(uint32_t id, BME280_mode mode)
+{
+	Error_Returns to_return = RPi_Success;
+	unsigned char buffer[BME280_CTRL_REGISTER_WRITE_SIZE];
+	
+	do
+	{
 		switch(mode)
 		{
 			case bme280_temp_pressure_humidity:
@@ -426,12 +452,50 @@ Error_Returns bme280_init(uint32_t id, BME280_mode mode)
 				break;
 			}
 		}
-		spin_wait(TIME_DELAY); 				 
 	} while(0);
 	
 	return to_return;
 }
 
+/*  Bring up one BME280 a step at a time.  Each step is one short bus
+	transaction, the settle time after the device is configured is a delay
+	the caller can spend on something else.  Threads for different ids can be
+	run side by side.
+*/
+
+COLD ProtothreadStatus bme280_init_pt(Protothread *pt, uint32_t id, BME280_mode mode, Error_Returns *status_ptr)
+{
+	PT_BEGIN(pt);
+	
+	*status_ptr = bme280_read_chip_id(id);
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	PT_YIELD(pt);
+	
+	*status_ptr = bme280_read_trim_parameters(id);
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	PT_YIELD(pt);
+	
+	*status_ptr = bme280_configure(id, mode);
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	PT_DELAY_MS(pt, BME280_SETTLE_DELAY);
+	
+	PT_END(pt);
+}
+
+COLD Error_Returns bme280_init(uint32_t id, BME280_mode mode)
+{	
+	Error_Returns to_return = RPi_Success;
+	Protothread init_thread;
+	
+	PT_INIT(&init_thread);
+	while (PT_RUNNING(bme280_init_pt(&init_thread, id, mode, &to_return)))
+	{
+		protothread_sleep(&init_thread);
+	}
+	
+	return to_return;
+}
+
 Error_Returns bme280_reset(uint32_t id)
 {
 	Error_Returns to_return = RPi_NotInitialized;
@@ -441,12 +505,12 @@ Error_Returns bme280_reset(uint32_t id)
 	if (bme280_ready)
 	{
 		to_return = bme280_write(id, buffer, BME280_CTRL_REGISTER_WRITE_SIZE);
-		spin_wait(TIME_DELAY);  //Delay to allow reset
+		timer_delay_ms(BME280_SETTLE_DELAY);  //Delay to allow reset
 	}
 	return to_return;
 }
 
-Error_Returns bme280_print_compensated_values(uint32_t id)
+COLD Error_Returns bme280_print_compensated_values(uint32_t id)
 {
 	Error_Returns to_return = RPi_Success;
 	BME280_S32_t adc_P = 0;
@@ -466,7 +530,7 @@ Error_Returns bme280_print_compensated_values(uint32_t id)
 	return to_return;
 }
 
-Error_Returns bme280_get_current_temperature_pressure(uint32_t id, double *temperature_ptr, double *pressure_ptr)
+HOT Error_Returns bme280_get_current_temperature_pressure(uint32_t id, real_t *temperature_ptr, real_t *pressure_ptr)
 {
 	Error_Returns to_return = RPi_Success;
 	BME280_S32_t adc_P = 0;
@@ -483,7 +547,7 @@ Error_Returns bme280_get_current_temperature_pressure(uint32_t id, double *tempe
 	return to_return;
 }
 
-Error_Returns bme280_get_current_temperature(uint32_t id, double *temperature_ptr)
+Error_Returns bme280_get_current_temperature(uint32_t id, real_t *temperature_ptr)
 {
 	Error_Returns to_return = RPi_Success;
 	BME280_S32_t adc_P = 0;
@@ -499,7 +563,7 @@ Error_Returns bme280_get_current_temperature(uint32_t id, double *temperature_pt
 	return to_return;
 }
 
-Error_Returns bme280_get_current_pressure(uint32_t id, double *pressure_ptr)
+HOT Error_Returns bme280_get_current_pressure(uint32_t id, real_t *pressure_ptr)
 {
 	Error_Returns to_return = RPi_Success;
 	BME280_S32_t adc_P = 0;
@@ -515,3 +579,12 @@ Error_Returns bme280_get_current_pressure(uint32_t id, double *pressure_ptr)
 	}  while(0);
 	return to_return;
 }
+
+/*  The height in meters of current_pressure above base_pressure, from the
+	barometric formula in the Bosch BMP180 datasheet.
+*/
+
+HOT real_t bme280_pressure_to_altitude(real_t base_pressure, real_t current_pressure)
+{
+	return BAROMETRIC_MULTIPLIER * (1 - REAL_POW((current_pressure / base_pressure), BAROMETRIC_EXPONENT));
+}
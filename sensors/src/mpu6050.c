@@ -30,8 +30,11 @@ Implements support for the InvenSense MPU 6050 three axis gyro and accelerometer
 #include "i2c.h"
 #include "gpio.h"
 #include "arm_timer.h"
-#include "interrupt_handler.h"
 #include "aux_peripherals.h"
+#include "work_queue.h"
+#include "protothread.h"
+#include "allocator.h"
+#include "mem_ops.h"
 #include "log.h"
 
 #define INV_X_GYRO      (0x40)
@@ -54,6 +57,7 @@ Implements support for the InvenSense MPU 6050 three axis gyro and accelerometer
                                      DMP_FEATURE_SEND_CAL_GYRO)
 
 #define QUAT_BUFFER_SIZE 5
+#define MPU_FIFO_DRAIN_SIZE 256
 
 #define MPU_I2C_SLAVE_ADDRESS 0x68
 #define MPU6050_WHO_AM_I_VALUE 0x68
@@ -563,7 +567,7 @@ enum clock_sel_e {
     NUM_CLK
 };
 
-static const unsigned char dmp_memory[DMP_CODE_SIZE] = {
+static const unsigned char dmp_memory[DMP_CODE_SIZE] FIRMWARE = {
     /* bank # 0 */
     0x00, 0x00, 0x70, 0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x02, 0x00, 0x03, 0x00, 0x00,
     0x00, 0x65, 0x00, 0x54, 0xff, 0xef, 0x00, 0x00, 0xfa, 0x80, 0x00, 0x0b, 0x12, 0x82, 0x00, 0x01,
@@ -772,18 +776,26 @@ static const unsigned char dmp_memory[DMP_CODE_SIZE] = {
 };
 
 
-static int32_t interrupt_handler_index;
-
 static volatile int16_t packet_write_index = 0;
 
 static volatile int16_t packet_read_index = 0;
 
 static volatile unsigned char quat_buffer_overflow = 0;
 
-static MPU6050_Accel_Gyro_Values quat_values[QUAT_BUFFER_SIZE];
+//Taken from the arena on the first mpu6050_init so they cost nothing without an MPU
+static MPU6050_Accel_Gyro_Values *quat_values = NULL_PTR;
+
+static unsigned char *fifo_buffer = NULL_PTR;
+
+static Work_Item fifo_drain_work;
 
 static uint32_t mpu6050_initialized = 0;
 
+//Bring up thread state, only one bring up can be in progress at a time
+static Protothread mpu_child_thread;
+static unsigned short firmware_offset = 0;
+static unsigned short firmware_chunk = 0;
+
 unsigned char packet_length;
 
 static Error_Returns mpu6050_write(unsigned char *buffer, unsigned int tx_bytes)
@@ -793,7 +805,7 @@ static Error_Returns mpu6050_write(unsigned char *buffer, unsigned int tx_bytes)
 	return to_return;
 }
 
-static Error_Returns mpu6050_read(unsigned char *buffer, unsigned int rx_bytes)
+HOT static Error_Returns mpu6050_read(unsigned char *buffer, unsigned int rx_bytes)
 {
 	Error_Returns to_return = RPi_Success;
 	to_return = i2c_write(MPU_I2C_SLAVE_ADDRESS, buffer, 1);
@@ -830,10 +842,7 @@ static Error_Returns mpu6050_write_mem(unsigned short mem_addr, unsigned short l
 		}
 		
 		tmp[0] = DMP_MEM_READ_WRITE_REG;
-		for(uint32_t index = 1; index < length + 1; index++)
-		{
-			tmp[index] = data[index - 1];
-		}
+		memcpy(&tmp[1], data, length);
 		to_return = i2c_write(MPU_I2C_SLAVE_ADDRESS, tmp, length + 1);
 		if (to_return != RPi_Success)
 		{
@@ -885,7 +894,7 @@ static Error_Returns mpu6050_read_mem(unsigned short mem_addr, unsigned short le
     return to_return;
 }
 
-static unsigned short mpu6050_mem_cmp(const unsigned char *original_ptr, unsigned char *buffer_ptr, unsigned short length)
+COLD static unsigned short mpu6050_mem_cmp(const unsigned char *original_ptr, unsigned char *buffer_ptr, unsigned short length)
 {
 	unsigned short to_return = 0;
 	for(unsigned short index = 0; index < length; index++)
@@ -907,52 +916,60 @@ static unsigned short mpu6050_mem_cmp(const unsigned char *original_ptr, unsigne
 	return to_return;
 }
 
-static Error_Returns dmp_load_firmware()
+/*  Write one chunk of the DMP image at offset and read it back to verify it,
+	the size written is returned through length_ptr.
+*/
+
+COLD static Error_Returns dmp_load_firmware_chunk(unsigned short offset, unsigned short *length_ptr)
 {
 	Error_Returns to_return = RPi_Success;
-    unsigned short ii;
-    unsigned short this_write = 0;
-    unsigned char read_buffer[DMP_LOAD_CHUNK];
-	unsigned char write_buffer[DMP_WRITE_BUFFER_SIZE];
+	unsigned char read_buffer[DMP_LOAD_CHUNK];
+	unsigned short this_write = (DMP_LOAD_CHUNK < (DMP_CODE_SIZE - offset)) ? DMP_LOAD_CHUNK : DMP_CODE_SIZE - offset;
 
-    do
+	do
 	{
-		for (ii = 0; ii < DMP_CODE_SIZE; ii += this_write) {
-        this_write = (DMP_LOAD_CHUNK < (DMP_CODE_SIZE - ii)) ? DMP_LOAD_CHUNK : DMP_CODE_SIZE - ii;
-		to_return = mpu6050_write_mem(ii, this_write, (unsigned char*)&dmp_memory[ii]);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("mpu_load_firmware: failed to write DMP memory, offset: ", 
-				(uint32_t)ii);
-				break;
-			}
-			to_return = mpu6050_read_mem(ii, this_write, read_buffer);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("mpu_load_firmware: failed to read DMP memory, offset: ", 
-				(uint32_t)ii);
-				break;
-			}
-			if (mpu6050_mem_cmp(&dmp_memory[ii], read_buffer, this_write))
-			{
-				log_string_plus("mpu_load_firmware: DMP memory cmp failed, offset: ", 
-				(uint32_t)ii);
-				break;
-			}
+		*length_ptr = this_write;
+		to_return = mpu6050_write_mem(offset, this_write, (unsigned char*)&dmp_memory[offset]);
+		if (to_return != RPi_Success)
+		{
+			log_string_plus("mpu_load_firmware: failed to write DMP memory, offset: ", 
+			(uint32_t)offset);
+			break;
 		}
-
-		/* Set program start address. */
-		write_buffer[0] = DMP_PROGRAM_START_REG;
-		write_buffer[1] = (unsigned char)(DMP_START_ADDRESS >> 8);
-		write_buffer[2] = (unsigned char)(DMP_START_ADDRESS & 0xFF);
-		to_return = mpu6050_write(write_buffer, DMP_WRITE_BUFFER_SIZE);
+		to_return = mpu6050_read_mem(offset, this_write, read_buffer);
 		if (to_return != RPi_Success)
 		{
-			log_string("mpu_load_firmware: failed to write start DMP: ");
+			log_string_plus("mpu_load_firmware: failed to read DMP memory, offset: ", 
+			(uint32_t)offset);
+			break;
+		}
+		if (mpu6050_mem_cmp(&dmp_memory[offset], read_buffer, this_write))
+		{
+			log_string_plus("mpu_load_firmware: DMP memory cmp failed, offset: ", 
+			(uint32_t)offset);
+			to_return = RPi_OperationFailed;
 		}
 	} while(0);
 
-    return to_return;
+	return to_return;
+}
+
+COLD static Error_Returns dmp_set_program_start(void)
+{
+	Error_Returns to_return = RPi_Success;
+	unsigned char write_buffer[DMP_WRITE_BUFFER_SIZE];
+
+	/* Set program start address. */
+	write_buffer[0] = DMP_PROGRAM_START_REG;
+	write_buffer[1] = (unsigned char)(DMP_START_ADDRESS >> 8);
+	write_buffer[2] = (unsigned char)(DMP_START_ADDRESS & 0xFF);
+	to_return = mpu6050_write(write_buffer, DMP_WRITE_BUFFER_SIZE);
+	if (to_return != RPi_Success)
+	{
+		log_string("mpu_load_firmware: failed to write start DMP: ");
+	}
+
+	return to_return;
 }
 
 Error_Returns dmp_enable_gyro_cal(unsigned char enable)
@@ -968,11 +985,16 @@ Error_Returns dmp_enable_gyro_cal(unsigned char enable)
 	return to_return;
 }
 
-static Error_Returns mpu_reset_fifo(unsigned char dmp_on)
+/*  Reset the FIFO, and the DMP with it when dmp_on is set.  The buffer is set
+	up again after each delay as locals don't survive a wait.
+*/
+
+static ProtothreadStatus mpu_reset_fifo_pt(Protothread *pt, unsigned char dmp_on, Error_Returns *status_ptr)
 {
 	Error_Returns to_return = RPi_Success;
     unsigned char buffer[2];
 
+	PT_BEGIN(pt);
 	do
 	{
 		buffer[0] = MPU_INTERRUPT_ENABLE_REG;
@@ -1008,7 +1030,8 @@ static Error_Returns mpu_reset_fifo(unsigned char dmp_on)
 				log_string_plus("mpu_reset_fifo:  Error resetting DMP ", to_return);
 				break;
 			}
-			spin_wait_milliseconds(500);
+			PT_DELAY_MS(pt, 500);
+			buffer[0] = MPU_USER_CONTROL_REG;
 			buffer[1] = BIT_DMP_EN | BIT_FIFO_EN;
 
 			to_return = mpu6050_write(buffer, 2);
@@ -1051,7 +1074,7 @@ static Error_Returns mpu_reset_fifo(unsigned char dmp_on)
 				log_string_plus("mpu_reset_fifo:  FIFO enable ", to_return);
 				break;
 			}
-			spin_wait_milliseconds(50);
+			PT_DELAY_MS(pt, 50);
 			buffer[0] = MPU_INTERRUPT_ENABLE_REG;
 			buffer[1] = 0x02; //BIT_DATA_RDY_EN;
 			to_return = mpu6050_write(buffer, 2);
@@ -1070,7 +1093,21 @@ static Error_Returns mpu_reset_fifo(unsigned char dmp_on)
 		}
 
 	} while(0);
-    return to_return;
+	*status_ptr = to_return;
+	PT_END(pt);
+}
+
+static Error_Returns mpu_reset_fifo(unsigned char dmp_on)
+{
+	Error_Returns to_return = RPi_Success;
+	Protothread fifo_thread;
+
+	PT_INIT(&fifo_thread);
+	while (PT_RUNNING(mpu_reset_fifo_pt(&fifo_thread, dmp_on, &to_return)))
+	{
+		protothread_sleep(&fifo_thread);
+	}
+	return to_return;
 }
 
 static Error_Returns dmp_enable_6x_lp_quat(unsigned char enable)
@@ -1311,78 +1348,99 @@ int dmp_set_fifo_rate(unsigned short rate)
     return 0;
 }
 
-InterruptHandlerStatus mpu6050_interrupt_handler(void)
+/*  Bottom half of the MPU interrupt, run from the work queue.  Reading the
+	interrupt status register clears the latched MPU interrupt line, once that
+	is done high level detection on the GPIO pin can be turned back on.
+*/
+
+HOT static void mpu6050_fifo_drain(uint32_t argument)
 {
-	unsigned char buffer[256];
-	InterruptHandlerStatus to_return = Interrupt_Not_Claimed;
-	if (gpio_get_event_detect_status(MPU_INTERRUPT_GPIO_PIN) == event_detected)
+	do
 	{
-		do
+		//Clear MPU, DMP interrupt
+		uint16_t fifo_count = 0;
+		fifo_buffer[0] = MPU_INTERRUPT_STATUS_REG;
+		mpu6050_read(fifo_buffer, 1);
+		
+		if (fifo_buffer[0] & 0x10)
 		{
-			//Clear MPU, DMP interrupt, then clear event status
-			uint16_t fifo_count = 0;
-			buffer[0] = MPU_INTERRUPT_STATUS_REG;
-			mpu6050_read(buffer, 1);
-			
-			if (buffer[0] & 0x10)
-			{
-				quat_buffer_overflow = 1;
-				log_interrupt_string_plus("MPU FIFO overflow status: ", (uint32_t) buffer[0]);
-			}
+			quat_buffer_overflow = 1;
+			log_string_plus("MPU FIFO overflow status: ", (uint32_t) fifo_buffer[0]);
+		}
 
-			buffer[0] = DMP_INTERRUPT_STATUS_REG;
-			mpu6050_read(buffer, 1);
+		fifo_buffer[0] = DMP_INTERRUPT_STATUS_REG;
+		mpu6050_read(fifo_buffer, 1);
 
-			gpio_clear_event_detect_status(MPU_INTERRUPT_GPIO_PIN);
-			if (!(buffer[0] & 0x01))
-			{
-				log_interrupt_string_plus("DMP didn't have FIFO data, status: ", (uint32_t) buffer[0]);				
-				break;
-			}
+		if (!(fifo_buffer[0] & 0x01))
+		{
+			log_string_plus("DMP didn't have FIFO data, status: ", (uint32_t) fifo_buffer[0]);				
+			break;
+		}
 
-			buffer[0] = MPU_FIFO_COUNT_H_REG;
-			mpu6050_read(buffer, 2);	
-			fifo_count = ((uint16_t) buffer[0]) << 8;
-			fifo_count |= ((uint16_t) buffer[1]) & 0xFF;
+		fifo_buffer[0] = MPU_FIFO_COUNT_H_REG;
+		mpu6050_read(fifo_buffer, 2);	
+		fifo_count = ((uint16_t) fifo_buffer[0]) << 8;
+		fifo_count |= ((uint16_t) fifo_buffer[1]) & 0xFF;
+		if (fifo_count > MPU_FIFO_DRAIN_SIZE)
+		{
+			fifo_count = MPU_FIFO_DRAIN_SIZE;
+		}
 
-			buffer[0] = MPU_FIFO_READ_WRITE_REG;
-			mpu6050_read(buffer, (uint32_t)fifo_count);
-			
+		fifo_buffer[0] = MPU_FIFO_READ_WRITE_REG;
+		mpu6050_read(fifo_buffer, (uint32_t)fifo_count);
+		
 
-			quat_values[packet_write_index].quat_w = ((long)buffer[0] << 24) | 
-				((long)buffer[1] << 16) | ((long)buffer[2] << 8) | buffer[3];
-			quat_values[packet_write_index].quat_x = ((long)buffer[4] << 24) | 
-				((long)buffer[5] << 16) | ((long)buffer[6] << 8) | buffer[7];
-			quat_values[packet_write_index].quat_y = ((long)buffer[8] << 24) | 
-				((long)buffer[9] << 16) | ((long)buffer[10] << 8) | buffer[11];
-			quat_values[packet_write_index].quat_z = ((long)buffer[12] << 24) | 
-				((long)buffer[13] << 16) | ((long)buffer[14] << 8) | buffer[15];
-				
-			//Currently I don't see any reason to keep the accelerometer and gyro data around
-/*  
-			uint32_t index = 16;
-			quat_values[packet_write_index].accel_x = ((int16_t)buffer[index++]) << 8;
-			quat_values[packet_write_index].accel_x = ((int16_t)buffer[index++]) & 0xFF;
-			quat_values[packet_write_index].accel_y = ((int16_t)buffer[index++]) << 8;
-			quat_values[packet_write_index].accel_y = ((int16_t)buffer[index++]) & 0xFF;
-			quat_values[packet_write_index].accel_z = ((int16_t)buffer[index++]) << 8;
-			quat_values[packet_write_index].accel_z = ((int16_t)buffer[index++]) & 0xFF;
+		quat_values[packet_write_index].quat_w = ((long)fifo_buffer[0] << 24) | 
+			((long)fifo_buffer[1] << 16) | ((long)fifo_buffer[2] << 8) | fifo_buffer[3];
+		quat_values[packet_write_index].quat_x = ((long)fifo_buffer[4] << 24) | 
+			((long)fifo_buffer[5] << 16) | ((long)fifo_buffer[6] << 8) | fifo_buffer[7];
+		quat_values[packet_write_index].quat_y = ((long)fifo_buffer[8] << 24) | 
+			((long)fifo_buffer[9] << 16) | ((long)fifo_buffer[10] << 8) | fifo_buffer[11];
+		quat_values[packet_write_index].quat_z = ((long)fifo_buffer[12] << 24) | 
+			((long)fifo_buffer[13] << 16) | ((long)fifo_buffer[14] << 8) | fifo_buffer[15];
 			
-			quat_values[packet_write_index].gyro_x = ((int16_t)buffer[index++]) << 8;
-			quat_values[packet_write_index].gyro_x = ((int16_t)buffer[index++]) & 0xFF;
-			quat_values[packet_write_index].gyro_y = ((int16_t)buffer[index++]) << 8;
-			quat_values[packet_write_index].gyro_y = ((int16_t)buffer[index++]) & 0xFF;
-			quat_values[packet_write_index].gyro_z = ((int16_t)buffer[index++]) << 8;
-			quat_values[packet_write_index].gyro_z = ((int16_t)buffer[index]) & 0xFF;
+		//Currently I don't see any reason to keep the accelerometer and gyro data around
+/*  
+		uint32_t index = 16;
+		quat_values[packet_write_index].accel_x = ((int16_t)fifo_buffer[index++]) << 8;
+		quat_values[packet_write_index].accel_x = ((int16_t)fifo_buffer[index++]) & 0xFF;
+		quat_values[packet_write_index].accel_y = ((int16_t)fifo_buffer[index++]) << 8;
+		quat_values[packet_write_index].accel_y = ((int16_t)fifo_buffer[index++]) & 0xFF;
+		quat_values[packet_write_index].accel_z = ((int16_t)fifo_buffer[index++]) << 8;
+		quat_values[packet_write_index].accel_z = ((int16_t)fifo_buffer[index++]) & 0xFF;
+		
+		quat_values[packet_write_index].gyro_x = ((int16_t)fifo_buffer[index++]) << 8;
+		quat_values[packet_write_index].gyro_x = ((int16_t)fifo_buffer[index++]) & 0xFF;
+		quat_values[packet_write_index].gyro_y = ((int16_t)fifo_buffer[index++]) << 8;
+		quat_values[packet_write_index].gyro_y = ((int16_t)fifo_buffer[index++]) & 0xFF;
+		quat_values[packet_write_index].gyro_z = ((int16_t)fifo_buffer[index++]) << 8;
+		quat_values[packet_write_index].gyro_z = ((int16_t)fifo_buffer[index]) & 0xFF;
 */
-			
-			packet_write_index++;			
-			packet_write_index = packet_write_index % QUAT_BUFFER_SIZE;
-			quat_buffer_overflow = (packet_write_index == packet_read_index) ? 1 : 0 | quat_buffer_overflow;
-			to_return = Interrupt_Claimed;
-		} while(0);
+		
+		packet_write_index++;			
+		packet_write_index = packet_write_index % QUAT_BUFFER_SIZE;
+		quat_buffer_overflow = (packet_write_index == packet_read_index) ? 1 : 0 | quat_buffer_overflow;
+	} while(0);
+
+	gpio_set_high_detect_pin(MPU_INTERRUPT_GPIO_PIN);
+}
+
+/*  Top half of the MPU interrupt, called by the GPIO event demultiplexer.  The
+	MPU holds its interrupt line high until the status register is read over I2C,
+	so turn off high level detection for the pin and clear the event it latched
+	again since the demultiplexer cleared it (otherwise we would be interrupted
+	again straight away) and leave the bus traffic to mpu6050_fifo_drain.
+*/
+
+HOT static void mpu6050_interrupt_handler(GPIO_Pins pin, uint32_t timestamp)
+{
+	gpio_clear_high_detect_pin(pin);
+	gpio_clear_event_detect_status(pin);
+	if (work_queue_post(&fifo_drain_work) != RPi_Success)
+	{
+		log_interrupt_string("mpu6050_interrupt_handler: failed to queue FIFO drain");
+		gpio_set_high_detect_pin(pin);
 	}
-	return to_return;
 }
 int mpu_set_sensors(unsigned char sensors)
 {
@@ -1417,7 +1475,7 @@ int mpu_set_sensors(unsigned char sensors)
         /* Latched interrupts only used in LP accel mode. */
 //        mpu_set_int_latched(0);
 		
-    spin_wait_milliseconds(50);
+    //The caller has to allow 50 ms for the sensors to come up
     return 0;
 }
 
@@ -1468,7 +1526,7 @@ int mpu_set_sample_rate(unsigned short rate)
 	return 0;
 }
 
-int dmp_enable_feature(unsigned short mask)
+static void dmp_write_features(unsigned short mask)
 {
     unsigned char tmp[10];
 
@@ -1563,8 +1621,6 @@ int dmp_enable_feature(unsigned short mask)
     else
         dmp_enable_6x_lp_quat(0);
 
-    mpu_reset_fifo(1);
-
     packet_length = 0;
     if (mask & DMP_FEATURE_SEND_RAW_ACCEL)
         packet_length += 6;
@@ -1574,8 +1630,13 @@ int dmp_enable_feature(unsigned short mask)
         packet_length += 16;
     if (mask & (DMP_FEATURE_TAP | DMP_FEATURE_ANDROID_ORIENT))
         packet_length += 4;
+}
 
-    return 0;
+int dmp_enable_feature(unsigned short mask)
+{
+	dmp_write_features(mask);
+	mpu_reset_fifo(1);
+	return 0;
 }
 
 int mpu_set_bypass(unsigned char bypass_on)
@@ -1587,7 +1648,7 @@ int mpu_set_bypass(unsigned char bypass_on)
         mpu6050_read(tmp, 2);
         tmp[1] &= ~BIT_AUX_IF_EN;
         mpu6050_write(tmp, 2);
-        spin_wait_milliseconds(3);
+        timer_delay_ms(3);
 		tmp[0] = MPU_INTERRUPT_CONFIG_REG;
         tmp[1] = BIT_BYPASS_EN;
         mpu6050_write(tmp, 2);
@@ -1625,184 +1686,269 @@ int mpu_set_dmp_state(unsigned char enable)
     return 0;
 }
 
-Error_Returns mpu6050_init()
-{	
+/*  Everything up to the device reset:  the bus, the FIFO work item, a check of
+	the chip ID and the interrupt pin.
+*/
+
+COLD static Error_Returns mpu6050_setup(void)
+{
 	Error_Returns to_return = RPi_Success;
 	unsigned char buffer[2];
-	interrupt_handler_index = -1;
-	if (!mpu6050_initialized)
+	do
 	{
-		do
-		{	
-			packet_write_index = 0;
-			packet_read_index = 0;
-			quat_buffer_overflow = 0;
-			to_return = i2c_init();
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Error initializing I2C bus ", to_return);
-				break;  //No need to continue just return the failure
-			}
-		
-			buffer[0] = MPU6050_WHO_AM_I_REG;
-			to_return = mpu6050_read(buffer, 1);
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Error reading chip ID read was ", to_return);
-				break;  //No need to continue just return the failure
-			}
-			if (buffer[0] != MPU6050_WHO_AM_I_VALUE)
-			{
-				log_string_plus("mpu6050_init():  Error chip ID read was ", buffer[0]);
-			}
-			
-			/* 	Configure the GPIO pin as an input for the MPU interrupt with no PUPD.
-				The interrupt pin on the MPU will be set as push-pull, active high,
-				latched and only cleared when the interrupt status register is read.
-			*/
-			
-			to_return = gpio_init();
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Error initializing GPIO ", to_return);
-				break;  //No need to continue just return the failure
-			}
-			to_return = gpio_set_function_select(MPU_INTERRUPT_GPIO_PIN, gpio_input);
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Error selecting interrupt pin ", to_return);
-				break;  //No need to continue just return the failure
-			}
-			gpio_set_pullup_pulldown(MPU_INTERRUPT_GPIO_PIN, pupd_disable);
-			to_return = gpio_set_high_detect_pin(MPU_INTERRUPT_GPIO_PIN);
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Error setting high detect pin ", to_return);
-				break;  //No need to continue just return the failure
-			}
-			interrupt_handler_index = interrupt_handler_add(mpu6050_interrupt_handler, Int_GPIO_Pin, MPU_INTERRUPT_GPIO_PIN);
-			if (interrupt_handler_index < 0)
-			{
-				log_string("mpu6050_init:  failed to add interrupt handler");
-				to_return = RPi_OperationFailed;
-				break;
-			}
-			
-			to_return = mpu6050_reset();
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Reset device failed ", to_return);
-				break;  //No need to continue just return the failure
-			}
-			
-			buffer[0] = MPU_INTERRUPT_CONFIG_REG;
-			buffer[1] = (1 << MPU6050_INTERRUPT_LATCH);
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_reset():  Error setting MPU_INTERRUPT_CONFIG_REG ", to_return);
-				break;  //No need to continue just return the failure
-			}
+		packet_write_index = 0;
+		packet_read_index = 0;
+		quat_buffer_overflow = 0;
+		//The arena has no free, a retry only takes the buffer that is still missing
+		if (quat_values == NULL_PTR)
+		{
+			quat_values = arena_alloc(sizeof(MPU6050_Accel_Gyro_Values) * QUAT_BUFFER_SIZE, ARENA_DEFAULT_ALIGNMENT);
+		}
+		if (fifo_buffer == NULL_PTR)
+		{
+			fifo_buffer = arena_alloc(MPU_FIFO_DRAIN_SIZE, ARENA_DEFAULT_ALIGNMENT);
+		}
+		if ((quat_values == NULL_PTR) || (fifo_buffer == NULL_PTR))
+		{
+			log_string("mpu6050_init():  No memory for the FIFO buffers");
+			to_return = RPi_InsufficientResources;
+			break;
+		}
+		to_return = i2c_init();
+		if (to_return != RPi_Success) 
+		{
+			log_string_plus("mpu6050_init():  Error initializing I2C bus ", to_return);
+			break;  //No need to continue just return the failure
+		}
 
-			mpu_set_sensors(INV_XYZ_GYRO | INV_XYZ_ACCEL);
-			mpu_configure_fifo(INV_XYZ_GYRO | INV_XYZ_ACCEL);
-			mpu_set_sample_rate(DEFAULT_MPU_HZ);
-			
-			to_return = mpu_set_gyro_fsr(2000);
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Failed to set gyro full scale ", to_return);
-				break;  //No need to continue just return the failure
-			}			
-			to_return = mpu_set_accel_fsr(2);
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Failed to set accel full scale ", to_return);
-				break;  //No need to continue just return the failure
-			}	
-			to_return = mpu_set_lpf(42);
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Failed to set LPF ", to_return);
-				break;  //No need to continue just return the failure
-			}
-			
-			to_return = dmp_load_firmware();
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Failed to load DMP firmware ", to_return);
-				break;  //No need to continue just return the failure
-			}
-			
-			dmp_set_orientation(4);
-			/*unsigned short dmp_features = 
-				DMP_FEATURE_6X_LP_QUAT | 
-				DMP_FEATURE_TAP |
-				DMP_FEATURE_ANDROID_ORIENT | 
-				DMP_FEATURE_SEND_RAW_ACCEL | 
-				DMP_FEATURE_SEND_CAL_GYRO |
-				DMP_FEATURE_GYRO_CAL;
-				*/
-			unsigned short dmp_features = 
-				DMP_FEATURE_6X_LP_QUAT | 
-				DMP_FEATURE_TAP |
-				//DMP_FEATURE_ANDROID_ORIENT | 
-				DMP_FEATURE_SEND_RAW_ACCEL | 
-				DMP_FEATURE_SEND_CAL_GYRO |
-				DMP_FEATURE_GYRO_CAL;
-			dmp_enable_feature(dmp_features);
-			//dmp_enable_features();	
-			dmp_set_fifo_rate(DEFAULT_MPU_HZ);			
-			mpu_set_dmp_state(1);
-/*			to_return = dmp_set_interrupt_mode();
-			if (to_return != RPi_Success) 
-			{
-				log_string_plus("mpu6050_init():  Failed enable enable dmp interrupts ", to_return);
-				break;  //No need to continue just return the failure
-			}	
-*/			
-			mpu6050_initialized = 1;
-		} while(0);
-	}
+		work_queue_init();
+		to_return = work_queue_init_item(&fifo_drain_work, mpu6050_fifo_drain, 0, Work_Priority_High);
+		if (to_return != RPi_Success) 
+		{
+			log_string_plus("mpu6050_init():  Error setting up FIFO work item ", to_return);
+			break;  //No need to continue just return the failure
+		}
+	
+		buffer[0] = MPU6050_WHO_AM_I_REG;
+		to_return = mpu6050_read(buffer, 1);
+		if (to_return != RPi_Success) 
+		{
+			log_string_plus("mpu6050_init():  Error reading chip ID read was ", to_return);
+			break;  //No need to continue just return the failure
+		}
+		if (buffer[0] != MPU6050_WHO_AM_I_VALUE)
+		{
+			log_string_plus("mpu6050_init():  Error chip ID read was ", buffer[0]);
+		}
+		
+		/* 	Configure the GPIO pin as an input for the MPU interrupt with no PUPD.
+			The interrupt pin on the MPU will be set as push-pull, active high,
+			latched and only cleared when the interrupt status register is read.
+		*/
+		
+		to_return = gpio_init();
+		if (to_return != RPi_Success) 
+		{
+			log_string_plus("mpu6050_init():  Error initializing GPIO ", to_return);
+			break;  //No need to continue just return the failure
+		}
+		to_return = gpio_set_function_select(MPU_INTERRUPT_GPIO_PIN, gpio_input);
+		if (to_return != RPi_Success) 
+		{
+			log_string_plus("mpu6050_init():  Error selecting interrupt pin ", to_return);
+			break;  //No need to continue just return the failure
+		}
+		gpio_set_pullup_pulldown(MPU_INTERRUPT_GPIO_PIN, pupd_disable);
+		to_return = gpio_set_high_detect_pin(MPU_INTERRUPT_GPIO_PIN);
+		if (to_return != RPi_Success) 
+		{
+			log_string_plus("mpu6050_init():  Error setting high detect pin ", to_return);
+			break;  //No need to continue just return the failure
+		}
+		to_return = gpio_register_event_callback(MPU_INTERRUPT_GPIO_PIN, mpu6050_interrupt_handler);
+		if (to_return != RPi_Success)
+		{
+			log_string_plus("mpu6050_init:  failed to add interrupt handler ", to_return);
+			break;
+		}
+	} while(0);
 	return to_return;
 }
 
-Error_Returns mpu6050_reset()
+COLD static Error_Returns mpu6050_configure(void)
 {
 	Error_Returns to_return = RPi_Success;
-	unsigned char buffer[2];
 	do
-	{	
-		i2c_init();
+	{
+		mpu_configure_fifo(INV_XYZ_GYRO | INV_XYZ_ACCEL);
+		mpu_set_sample_rate(DEFAULT_MPU_HZ);
 		
-		/* Reset the MPU all registers will be 0
-		   except the MPU6050_WHO_AM_I_REG and MPU_POWER_MGMT_1_REG.
-		   The device will be in sleep mode 
-		*/
-		buffer[0] = MPU_POWER_MGMT_1_REG;
-		buffer[1] = (1 << MPU6050_RESET_DEVICE);
-		to_return = mpu6050_write(buffer, 2);
+		to_return = mpu_set_gyro_fsr(2000);
 		if (to_return != RPi_Success) 
 		{
-			log_string_plus("mpu6050_reset():  Error resetting device ", to_return);
+			log_string_plus("mpu6050_init():  Failed to set gyro full scale ", to_return);
 			break;  //No need to continue just return the failure
-		}
-		
-		spin_wait_milliseconds(100);
-		
-		buffer[1] = MPU6050_AWAKE;
-		to_return = mpu6050_write(buffer, 2);
+		}			
+		to_return = mpu_set_accel_fsr(2);
+		if (to_return != RPi_Success) 
+		{
+			log_string_plus("mpu6050_init():  Failed to set accel full scale ", to_return);
+			break;  //No need to continue just return the failure
+		}	
+		to_return = mpu_set_lpf(42);
 		if (to_return != RPi_Success) 
 		{
-			log_string_plus("mpu6050_reset():  Error waking device up ", to_return);
+			log_string_plus("mpu6050_init():  Failed to set LPF ", to_return);
 			break;  //No need to continue just return the failure
 		}
-		spin_wait_milliseconds(100);		
 	} while(0);
-		
 	return to_return;
 }
 
-Error_Returns mpu6050_retrieve_values(MPU6050_Accel_Gyro_Values *values)
+COLD static ProtothreadStatus mpu6050_reset_pt(Protothread *pt, Error_Returns *status_ptr)
+{
+	unsigned char buffer[2];
+
+	PT_BEGIN(pt);
+	i2c_init();
+	
+	/* Reset the MPU all registers will be 0
+	   except the MPU6050_WHO_AM_I_REG and MPU_POWER_MGMT_1_REG.
+	   The device will be in sleep mode 
+	*/
+	buffer[0] = MPU_POWER_MGMT_1_REG;
+	buffer[1] = (1 << MPU6050_RESET_DEVICE);
+	*status_ptr = mpu6050_write(buffer, 2);
+	if (*status_ptr != RPi_Success) 
+	{
+		log_string_plus("mpu6050_reset():  Error resetting device ", *status_ptr);
+		PT_EXIT(pt);  //No need to continue just return the failure
+	}
+	
+	PT_DELAY_MS(pt, 100);
+	
+	buffer[0] = MPU_POWER_MGMT_1_REG;
+	buffer[1] = MPU6050_AWAKE;
+	*status_ptr = mpu6050_write(buffer, 2);
+	if (*status_ptr != RPi_Success) 
+	{
+		log_string_plus("mpu6050_reset():  Error waking device up ", *status_ptr);
+		PT_EXIT(pt);  //No need to continue just return the failure
+	}
+	PT_DELAY_MS(pt, 100);
+	PT_END(pt);
+}
+
+/*  Bring up the MPU and load the DMP a step at a time.  The firmware goes
+	down one chunk per step and the resets are delays rather than spins, so a
+	main loop can keep running (or another device can be brought up) while
+	this is in progress.
+*/
+
+COLD ProtothreadStatus mpu6050_init_pt(Protothread *pt, Error_Returns *status_ptr)
+{
+	unsigned char buffer[2];
+
+	PT_BEGIN(pt);
+	*status_ptr = RPi_Success;
+	if (mpu6050_initialized) PT_FINISH(pt);
+	
+	*status_ptr = mpu6050_setup();
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	
+	PT_SPAWN(pt, &mpu_child_thread, mpu6050_reset_pt(&mpu_child_thread, status_ptr));
+	if (*status_ptr != RPi_Success) 
+	{
+		log_string_plus("mpu6050_init():  Reset device failed ", *status_ptr);
+		PT_EXIT(pt);  //No need to continue just return the failure
+	}
+	
+	mpu_set_sensors(INV_XYZ_GYRO | INV_XYZ_ACCEL);
+	PT_DELAY_MS(pt, 50);
+	
+	*status_ptr = mpu6050_configure();
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	PT_YIELD(pt);
+	
+	for (firmware_offset = 0; firmware_offset < DMP_CODE_SIZE; firmware_offset += firmware_chunk)
+	{
+		*status_ptr = dmp_load_firmware_chunk(firmware_offset, &firmware_chunk);
+		if (*status_ptr != RPi_Success)
+		{
+			log_string_plus("mpu6050_init():  Failed to load DMP firmware ", *status_ptr);
+			PT_EXIT(pt);  //No need to continue just return the failure
+		}
+		PT_YIELD(pt);
+	}
+	*status_ptr = dmp_set_program_start();
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	
+	dmp_set_orientation(4);
+	/*unsigned short dmp_features = 
+		DMP_FEATURE_6X_LP_QUAT | 
+		DMP_FEATURE_TAP |
+		DMP_FEATURE_ANDROID_ORIENT | 
+		DMP_FEATURE_SEND_RAW_ACCEL | 
+		DMP_FEATURE_SEND_CAL_GYRO |
+		DMP_FEATURE_GYRO_CAL;
+		*/
+	dmp_write_features(
+		DMP_FEATURE_6X_LP_QUAT | 
+		DMP_FEATURE_TAP |
+		//DMP_FEATURE_ANDROID_ORIENT | 
+		DMP_FEATURE_SEND_RAW_ACCEL | 
+		DMP_FEATURE_SEND_CAL_GYRO |
+		DMP_FEATURE_GYRO_CAL);
+	PT_SPAWN(pt, &mpu_child_thread, mpu_reset_fifo_pt(&mpu_child_thread, 1, status_ptr));
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	dmp_set_fifo_rate(DEFAULT_MPU_HZ);
+	
+	//mpu_set_dmp_state(1) with its waits turned into delays
+	buffer[0] = MPU_USER_CONTROL_REG;
+	mpu6050_read(buffer, 2);
+	buffer[1] &= ~BIT_AUX_IF_EN;
+	mpu6050_write(buffer, 2);
+	PT_DELAY_MS(pt, 3);
+	buffer[0] = MPU_INTERRUPT_CONFIG_REG;
+	buffer[1] = BIT_BYPASS_EN;
+	mpu6050_write(buffer, 2);
+	buffer[0] = MPU_FIFO_ENABLE_REG;
+	buffer[1] = 0;
+	mpu6050_write(buffer, 2);
+	PT_SPAWN(pt, &mpu_child_thread, mpu_reset_fifo_pt(&mpu_child_thread, 1, status_ptr));
+	if (*status_ptr != RPi_Success) PT_EXIT(pt);
+	
+	mpu6050_initialized = 1;
+	PT_END(pt);
+}
+
+COLD Error_Returns mpu6050_init()
+{	
+	Error_Returns to_return = RPi_Success;
+	Protothread init_thread;
+	
+	PT_INIT(&init_thread);
+	while (PT_RUNNING(mpu6050_init_pt(&init_thread, &to_return)))
+	{
+		protothread_sleep(&init_thread);
+	}
+	return to_return;
+}
+
+Error_Returns mpu6050_reset()
+{
+	Error_Returns to_return = RPi_Success;
+	Protothread reset_thread;
+	
+	PT_INIT(&reset_thread);
+	while (PT_RUNNING(mpu6050_reset_pt(&reset_thread, &to_return)))
+	{
+		protothread_sleep(&reset_thread);
+	}
+	return to_return;
+}
+
+HOT Error_Returns mpu6050_retrieve_values(MPU6050_Accel_Gyro_Values *values)
 {
 	Error_Returns to_return = MPU6050_No_New_Data;
 	do
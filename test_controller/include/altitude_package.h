@@ -26,4 +26,4 @@ Error_Returns altitude_initialize();
 
 Error_Returns altitude_reset();
 
-Error_Returns altitude_get_delta(double *delta_meters_ptr);
+Error_Returns altitude_get_delta(real_t *delta_meters_ptr);
@@ -42,41 +42,55 @@ enough for what I was looking for.
 #include "log.h"
 #include "arm_timer.h"
 #include "aux_peripherals.h"
+#include "work_queue.h"
+#include "profile.h"
+#include "boot.h"
 #include <math.h>
 
-#define BME280_MEASUREMENT_ERROR 		1.0
-#define BME280_INITIAL_ESTIMATE_ERROR 	1.0
-#define BME280_INITIAL_KALMAN_GAIN		1.0
-#define BME280_Q_FACTOR					0.01
+#define BME280_MEASUREMENT_ERROR 		REAL(1.0)
+#define BME280_INITIAL_ESTIMATE_ERROR 	REAL(1.0)
+#define BME280_INITIAL_KALMAN_GAIN		REAL(1.0)
+#define BME280_Q_FACTOR					REAL(0.01)
 #define BME280_CONVERGENCE_LOOP_COUNT 	10
 
-#define MAGIC_EXPONENT				0.1902225603956629  //Basically 1/5.22
-#define MAGIC_MULTIPLIER			44330
+#define ALTITUDE_MEASUREMENT_ERROR		REAL(1.0)
+#define ALTITUDE_INITIAL_ESTIMATE_ERROR	REAL(1.0)
+#define ALTITUDE_INITIAL_KALMAN_GAIN	REAL(1.0)
+#define ALTITUDE_Q_FACTOR				REAL(0.01)
 
-#define ALTITUDE_MEASUREMENT_ERROR		1.0
-#define ALTITUDE_INITIAL_ESTIMATE_ERROR	1.0
-#define ALTITUDE_INITIAL_KALMAN_GAIN	1.0
-#define ALTITUDE_Q_FACTOR				0.01
-
-#define STANDARD_MSL_HPASCALS		101325.0
+#define STANDARD_MSL_HPASCALS		REAL(101325.0)
 
 #define ALT_PACKAGE_TICK_TIME 		10 //In milliseconds
 
+//Boot stages, the devices come up together and then the base pressure is taken
+#define ALT_BOOT_DEVICE_STAGE		0
+#define ALT_BOOT_PRESSURE_STAGE		1
+
 typedef struct Kalman_Data {
-	double measurement_error;
-	double estimate_error;	
-	double last_estimate;
-	double estimate;
-	double kalman_gain;
-	double q_factor;
+	real_t measurement_error;
+	real_t estimate_error;	
+	real_t last_estimate;
+	real_t estimate;
+	real_t kalman_gain;
+	real_t q_factor;
 } Kalman_Filter_Data;
 
-static double base_pressure[BME280_NUMBER_SUPPORTED_DEVICES];
+static real_t base_pressure[BME280_NUMBER_SUPPORTED_DEVICES];
 static Kalman_Filter_Data kalman_filter_data[BME280_NUMBER_SUPPORTED_DEVICES];
 static Kalman_Filter_Data current_altitude;
 
 static Error_Returns altitude_state = RPi_Success;
 
+static Work_Item altitude_sample_work;
+static Soft_Timer altitude_tick_timer;
+static Profile_Probe bme280_read_probe;  //Covers the I2C reads and compensatePressure
+static Profile_Probe update_estimate_probe;
+
+static Boot_Phase bme280_phase[BME280_NUMBER_SUPPORTED_DEVICES];
+static const char *bme280_phase_name[BME280_NUMBER_SUPPORTED_DEVICES] = {"bme280_init 0", "bme280_init 1"};
+static Boot_Phase base_pressure_phase;
+static uint32_t convergence_count = 0;
+
 static void reset_kalman_filter_pressure_data(int32_t bme280_offset)
 {
 	kalman_filter_data[bme280_offset].measurement_error = BME280_MEASUREMENT_ERROR;
@@ -99,82 +113,94 @@ static void reset_altitude_filter_data()
 
 // update_estimate is based on information available at kalmanfilter.net
 
-static void update_estimate(double measure, Kalman_Filter_Data *filter_data)
+HOT static void update_estimate(real_t measure, Kalman_Filter_Data *filter_data)
 {	
 	filter_data->kalman_gain = filter_data->estimate_error/(filter_data->estimate_error + filter_data->measurement_error);
 	filter_data->estimate = filter_data->last_estimate + (filter_data->kalman_gain * (measure - filter_data->last_estimate));
-	filter_data->estimate_error = (1.0 - filter_data->kalman_gain)*filter_data->estimate_error +
-				fabs(filter_data->last_estimate - filter_data->estimate) * filter_data->q_factor;
+	filter_data->estimate_error = (REAL(1.0) - filter_data->kalman_gain)*filter_data->estimate_error +
+				REAL_FABS(filter_data->last_estimate - filter_data->estimate) * filter_data->q_factor;
 	filter_data->last_estimate = filter_data->estimate;
 	return;
 }
 
 //Update the Kalman filter for each enabled BME 280.
 
-static Error_Returns get_filtered_readings()
+HOT static Error_Returns get_filtered_readings()
 {
 	Error_Returns to_return = RPi_Success;
 	do
 	{
 		for(uint32_t bme280_id = 0; bme280_id < BME280_NUMBER_SUPPORTED_DEVICES; bme280_id++)
 		{
-			double raw_pressure;
+			real_t raw_pressure;
+			profile_start(&bme280_read_probe);
 			to_return = bme280_get_current_pressure(bme280_id, &raw_pressure);
+			profile_stop(&bme280_read_probe);
 			if (to_return != RPi_Success)
 			{
 				log_string_plus("altitude_package: get_filtered_readings failed: ", to_return);
 				break;
 			}
+			profile_start(&update_estimate_probe);
 			update_estimate(raw_pressure, &kalman_filter_data[bme280_id]);
+			profile_stop(&update_estimate_probe);
 		}
 
 	} while(0);
 	return to_return;
 }
 
-static double convert_pressure_to_altitude(double base_pressure, double current_pressure)
+/* This function assumes sole access to the BME280(s) */
+static ProtothreadStatus reset_base_pressure_pt(Protothread *pt, uint32_t argument, Error_Returns *status_ptr)
 {
-	//This equation is the barometric formula from the Bosch BMP180 datasheet.
-	//This function returns the difference between the base pressure and the current pressure
-	//in meters.
-	return MAGIC_MULTIPLIER * (1-pow((current_pressure/base_pressure), MAGIC_EXPONENT));
+	PT_BEGIN(pt);
+	*status_ptr = RPi_Success;
+	for (uint32_t offset = 0; offset < BME280_NUMBER_SUPPORTED_DEVICES; offset++)
+		{
+		reset_kalman_filter_pressure_data(offset);
+		}
+
+	//Find a stable value for the at rest pressure
+	for (convergence_count = 0; convergence_count < BME280_CONVERGENCE_LOOP_COUNT; convergence_count++)
+	{
+		PT_DELAY_MS(pt, ALT_PACKAGE_TICK_TIME);
+		*status_ptr = get_filtered_readings();
+		if (*status_ptr != RPi_Success)
+		{
+			log_string_plus("altitude_package: reset_base_pressure() failed to get filtered reading: ", *status_ptr);
+			break;
+		}
+	}
 
+	for (uint32_t offset = 0; offset < BME280_NUMBER_SUPPORTED_DEVICES; offset++)
+	{
+		base_pressure[offset] = kalman_filter_data[offset].estimate;
+		//reset_kalman_filter_pressure_data(offset);
+	}
+	PT_END(pt);
 }
 
-/* This function assumes sole access to the BME280(s) */
 static Error_Returns reset_base_pressure()
 {
 	Error_Returns to_return = RPi_Success;
-	do
-	{
-		for (uint32_t offset = 0; offset < BME280_NUMBER_SUPPORTED_DEVICES; offset++)
-			{
-			reset_kalman_filter_pressure_data(offset);
-			}
-
-		//Find a stable value for the at rest pressure
-		for (unsigned int count = 0; count < BME280_CONVERGENCE_LOOP_COUNT; count++)
-		{
-			spin_wait_milliseconds(ALT_PACKAGE_TICK_TIME);
-			to_return = get_filtered_readings();
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("altitude_package: reset_base_pressure() failed to get filtered reading: ", to_return);
-				break;
-			}
-		}
+	Protothread reset_thread;
 
-		for (uint32_t offset = 0; offset < BME280_NUMBER_SUPPORTED_DEVICES; offset++)
-		{
-			base_pressure[offset] = kalman_filter_data[offset].estimate;
-			//reset_kalman_filter_pressure_data(offset);
-		}
-	} while(0);
+	PT_INIT(&reset_thread);
+	while (PT_RUNNING(reset_base_pressure_pt(&reset_thread, 0, &to_return)))
+	{
+		protothread_sleep(&reset_thread);
+	}
 	return to_return;
 }
 
-//Interrupt handling routine to get readings every ALT_PACKAGE_TICK_TIME milliseconds.
-void altitude_tick_handler()
+static ProtothreadStatus bme280_boot_pt(Protothread *pt, uint32_t argument, Error_Returns *status_ptr)
+{
+	return bme280_init_pt(pt, argument, bme280_kalman_filter_mode, status_ptr);
+}
+
+//Work queue routine that does the BME 280 bus reads and filter updates queued by
+//altitude_tick_handler.
+HOT static void altitude_sample(uint32_t argument)
 {
 	if (altitude_state == RPi_Success)
 	{
@@ -182,49 +208,80 @@ void altitude_tick_handler()
 	}
 	else
 	{
-		log_interrupt_string_plus("altitude_tick_handler: state = ", (unsigned int)altitude_state);
+		log_string_plus("altitude_sample: state = ", (unsigned int)altitude_state);
+	}
+}
+
+//Interrupt handling routine to get readings every ALT_PACKAGE_TICK_TIME milliseconds,
+//the readings themselves are taken from the work queue.
+HOT static void altitude_tick_handler(uint32_t argument)
+{
+	if (work_queue_post(&altitude_sample_work) != RPi_Success)
+	{
+		log_interrupt_string("altitude_tick_handler: failed to queue sample");
 	}
 }
 
 //Set up both the BME 280(s) and the MPU 6050 and initialize the tick timer to interrupt
-//every ALT_PACKAGE_TICK_TIME milliseconds.
-Error_Returns altitude_initialize()
+//every ALT_PACKAGE_TICK_TIME milliseconds.  The devices are brought up together by
+//the boot orchestrator, boot_dump_report() shows where the time went.
+COLD Error_Returns altitude_initialize()
 {
 	Error_Returns to_return = RPi_Success;
 
 	do
 	{
-		//Initialize each BME 280
+		profile_add_probe(&bme280_read_probe, "bme280_get_current_pressure");
+		profile_add_probe(&update_estimate_probe, "update_estimate");
+
+		work_queue_init();
+		to_return = work_queue_init_item(&altitude_sample_work, altitude_sample, 0, Work_Priority_Normal);
+		if (to_return != RPi_Success)
+		{
+			log_string_plus("altitude_package: work_queue_init_item failed: ", to_return);
+			break;
+		}
+
+		//Initialize each BME 280, their settle times overlap
 		for(uint32_t bme280_id = 0; bme280_id < BME280_NUMBER_SUPPORTED_DEVICES; bme280_id++)
 		{
-			to_return = bme280_init(bme280_id, bme280_kalman_filter_mode);
-			if (to_return != RPi_Success)
-			{
-				log_string_plus("altitude_package: bme280_init failed: ", to_return);
-				break;
-			}
+			boot_add_phase(&bme280_phase[bme280_id], bme280_phase_name[bme280_id], bme280_boot_pt,
+				bme280_id, ALT_BOOT_DEVICE_STAGE);
 		}
-		
+
+		//The MPU 6050 would go in ALT_BOOT_DEVICE_STAGE as well through mpu6050_init_pt()
+		boot_add_phase(&base_pressure_phase, "reset_base_pressure", reset_base_pressure_pt, 0,
+			ALT_BOOT_PRESSURE_STAGE);
+
+		to_return = boot_run();
 		if (to_return != RPi_Success)
 		{
+			log_string_plus("altitude_package: device bring up failed: ", to_return);
 			break;
 		}
 
-		//to_return = mpu6050_init();
+		to_return = arm_timer_init();
 		if (to_return != RPi_Success)
 		{
-			log_string_plus("altitude_package: mpu6050_init failed: ", to_return);
+			log_string_plus("altitude_package: arm_timer_init failed: ", to_return);
 			break;
 		}
 
-		to_return = arm_timer_init();
+		to_return = arm_timer_init_soft_timer(&altitude_tick_timer, altitude_tick_handler, 0);
 		if (to_return != RPi_Success)
 		{
-			log_string_plus("altitude_package: arm_timer_init failed: ", to_return);
+			log_string_plus("altitude_package: arm_timer_init_soft_timer failed: ", to_return);
 			break;
 		}
 		
-		to_return = altitude_reset();
+		reset_altitude_filter_data();
+
+		to_return = arm_timer_start(&altitude_tick_timer, ALT_PACKAGE_TICK_TIME, Soft_Timer_Periodic);
+		if (to_return != RPi_Success)
+		{
+			log_string_plus("altitude_package: arm_timer_start failed: ", to_return);
+			break;
+		}
 
 		altitude_state = RPi_Success;
 	} while(0);
@@ -241,7 +298,7 @@ Error_Returns altitude_reset()
 		//Turn off the tick timer, accessing the I2C bus from
 		//two different places (reset_base_pressure and altitude_tick_handler) causes
 		//hangs.
-		arm_timer_disable();
+		arm_timer_cancel(&altitude_tick_timer);
 
 		to_return = reset_base_pressure();
 		if (to_return != RPi_Success)
@@ -252,10 +309,10 @@ Error_Returns altitude_reset()
 
 		reset_altitude_filter_data();
 
-		to_return = arm_timer_enable(altitude_tick_handler, ALT_PACKAGE_TICK_TIME);
+		to_return = arm_timer_start(&altitude_tick_timer, ALT_PACKAGE_TICK_TIME, Soft_Timer_Periodic);
 		if (to_return != RPi_Success)
 		{
-			log_string_plus("altitude_package: arm_timer_enable failed: ", to_return);
+			log_string_plus("altitude_package: arm_timer_start failed: ", to_return);
 			break;
 		}
 	} while(0);
@@ -265,7 +322,7 @@ Error_Returns altitude_reset()
 
 //Returns the current difference between the base altitude that is obtained at start up
 //or after a call to altitude_reset.
-Error_Returns altitude_get_delta(double *delta_meters_ptr)
+HOT Error_Returns altitude_get_delta(real_t *delta_meters_ptr)
 {
 	Error_Returns to_return = RPi_Success;
 
@@ -280,9 +337,9 @@ Error_Returns altitude_get_delta(double *delta_meters_ptr)
 
 		for (uint32_t bme280_id = 0; bme280_id < BME280_NUMBER_SUPPORTED_DEVICES; bme280_id++)
 		{
-			double altitude;
+			real_t altitude;
 
-			altitude = convert_pressure_to_altitude(base_pressure[bme280_id],
+			altitude = bme280_pressure_to_altitude(base_pressure[bme280_id],
 					kalman_filter_data[bme280_id].estimate);
 			update_estimate(altitude, &current_altitude);
 			reset_kalman_filter_pressure_data(bme280_id);
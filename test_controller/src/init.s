@@ -4,6 +4,67 @@
 ;@  here might not take full advantage of the instruction set, but I am looking for
 ;@  easy readability instead of performance, hopefully I have accomplished the former.
 
+;@ The mode stacks and their sizes are laid out in memmap, each one has a
+;@ guard page below it.
+
+;@ MMU flat map, only used when assembled with --defsym MMU_ENABLE=1.  The
+;@ translation table is 4096 one megabyte section entries (16K, 16K aligned)
+;@ and is placed by memmap.  The first 512M is RAM, normal memory cached write
+;@ back, everything from the peripherals at 0x20000000 up is strongly ordered
+;@ and never executed from.  The stacks' megabyte is mapped with 4K pages
+;@ instead so the guard pages can be left out, running off the end of a stack
+;@ is then a data abort rather than silently trashing the one below.
+.equ MMU_SECTIONS, 4096
+.equ MMU_RAM_SECTIONS, 512
+.equ MMU_RAM_SECTION, 0x1C0E  ;@ TEX 001, AP full access, C, B, section
+.equ MMU_DEVICE_SECTION, 0xC12  ;@ TEX 000, AP full access, XN, section
+.equ MMU_COARSE_TABLE, 0x01  ;@ Domain 0, second level table
+.equ MMU_STACK_PAGE, 0x7F  ;@ TEX 001, AP full access, C, B, small page, XN
+.equ MMU_PAGES_PER_SECTION, 256
+.equ MMU_PAGE_SIZE, 0x1000
+.equ STACK_GUARD_COUNT, 5
+.equ MMU_DOMAIN_CLIENT, 0x01  ;@ Domain 0 checks the AP bits, the rest no access
+.equ SCTLR_MMU_CACHES, 0x801805  ;@ XP (v6 tables), I cache, branch prediction, D cache, MMU
+.equ CACHE_LINE_SIZE, 32
+.equ STACK_PAINT, 0xA5A5A5A5  ;@ STACK_PAINT_PATTERN in stack_usage.h
+
+;@ The section boundaries in memmap are all word aligned.  These move
+;@ eight words per stm (the same bursts memcpy and memset in utilities use) and
+;@ finish off a word at a time.  There's no stack yet so they are macros.
+;@ fill_range sets every word from r2 up to r1 to value.
+.macro fill_range value
+    ldr r0,=\value
+    mov r3,r0
+    mov r4,r0
+    mov r5,r0
+    mov r6,r0
+    mov r7,r0
+    mov r8,r0
+    mov r9,r0
+1:  add r12,r2,#32
+    cmp r12,r1
+    bhi 2f
+    stmia r2!,{r0,r3,r4,r5,r6,r7,r8,r9}
+    b 1b
+2:  cmp r2,r1
+    strlo r0,[r2],#4
+    blo 2b
+.endm
+
+;@ copy_range copies from r0 into r2 up to r1
+.macro copy_range
+1:  add r12,r2,#32
+    cmp r12,r1
+    bhi 2f
+    ldmia r0!,{r3,r4,r5,r6,r7,r8,r9,r10}
+    stmia r2!,{r3,r4,r5,r6,r7,r8,r9,r10}
+    b 1b
+2:  cmp r2,r1
+    ldrlo r3,[r0],#4
+    strlo r3,[r2],#4
+    blo 2b
+.endm
+
 .globl _start
 _start:
     ldr pc,reset_handler
@@ -37,33 +98,46 @@ vec_loop: ldr r3, [r0], #4
 	;@ zero out the bss section
 	ldr r2, bss_start 
 	ldr r1, bss_end
-	cmp r2, r1
-	beq data_move
-	mov r0, #0
-bss_loop: str r0, [r2], #4
-	cmp r2, r1
-	bne bss_loop
+	fill_range 0
+
+	;@ and .bigdata, .noinit is left alone so it survives a reset
+	ldr r2, bigdata_start
+	ldr r1, bigdata_end
+	fill_range 0
 
 	;@copy the data section
-data_move: ldr r3, data_start 
-	ldr r0, data_end
-	ldr r1, data_rom_start
-	cmp r3, r0
-	bcs setup_stacks
-data_loop: ldr	r2, [r1], #4
-	str	r2, [r3], #4
-	cmp	r3, r0
-	bne data_loop
+	ldr r2, data_start
+	ldr r1, data_end
+	ldr r0, data_rom_start
+	copy_range
+
+	;@ paint the mode stacks, stack_usage.c finds how deep each one has
+	;@ been by looking for the first word that isn't the paint any more
+	ldr r2, stacks_start
+	ldr r1, stacks_end
+	fill_range STACK_PAINT
 	
     ;@ Set up stack pointer for IRQ mode
 setup_stacks: mov r0,#0xD2
     msr cpsr_c,r0
-    mov sp,#0x8000
+    ldr sp,=__irq_stack_top__
+
+    ;@ FIQ, abort and undefined each get their own stack so a fault
+    ;@ doesn't land on top of the IRQ or SVC stacks
+    mov r0,#0xD1
+    msr cpsr_c,r0
+    ldr sp,=__fiq_stack_top__
+    mov r0,#0xD7
+    msr cpsr_c,r0
+    ldr sp,=__abt_stack_top__
+    mov r0,#0xDB
+    msr cpsr_c,r0
+    ldr sp,=__und_stack_top__
 	
     ;@ Set up stack pointer for SVC mode
     mov r0,#0xD3
     msr cpsr_c,r0
-    mov sp,#0x8000000
+    ldr sp,=__svc_stack_top__
 	
     ;@ This took some serious reading and rereading of the ARM ARM and a bunch
 	;@ of web searches to make sure I understood what to do
@@ -74,6 +148,15 @@ setup_stacks: mov r0,#0xD2
 	;@ Now execute a floating point coprocessor instruction to enable the floating point coprocessor!
     mov r0,#0x40000000 
     fmxr fpexc,r0
+	;@ RunFast mode:  flush to zero and default NaN with all of the exception
+	;@ traps off, the VFP11 then handles denormals and NaNs in hardware instead
+	;@ of bouncing them to support code
+    mov r0,#0x03000000
+    fmxr fpscr,r0
+
+.ifdef MMU_ENABLE
+    bl mmu_init
+.endif
 
 	;@ do a branch link in case our "main" returns 
 	;@ we will fall through to the hang loop
@@ -106,7 +189,83 @@ common_dump: mov r3,#0xD3 ;@ set to SVC mode
     msr cpsr_c,r3
 	movs r1, sp ;@ save stack pointer as param to log_cpu_registers
 	movs r2, lr ;@ save link as param to log_cpu_registers
+	;@ An SVC stack overflow leaves sp in the guard page, calling from there
+	;@ would only data abort again, so start over from the top of the stack
+	ldr r3,=__svc_stack_limit__
+	cmp sp,r3
+	ldrlo sp,=__svc_stack_top__
 	bl log_cpu_registers
+	;@ log_cpu_registers comes back if the system error is dismissed, stop here
+	;@ rather than run on into whatever follows
+	b hang
+
+.ifdef MMU_ENABLE
+;@ Build the flat section table, then turn on the MMU, both L1 caches and
+;@ branch prediction.  The caches and TLBs are invalidated first as their
+;@ contents are undefined out of reset.
+mmu_init:
+    ldr r0,=__mmu_table__
+    ldr r2,=MMU_RAM_SECTION
+    ldr r3,=MMU_DEVICE_SECTION
+    mov r1,#0
+mmu_table_loop:
+    cmp r1,#MMU_RAM_SECTIONS
+    orrlo r12,r2,r1,lsl #20
+    orrhs r12,r3,r1,lsl #20
+    str r12,[r0,r1,lsl #2]
+    add r1,r1,#1
+    cmp r1,#MMU_SECTIONS
+    bne mmu_table_loop
+
+    ;@ Stacks megabyte, fill in every page then knock out the guards
+    ldr r1,=__mmu_stacks_table__
+    ldr r2,=__stacks_start__
+    orr r3,r2,#MMU_STACK_PAGE
+    mov r12,#0
+mmu_stacks_loop:
+    str r3,[r1,r12,lsl #2]
+    add r3,r3,#MMU_PAGE_SIZE
+    add r12,r12,#1
+    cmp r12,#MMU_PAGES_PER_SECTION
+    bne mmu_stacks_loop
+    adr r3,stack_guards
+    mov r12,#STACK_GUARD_COUNT
+    mov r5,#0
+mmu_guard_loop:
+    ldr r4,[r3],#4
+    sub r4,r4,r2
+    lsr r4,r4,#12
+    str r5,[r1,r4,lsl #2]
+    subs r12,r12,#1
+    bne mmu_guard_loop
+    orr r1,r1,#MMU_COARSE_TABLE
+    lsr r2,r2,#20
+    str r1,[r0,r2,lsl #2]
+
+    mov r1,#0
+    mcr p15, 0, r1, c7, c7, 0  ;@ Invalidate both caches and the branch target cache
+    mcr p15, 0, r1, c8, c7, 0  ;@ Invalidate the TLBs
+    mcr p15, 0, r1, c7, c10, 4  ;@ Data synchronization barrier, the table is in memory
+    mcr p15, 0, r1, c2, c0, 2  ;@ TTBCR, TTBR0 covers the whole 4G
+    mcr p15, 0, r0, c2, c0, 0  ;@ TTBR0
+    mov r1,#MMU_DOMAIN_CLIENT
+    mcr p15, 0, r1, c3, c0, 0  ;@ Domain access control
+    mrc p15, 0, r1, c1, c0, 0
+    ldr r2,=SCTLR_MMU_CACHES
+    orr r1,r1,r2
+    mcr p15, 0, r1, c1, c0, 0
+    mov r1,#0
+    mcr p15, 0, r1, c7, c5, 4  ;@ Flush the prefetch buffer
+    bx lr
+
+;@ One guard page each, see memmap
+stack_guards:
+    .word __und_stack_guard__
+    .word __abt_stack_guard__
+    .word __fiq_stack_guard__
+    .word __irq_stack_guard__
+    .word __svc_stack_guard__
+.endif
 
 .globl dummy
 dummy:
@@ -131,17 +290,198 @@ disable_cpu_interrupts:
     msr cpsr_c,r0
     bx lr
 
-irq:
+;@ Mask IRQs and hand back the old CPSR, exit_critical_section puts it back
+;@ so these nest properly and are safe to use from within an interrupt handler
+.globl enter_critical_section
+enter_critical_section:
+    mrs r0,cpsr
+    orr r1,r0,#0x80
+    msr cpsr_c,r1
+    bx lr
+
+.globl exit_critical_section
+exit_critical_section:
+    msr cpsr_c,r0
+    bx lr
+
+;@ Wait for interrupt is a CP15 c7 operation on the ARM1176 (no WFI instruction in ARMv6)
+.globl wait_for_interrupt
+wait_for_interrupt:
+    mov r0,#0
+    mcr p15, 0, r0, c7, c0, 4
+    bx lr
+
+;@ The ARM1176 performance monitor control register (PMNC) is c15,c12,0 and
+;@ the cycle counter (CCNT) is c15,c12,1.  Bit 0 of PMNC enables the counters.
+.globl enable_cycle_counter
+enable_cycle_counter:
+    mrc p15, 0, r0, c15, c12, 0
+    orr r0,r0,#0x01
+    mcr p15, 0, r0, c15, c12, 0
+    bx lr
+
+.globl read_cycle_counter
+read_cycle_counter:
+    mrc p15, 0, r0, c15, c12, 1
+    bx lr
+
+.globl read_pmu_control
+read_pmu_control:
+    mrc p15, 0, r0, c15, c12, 0
+    bx lr
+
+.globl write_pmu_control
+write_pmu_control:
+    mcr p15, 0, r0, c15, c12, 0
+    bx lr
+
+;@ PMN0 is c15,c12,2 and PMN1 is c15,c12,3
+.globl read_event_counter_0
+read_event_counter_0:
+    mrc p15, 0, r0, c15, c12, 2
+    bx lr
+
+.globl read_event_counter_1
+read_event_counter_1:
+    mrc p15, 0, r0, c15, c12, 3
+    bx lr
+
+;@ Data cache maintenance by address for buffers shared with DMA, r0 is the
+;@ start and r1 the length in bytes.  The range is widened out to whole cache
+;@ lines.  These are harmless with the caches off.
+.macro dcache_range_op crm
+    add r1,r1,r0
+    bic r0,r0,#(CACHE_LINE_SIZE - 1)
+1:  cmp r0,r1
+    mcrlo p15, 0, r0, c7, \crm, 1
+    addlo r0,r0,#CACHE_LINE_SIZE
+    blo 1b
+    mov r0,#0
+    mcr p15, 0, r0, c7, c10, 4
+    bx lr
+.endm
+
+;@ Write dirty lines out to memory, before a DMA engine reads the buffer
+.globl clean_dcache_range
+clean_dcache_range:
+    dcache_range_op c10
+
+;@ Throw away cached lines, before the CPU reads a buffer a DMA engine wrote
+.globl invalidate_dcache_range
+invalidate_dcache_range:
+    dcache_range_op c6
+
+.globl clean_invalidate_dcache_range
+clean_invalidate_dcache_range:
+    dcache_range_op c14
+
+.globl data_sync_barrier
+data_sync_barrier:
+    mov r0,#0
+    mcr p15, 0, r0, c7, c10, 4
+    bx lr
+
+.globl data_memory_barrier
+data_memory_barrier:
+    mov r0,#0
+    mcr p15, 0, r0, c7, c10, 5
+    bx lr
+
+.globl get_system_control
+get_system_control:
+    mrc p15, 0, r0, c1, c0, 0
+    bx lr
+
+;@ Timestamp the entry with the cycle counter and hand it to interrupt_handler
+;@ so the profiler can include the register save in the IRQ duration
+;@ IRQ entry.  The C handler saves r4-r11 itself if it uses them so only the
+;@ AAPCS caller saved registers are pushed.  srsdb puts the return address and
+;@ SPSR on the IRQ stack (interrupt_handler may let a more important IRQ in
+;@ which overwrites lr_irq/spsr_irq) and rfeia pops both back in one go.  The
+;@ frame is 8 words (lr is pushed as padding) so the IRQ stack stays 8 byte
+;@ aligned as the AAPCS requires.
+;@ Note:  neither version saves the VFP registers, handlers must not use floats.
+.macro lean_irq_entry handler
+    sub lr,lr,#4
+    srsdb sp!,#0x12
+    push {r0,r1,r2,r3,r12,lr}
+    mrc p15, 0, r0, c15, c12, 1
+    bl \handler
+    pop {r0,r1,r2,r3,r12,lr}
+    rfeia sp!
+.endm
+
+;@ The original entry exactly as it was, everything saved, kept for the benchmark
+.macro full_irq_entry handler
     push {r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,lr}
-    bl interrupt_handler
+    bl \handler
     pop  {r0,r1,r2,r3,r4,r5,r6,r7,r8,r9,r10,r11,r12,lr}
     subs pc,lr,#4
+.endm
+
+irq:
+    lean_irq_entry interrupt_handler
+
+.globl irq_benchmark_lean
+irq_benchmark_lean:
+    lean_irq_entry dummy
+
+.globl irq_benchmark_full
+irq_benchmark_full:
+    full_irq_entry dummy
+
+;@ irq_round_trip_cycles(stub):  fake an IRQ into one of the benchmark stubs by
+;@ setting up lr_irq and spsr_irq the way the core would and jumping to it.
+;@ Returns the cycles from the jump until the stub has returned.  This leaves
+;@ out the core's own exception entry, which is the same for both stubs.
+.globl irq_round_trip_cycles
+irq_round_trip_cycles:
+    push {r4,r5,r6,lr}
+    mrs r4,cpsr
+    cpsid i
+    mrs r5,cpsr
+    adr r1,irq_round_trip_return
+    add r1,r1,#4
+    cps #0x12
+    mov lr,r1
+    msr spsr_cxsf,r5
+    mrc p15, 0, r6, c15, c12, 1
+    bx r0
+irq_round_trip_return:
+    mrc p15, 0, r0, c15, c12, 1
+    sub r0,r0,r6
+    msr cpsr_c,r4
+    pop {r4,r5,r6,pc}
+
+;@ nested_interrupt_call(handler):  called in IRQ mode with IRQs masked.  Drop
+;@ to SVC mode on the interrupted code's stack (keeping its lr), unmask IRQs
+;@ and call the handler.  A nested IRQ then only uses lr_irq/spsr_irq which
+;@ are already saved.  Returns whatever the handler returned.
+.globl nested_interrupt_call
+nested_interrupt_call:
+    push {r4,lr}
+    cps #0x13
+    mov r1,sp
+    bic sp,sp,#7
+    push {r1,lr}
+    cpsie i
+    blx r0
+    cpsid i
+    pop {r1,lr}
+    mov sp,r1
+    cps #0x12
+    pop {r4,pc}
 	
 .globl bss_start
 bss_start: .word __bss_start__
 .globl bss_end
 bss_end: .word __bss_end__
 
+.globl bigdata_start
+bigdata_start: .word __bigdata_start__
+.globl bigdata_end
+bigdata_end: .word __bigdata_end__
+
 .globl data_rom_start
 data_rom_start:
 .word __data_rom_start__
@@ -153,6 +493,9 @@ data_start:
 data_end:
 .word __data_end__
 
+stacks_start: .word __stacks_start__
+stacks_end: .word __svc_stack_top__
+
 	
 ;@-------------------------------------------------------------------------
 ;@
@@ -47,7 +47,7 @@ static uint32_t servo_count = 0;
 
 static Servo_Parameters servos[MAX_SERVOS_SUPPORTED];
 
-Error_Returns servo_controller_init()
+COLD Error_Returns servo_controller_init()
 {
 	Error_Returns to_return = RPi_Success;
 	to_return = pca9685_init(PCA9685_ID, PCA_9685_Internal_Clock,
@@ -29,6 +29,14 @@ is definitely a work in progress...
 #define SERVO_MIN_LIMIT	-90
 #define SERVO_MAX_LIMIT 90
 
+//Scheduler task period and budget in microseconds, priorities are rate monotonic
+#define TELEMETRY_PERIOD	100000
+#define TELEMETRY_BUDGET	5000
+#define TELEMETRY_PRIORITY	1
+
+//Event loop flags
+#define CONSOLE_EVENT		0
+
 #include <stdio.h>
 #include "common.h"
 #include "altitude_package.h"
@@ -38,9 +46,122 @@ is definitely a work in progress...
 #include "aux_peripherals.h"
 #include "servo_controller.h"
 #include "arm_timer.h"
+#include "work_queue.h"
+#include "interrupt_handler.h"
+#include "system_timer.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "event_loop.h"
+#include "boot.h"
+#include "allocator.h"
+#include "mem_ops.h"
+#include "stack_usage.h"
 
 int __errno = 0;
 
+static Profile_Probe printf_probe;
+static Scheduler_Task telemetry_task;
+
+static void telemetry(uint32_t argument)
+{
+	real_t delta_meter;
+	//MPU6050_Accel_Gyro_Values mpu_values;
+	Error_Returns status = altitude_get_delta(&delta_meter);
+
+	if (status != RPi_Success)
+	{
+		log_string("altitude_get_delta failed!");
+		event_loop_stop();
+		return;
+	}
+
+	profile_start(&printf_probe);
+	printf("delta_meter: %f\n\r", delta_meter);
+	profile_stop(&printf_probe);
+	/*status = mpu6050_retrieve_values(&mpu_values);
+	if (status == RPi_Success)
+	{
+		log_string_plus("Quat w: ", (uint32_t)mpu_values.quat_w);
+		log_string_plus("Quat x: ", (uint32_t)mpu_values.quat_x);
+		log_string_plus("Quat y: ", (uint32_t)mpu_values.quat_y);
+		log_string_plus("Quat z: ", (uint32_t)mpu_values.quat_z);	
+	}
+	else if (status == MPU6050_Data_Overflow)
+	{
+		log_string("MPU data overflow, aborting...");
+		event_loop_stop();
+	}*/
+}
+
+static void console_rx(void)
+{
+	event_loop_signal(CONSOLE_EVENT);
+}
+
+//Runs from the event loop whenever the UART has received something
+static void console(void)
+{
+	char tty_char;
+	while ((tty_char = log_getchar()) != 0)
+	{
+		if (tty_char == 'd')
+		{
+			log_string("See ya!");
+			event_loop_stop();
+		}
+		else if (tty_char == 'r')
+		{
+			altitude_reset();
+		}
+		else if (tty_char == 'w')
+		{
+			work_queue_dump_stats();
+		}
+		else if (tty_char == 'i')
+		{
+			interrupt_handler_dump_stats();
+			interrupt_handler_reset_stats();
+		}
+		else if (tty_char == 'b')
+		{
+			interrupt_handler_benchmark_entry();
+		}
+		else if (tty_char == 'p')
+		{
+			profile_dump();
+			profile_reset();
+		}
+		else if (tty_char == 'm')
+		{
+			//Switch the event counters to branch mispredicts and stalls
+			profile_init(Profile_Event_Branch_Mispredict, Profile_Event_Data_Dependency_Stall, 0);
+			profile_reset();
+		}
+		else if (tty_char == 's')
+		{
+			scheduler_dump_stats();
+			scheduler_reset_stats();
+		}
+		else if (tty_char == 'u')
+		{
+			event_loop_dump_stats();
+			event_loop_reset_stats();
+		}
+		else if (tty_char == 'a')
+		{
+			allocator_dump_stats();
+		}
+		else if (tty_char == 'c')
+		{
+			mem_ops_benchmark();
+		}
+		else if (tty_char == 'k')
+		{
+			stack_usage_dump();
+		}
+	}
+}
+
 int test_control()
 {
     Error_Returns status = RPi_Success;
@@ -53,6 +174,24 @@ int test_control()
 		log_indicate_system_error();
 	}
 
+	log_string_plus("CP15 control (MMU/caches): ", get_system_control());
+
+	status = system_timer_init();
+	if (status != RPi_Success)
+	{
+		log_string_plus("system_timer_init failed: ", status);
+	}
+
+	//Started ahead of the sensors so their power up delays can sleep
+	status = arm_timer_init();
+	if (status != RPi_Success)
+	{
+		log_string_plus("arm_timer_init failed: ", status);
+	}
+
+	profile_init(Profile_Event_ICache_Miss, Profile_Event_DCache_Miss, 0);
+	profile_add_probe(&printf_probe, "printf");
+
 	status = altitude_initialize();
 	if (status != RPi_Success)
 	{
@@ -61,46 +200,22 @@ int test_control()
 		log_indicate_system_error();
 	}
 
+	boot_dump_report();
 	log_string("Altitude test ready\n\r");
 
-	while (1)
+	status = event_loop_init();
+	if (status == RPi_Success)
 	{
-		double delta_meter;
-		spin_wait_milliseconds(150);
-		//MPU6050_Accel_Gyro_Values mpu_values;
-		status = altitude_get_delta(&delta_meter);
-
-		if (status != RPi_Success)
-		{
-			log_string("altitude_get_delta failed!");
-			break;
-		}
-
-		printf("delta_meter: %f\n\r", delta_meter);
-		/*status = mpu6050_retrieve_values(&mpu_values);
-		if (status == RPi_Success)
-		{
-			log_string_plus("Quat w: ", (uint32_t)mpu_values.quat_w);
-			log_string_plus("Quat x: ", (uint32_t)mpu_values.quat_x);
-			log_string_plus("Quat y: ", (uint32_t)mpu_values.quat_y);
-			log_string_plus("Quat z: ", (uint32_t)mpu_values.quat_z);	
-		}
-		else if (status == MPU6050_Data_Overflow)
-		{
-			log_string("MPU data overflow, aborting...");
-			break;
-		}*/
-
-		char tty_char = log_getchar();
-		if (tty_char == 'd')
-		{
-			log_string("See ya!");
-			break;
-		}
-		else if (tty_char == 'r')
-		{
-			status = altitude_reset();
-		}
+		scheduler_add_task(&telemetry_task, "telemetry", telemetry, 0, TELEMETRY_PERIOD,
+			TELEMETRY_PRIORITY, TELEMETRY_BUDGET);
+		event_loop_register(CONSOLE_EVENT, console, "console");
+		uart_set_rx_handler(console_rx);
+		event_loop_run();
+		uart_set_rx_handler(NULL_PTR);
+	}
+	else
+	{
+		log_string_plus("event_loop_init failed: ", status);
 	}
 	
 	mpu6050_reset();
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+# MIT license, see LICENSE.
+#
+# File:  section_report.py
+#
+# Sizes of the HOT, normal and COLD code and of the constants and FIRMWARE
+# tables from the linker map the test_controller build writes, with what makes
+# up the HOT code and how much of the 16K I cache it takes:
+#
+#     python tools/section_report.py test_controller/src/test_driver.map
+
+import argparse
+import re
+
+ICACHE_SIZE = 16 * 1024
+
+SYMBOL_LINE = re.compile(r'^\s+0x([0-9a-f]+)\s+(__\w+__) = ')
+SECTION_LINE = re.compile(r'^ (\.\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+))?$')
+CONTINUATION_LINE = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+)$')
+
+REGIONS = [
+    ('HOT code', '__hot_text_start__', '__hot_text_end__'),
+    ('Code', '__hot_text_end__', '__cold_text_start__'),
+    ('COLD code', '__cold_text_start__', '__cold_text_end__'),
+    ('Constants', '__cold_text_end__', '__firmware_start__'),
+    ('FIRMWARE', '__firmware_start__', '__firmware_end__'),
+]
+
+
+def read_map(path):
+    symbols = {}
+    pieces = []
+    pending = None
+    with open(path) as map_file:
+        for line in map_file:
+            line = line.rstrip()
+            match = SYMBOL_LINE.match(line)
+            if match:
+                symbols[match.group(2)] = int(match.group(1), 16)
+                continue
+            if pending is not None:
+                match = CONTINUATION_LINE.match(line)
+                if match:
+                    pieces.append((int(match.group(1), 16), int(match.group(2), 16), match.group(3)))
+                pending = None
+                continue
+            match = SECTION_LINE.match(line)
+            if match:
+                if match.group(2) is None:
+                    pending = match.group(1)  #Long name, the rest is on the next line
+                else:
+                    pieces.append((int(match.group(2), 16), int(match.group(3), 16), match.group(4)))
+    return symbols, pieces
+
+
+def main():
+    parser = argparse.ArgumentParser(description='HOT/COLD code placement report')
+    parser.add_argument('map', help='linker map of the elf')
+    args = parser.parse_args()
+
+    symbols, pieces = read_map(args.map)
+    missing = [name for region in REGIONS for name in region[1:] if name not in symbols]
+    if missing:
+        raise SystemExit('%s not in the map, is it from a build with the current memmap?' % missing[0])
+
+    for name, start, end in REGIONS:
+        print('%-10s %7d bytes' % (name, symbols[end] - symbols[start]))
+
+    hot_start = symbols['__hot_text_start__']
+    hot_end = symbols['__hot_text_end__']
+    hot_size = hot_end - hot_start
+    print('\nHOT code is %d%% of the %dK I cache' % (hot_size * 100 // ICACHE_SIZE, ICACHE_SIZE // 1024))
+    by_object = {}
+    for address, size, owner in pieces:
+        if hot_start <= address < hot_end and size != 0:
+            by_object[owner] = by_object.get(owner, 0) + size
+    for owner, size in sorted(by_object.items(), key=lambda item: -item[1]):
+        print('%7d  %s' % (size, owner))
+    if hot_size > ICACHE_SIZE:
+        raise SystemExit('HOT code is over the I cache size')
+
+
+if __name__ == '__main__':
+    main()
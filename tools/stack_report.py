@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+# Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+# MIT license, see LICENSE.
+#
+# File:  stack_report.py
+#
+# Worst case stack depth per call chain.  Build with STACKOPS = -fstack-usage
+# (Makefile.inc) so gcc writes a .su file next to every object, then run this
+# on the disassembly the test_controller build leaves in test_driver.list:
+#
+#     python tools/stack_report.py test_controller/src/test_driver.list
+#
+# The call graph comes from the bl/blx instructions (and b to the start of
+# another function, a tail call) in the listing, the frame sizes from the .su
+# files.  Calls through pointers (blx rN) can't be followed, functions that
+# make them are marked with *.  Assembly routines have no .su data and count
+# as zero, they are marked with ?.  Anything recursive is marked with @ and
+# only counted once around the loop.
+
+import argparse
+import os
+import re
+import sys
+
+FUNCTION_LINE = re.compile(r'^([0-9a-f]+) <([^>]+)>:$')
+CALL_LINE = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f]{8}\s+(bl|blx|b)(?:eq|ne|cs|hs|cc|lo|mi|pl|vs|vc|hi|ls|ge|lt|gt|le)?\s+([0-9a-f]+) <([^>+]+)(\+0x[0-9a-f]+)?>')
+INDIRECT_LINE = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f]{8}\s+blx\w*\s+(r\d+|ip|lr)\s*$')
+
+
+def read_listing(path):
+    calls = {}
+    indirect = set()
+    current = None
+    in_text = False
+    with open(path) as listing:
+        for line in listing:
+            line = line.rstrip()
+            if line.startswith('Disassembly of section'):
+                in_text = line.endswith('.text:')
+                current = None
+                continue
+            if not in_text:
+                continue
+            match = FUNCTION_LINE.match(line)
+            if match:
+                current = match.group(2)
+                calls.setdefault(current, set())
+                continue
+            if current is None:
+                continue
+            match = CALL_LINE.match(line)
+            if match:
+                kind, target, offset = match.group(1), match.group(3), match.group(4)
+                #A plain branch is a tail call only if it lands on another function's start
+                if kind == 'b' and (offset is not None or target == current):
+                    continue
+                calls[current].add(target)
+            elif INDIRECT_LINE.match(line):
+                indirect.add(current)
+    return calls, indirect
+
+
+def read_stack_usage(roots):
+    frames = {}
+    dynamic = set()
+    for root in roots:
+        for directory, _, files in os.walk(root):
+            for name in files:
+                if not name.endswith('.su'):
+                    continue
+                with open(os.path.join(directory, name)) as su_file:
+                    for line in su_file:
+                        fields = line.rstrip('\n').split('\t')
+                        if len(fields) != 3:
+                            continue
+                        function = fields[0].rsplit(':', 1)[-1]
+                        frames[function] = max(frames.get(function, 0), int(fields[1]))
+                        if fields[2] != 'static':
+                            dynamic.add(function)
+    return frames, dynamic
+
+
+def worst_case(function, calls, frames, memo, active, recursive):
+    if function in memo:
+        return memo[function]
+    if function in active:
+        recursive.add(function)
+        return 0, [function]
+    active.add(function)
+    deepest, deepest_chain = 0, []
+    for callee in sorted(calls.get(function, ())):
+        depth, chain = worst_case(callee, calls, frames, memo, active, recursive)
+        if depth > deepest or not deepest_chain:
+            deepest, deepest_chain = depth, chain
+    active.discard(function)
+    memo[function] = (frames.get(function, 0) + deepest, [function] + deepest_chain)
+    return memo[function]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Worst case stack depth per call chain')
+    parser.add_argument('listing', help='objdump -D output of the linked elf')
+    parser.add_argument('--su-dir', action='append',
+        help='where to look for .su files, the repository by default')
+    parser.add_argument('--function', action='append',
+        help='report this function instead of every root of the call graph')
+    args = parser.parse_args()
+
+    su_dirs = args.su_dir or [os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')]
+    calls, indirect = read_listing(args.listing)
+    frames, dynamic = read_stack_usage(su_dirs)
+    if not frames:
+        sys.exit('No .su files found, build with STACKOPS = -fstack-usage')
+
+    if args.function:
+        roots = args.function
+    else:
+        called = set()
+        for callees in calls.values():
+            called |= callees
+        roots = [function for function in calls if function not in called]
+
+    memo = {}
+    recursive = set()
+    results = []
+    for root in roots:
+        depth, chain = worst_case(root, calls, frames, memo, set(), recursive)
+        results.append((depth, root, chain))
+
+    def label(function):
+        marks = ''
+        if function not in frames:
+            marks += '?'
+        if function in dynamic:
+            marks += '+'
+        if function in indirect:
+            marks += '*'
+        if function in recursive:
+            marks += '@'
+        return '%s%s (%d)' % (function, marks, frames.get(function, 0))
+
+    print('Worst case stack in bytes, ? no .su data, + dynamic frame, * calls through a pointer, @ recursive')
+    for depth, root, chain in sorted(results, reverse=True):
+        if depth == 0:
+            continue
+        print('%7d  %s' % (depth, root))
+        print('         ' + ' -> '.join(label(function) for function in chain))
+
+
+if __name__ == '__main__':
+    main()
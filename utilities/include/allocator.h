@@ -0,0 +1,61 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  allocator.h
+
+Memory allocation without a heap.  The arena hands out memory from the static
+arena region in memmap, it only grows and is meant for buffers that are set up
+once at boot and sized from the configuration that is actually present.  Pools
+are made of equal sized blocks, allocating and freeing one is O(1) and safe from
+an interrupt handler, for descriptors, packets and records that come and go.
+Both keep high water marks so buffer sizes can be set from measured use.
+
+*/
+
+#pragma once
+#include "common.h"
+
+#define ARENA_DEFAULT_ALIGNMENT 8
+
+typedef struct Memory_Pool_Struct {
+	const char *name;
+	unsigned char *storage_ptr;
+	void *free_list_ptr;
+	uint32_t block_size;
+	uint32_t block_count;
+	uint32_t in_use;
+	uint32_t high_water;
+	uint32_t failures;
+	struct Memory_Pool_Struct *next_ptr;
+} Memory_Pool;
+
+void *arena_alloc(uint32_t size, uint32_t alignment);
+
+uint32_t arena_used(void);
+
+uint32_t arena_available(void);
+
+Error_Returns pool_init(Memory_Pool *pool, const char *name, void *storage_ptr,
+		uint32_t block_size, uint32_t block_count);
+
+void *pool_alloc(Memory_Pool *pool);
+
+Error_Returns pool_free(Memory_Pool *pool, void *block_ptr);
+
+void allocator_dump_stats(void);
@@ -0,0 +1,56 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  boot.h
+
+Runs device bring up sequences side by side.  Each sequence is a protothread
+(see protothread.h) registered as a boot phase.  Phases in the same stage run
+together, so one device can be sent commands while another sits out a power
+up or settle delay; a stage only starts once every phase in the stage before
+it has finished.  The start, end and CPU time of each phase are recorded for a
+boot time report.
+
+*/
+
+#pragma once
+#include "common.h"
+#include "protothread.h"
+
+typedef struct Boot_Phase_Struct {
+	const char *name;
+	ProtothreadStatus (*thread_ptr)(Protothread *pt, uint32_t argument, Error_Returns *status_ptr);
+	uint32_t argument;
+	uint32_t stage;
+	Protothread thread;
+	Error_Returns status;
+	uint32_t finished;
+	uint32_t steps;
+	uint32_t busy_us;  //Time spent running the phase's steps, not its delays
+	uint64_t start_us;
+	uint64_t end_us;
+	struct Boot_Phase_Struct *next_ptr;
+} Boot_Phase;
+
+Error_Returns boot_add_phase(Boot_Phase *phase, const char *name,
+		ProtothreadStatus (*thread_ptr)(Protothread *pt, uint32_t argument, Error_Returns *status_ptr),
+		uint32_t argument, uint32_t stage);
+
+Error_Returns boot_run(void);
+
+void boot_dump_report(void);
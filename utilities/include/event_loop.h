@@ -0,0 +1,47 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  event_loop.h
+
+An event driven main loop.  Interrupt handlers (or anything else) signal one of
+32 event flags, the loop runs the handler registered for each flag that is set,
+then any deferred work and any released scheduler tasks, and sleeps in WFI when
+there is nothing left to do.  The time spent asleep is measured so the loop can
+report how busy the CPU is.
+
+*/
+
+#pragma once
+#include "common.h"
+
+#define EVENT_LOOP_MAX_EVENTS 32
+
+Error_Returns event_loop_init(void);
+
+Error_Returns event_loop_register(uint32_t event, void (*handler_ptr)(void), const char *name);
+
+void event_loop_signal(uint32_t event);
+
+void event_loop_run(void);
+
+void event_loop_stop(void);
+
+void event_loop_reset_stats(void);
+
+void event_loop_dump_stats(void);
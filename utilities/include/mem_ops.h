@@ -0,0 +1,43 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  mem_ops.h
+
+The block memory routines.  memcpy, memmove and memset are the usual C library
+ones, written in assembly (mem_ops.s) for the ARM1176 since nothing else
+provides them with -nostdlib.  memclr is memset to zero.
+
+*/
+
+#pragma once
+#include "common.h"
+
+void *memcpy(void *dst, const void *src, size_t length);
+
+void *memmove(void *dst, const void *src, size_t length);
+
+void *memset(void *dst, int value, size_t length);
+
+void memclr(void *dst, size_t length);
+
+/*  Times memcpy and memset against plain byte loops for 16 bytes up to 64K
+	and logs the cycles.  The buffers come from the arena the first time.
+*/
+
+Error_Returns mem_ops_benchmark(void);
@@ -0,0 +1,81 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  profile.h
+
+Profiling with the ARM1176 performance monitor.  The PMU has a cycle counter and
+two event counters that can each count one of the events below.  Code is timed
+with named probes, each probe keeps a running count, total, min and max of the
+cycles and both events between its start and stop.
+
+*/
+
+#pragma once
+#include "common.h"
+
+//Event numbers from the ARM1176JZF-S TRM, performance monitor control register
+typedef enum {
+	Profile_Event_ICache_Miss = 0x00,
+	Profile_Event_Instruction_Stall = 0x01,
+	Profile_Event_Data_Dependency_Stall = 0x02,
+	Profile_Event_Branch_Executed = 0x05,
+	Profile_Event_Branch_Mispredict = 0x06,
+	Profile_Event_Instructions = 0x07,
+	Profile_Event_DCache_Access = 0x09,
+	Profile_Event_DCache_Miss = 0x0B,
+	Profile_Event_DCache_Writeback = 0x0C,
+	Profile_Event_TLB_Miss = 0x0F,
+	Profile_Event_LSU_Stall = 0x11,
+	Profile_Event_Cycles = 0xFF
+} ProfileEvent;
+
+typedef struct Profile_Probe_Struct {
+	const char *name;
+	uint32_t count;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+	uint64_t total_event_0;
+	uint64_t total_event_1;
+	uint64_t start_cycles;
+	uint64_t start_event_0;
+	uint64_t start_event_1;
+	struct Profile_Probe_Struct *next_ptr;
+} Profile_Probe;
+
+Error_Returns profile_init(ProfileEvent event_0, ProfileEvent event_1, uint32_t divide_by_64);
+
+Error_Returns profile_add_probe(Profile_Probe *probe, const char *name);
+
+void profile_start(Profile_Probe *probe);
+
+void profile_stop(Profile_Probe *probe);
+
+void profile_reset(void);
+
+void profile_dump(void);
+
+/*  Times the rest of the enclosing block, profile_stop is called by the compiler
+	on the way out of it however that happens.
+*/
+
+void profile_scope_exit(Profile_Probe **probe_ptr);
+
+#define PROFILE_SCOPE(probe) \
+	Profile_Probe *profile_scope_probe __attribute__((cleanup(profile_scope_exit))) = (profile_start(probe), (probe))
@@ -0,0 +1,140 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  protothread.h
+
+Stackless cooperative threads ("protothreads") for long multi-step sequences
+such as device bring-up.  A protothread is an ordinary function that returns
+at each wait or yield and picks up where it left off the next time it is
+called.  The resume point is kept in a switch on a line number, so there is no
+per-thread stack, but it also means:
+
+	- Local variables are not kept across a wait or yield, anything that has
+	  to survive goes in the caller's state or in a static.
+	- A switch statement can't straddle a wait or yield.
+	- Only one wait or yield macro per source line.
+
+A thread looks like:
+
+	static ProtothreadStatus do_something_pt(Protothread *pt, Error_Returns *status_ptr)
+	{
+		PT_BEGIN(pt);
+		*status_ptr = first_step();
+		if (*status_ptr != RPi_Success) PT_EXIT(pt);
+		PT_DELAY_US(pt, 10000);
+		*status_ptr = second_step();
+		PT_END(pt);
+	}
+
+and is run by calling it until PT_RUNNING() is false, from a main loop or with
+protothread_sleep() in between to block.
+
+*/
+
+#pragma once
+#include "common.h"
+#include "system_timer.h"
+
+typedef enum {
+	Protothread_Waiting,  //Blocked on a condition or a delay
+	Protothread_Yielded,  //Ready to go again straight away
+	Protothread_Exited,   //Gave up part way, see the thread's status
+	Protothread_Ended     //Ran to the end
+} ProtothreadStatus;
+
+typedef struct {
+	uint32_t resume_line;  //0 is the start of the thread
+	uint64_t wake_time;  //Deadline on timer_now_us while in a delay, otherwise 0
+} Protothread;
+
+#define PT_INIT(pt) \
+	do { (pt)->resume_line = 0; (pt)->wake_time = 0; } while(0)
+
+#define PT_RUNNING(status) ((status) < Protothread_Exited)
+
+#define PT_BEGIN(pt) switch ((pt)->resume_line) { case 0:
+
+#define PT_END(pt) \
+	} \
+	PT_INIT(pt); \
+	return Protothread_Ended
+
+#define PT_WAIT_UNTIL(pt, condition) \
+	do \
+	{ \
+		(pt)->resume_line = __LINE__; \
+		case __LINE__: \
+		if (!(condition)) return Protothread_Waiting; \
+	} while(0)
+
+#define PT_WAIT_WHILE(pt, condition) PT_WAIT_UNTIL(pt, !(condition))
+
+#define PT_YIELD(pt) \
+	do \
+	{ \
+		(pt)->resume_line = __LINE__; \
+		return Protothread_Yielded; \
+		case __LINE__:; \
+	} while(0)
+
+#define PT_DELAY_US(pt, microseconds) \
+	do \
+	{ \
+		(pt)->wake_time = timer_deadline_us(microseconds); \
+		PT_WAIT_UNTIL(pt, timer_deadline_reached((pt)->wake_time)); \
+		(pt)->wake_time = 0; \
+	} while(0)
+
+#define PT_DELAY_MS(pt, milliseconds) PT_DELAY_US(pt, (milliseconds) * 1000)
+
+#define PT_EXIT(pt) \
+	do \
+	{ \
+		PT_INIT(pt); \
+		return Protothread_Exited; \
+	} while(0)
+
+//Done early with nothing left to do, the same as running on to PT_END
+#define PT_FINISH(pt) \
+	do \
+	{ \
+		PT_INIT(pt); \
+		return Protothread_Ended; \
+	} while(0)
+
+/*  Run a child thread to completion from inside a parent.  The child's wake
+	time is passed up so whoever is running the parent knows when to come back.
+	The child's own result has to be checked afterwards through its status.
+*/
+
+#define PT_SPAWN(pt, child, thread_call) \
+	do \
+	{ \
+		PT_INIT(child); \
+		(pt)->resume_line = __LINE__; \
+		case __LINE__: \
+		if (PT_RUNNING(thread_call)) \
+		{ \
+			(pt)->wake_time = (child)->wake_time; \
+			return Protothread_Waiting; \
+		} \
+		(pt)->wake_time = 0; \
+	} while(0)
+
+void protothread_sleep(Protothread *pt);
@@ -0,0 +1,63 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  scheduler.h
+
+A small static, cooperative, rate monotonic task scheduler.  Each task has a
+period, a priority and an execution time budget.  Tasks are released at exact
+multiples of their period on the System Timer, when several are released the
+most important one runs first (give shorter periods the more important
+priorities for rate monotonic).  A task runs to completion so it must not block.
+
+*/
+
+#pragma once
+#include "common.h"
+
+#define SCHEDULER_PRIORITY_HIGHEST 0
+
+typedef struct Scheduler_Task_Struct {
+	const char *name;
+	void (*task_ptr)(uint32_t argument);
+	uint32_t argument;
+	uint32_t period_us;
+	uint32_t priority;  //Lower numbers run first
+	uint32_t budget_us;
+	uint64_t release_us;
+	uint32_t runs;
+	uint32_t deadline_misses;  //Finished after the next release or a release was skipped
+	uint32_t budget_overruns;
+	uint32_t max_execution_us;
+	uint32_t max_lateness_us;  //Release to start
+	uint64_t total_execution_us;
+	struct Scheduler_Task_Struct *next_ptr;
+} Scheduler_Task;
+
+Error_Returns scheduler_init(void);
+
+Error_Returns scheduler_add_task(Scheduler_Task *task, const char *name, void (*task_ptr)(uint32_t argument),
+		uint32_t argument, uint32_t period_us, uint32_t priority, uint32_t budget_us);
+
+uint32_t scheduler_run_ready(void);
+
+uint64_t scheduler_next_release(void);
+
+void scheduler_reset_stats(void);
+
+void scheduler_dump_stats(void);
@@ -0,0 +1,51 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  stack_usage.h
+
+High water marks for the mode stacks.  init.s paints every stack with a
+pattern before anything runs on them, the deepest point a stack has reached is
+then the lowest word that no longer holds the pattern.  A buffer that was
+reserved on the stack but never written doesn't count, so leave some margin
+over what this reports.
+
+*/
+
+#pragma once
+#include "common.h"
+
+#define STACK_PAINT_PATTERN 0xA5A5A5A5  //Must match STACK_PAINT in init.s
+
+typedef enum {
+	Stack_Mode_SVC,
+	Stack_Mode_IRQ,
+	Stack_Mode_FIQ,
+	Stack_Mode_Abort,
+	Stack_Mode_Undefined,
+	Stack_Mode_Count
+} StackMode;
+
+typedef struct {
+	uint32_t size;
+	uint32_t high_water;  //Most bytes ever in use
+} Stack_Usage;
+
+Error_Returns stack_usage_get(StackMode mode, Stack_Usage *usage_ptr);
+
+void stack_usage_dump(void);
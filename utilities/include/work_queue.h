@@ -0,0 +1,62 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  work_queue.h
+
+Provides a deferred work ("bottom half") facility.  Interrupt handlers do the
+minimum needed to quiet their device and post a work item, the main loop then
+calls work_queue_dispatch() to run the slow part (I2C traffic, filter math)
+with interrupts enabled.
+
+*/
+
+#pragma once
+#include "common.h"
+
+typedef enum {
+	Work_Priority_High,
+	Work_Priority_Normal,
+	Work_Priority_Low,
+	Work_Priority_Count
+} WorkPriority;
+
+/*  A work item is owned by the client and is normally a static.  While an
+	item is queued it is marked pending, posting it again before it has run
+	is coalesced into the one queued entry.
+*/
+
+typedef struct {
+	void (*handler_ptr)(uint32_t argument);
+	uint32_t argument;
+	WorkPriority priority;
+	volatile uint32_t pending;
+} Work_Item;
+
+Error_Returns work_queue_init(void);
+
+Error_Returns work_queue_init_item(Work_Item *item, void (*handler_ptr)(uint32_t argument),
+		uint32_t argument, WorkPriority priority);
+
+Error_Returns work_queue_post(Work_Item *item);
+
+uint32_t work_queue_dispatch(void);
+
+uint32_t work_queue_pending(void);
+
+void work_queue_dump_stats(void);
@@ -0,0 +1,220 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  allocator.c
+
+Implementation of the arena and the fixed block pools.  A free block holds the
+pointer to the next free block in its first word, so a pool needs no memory of
+its own beyond the blocks.  Everything that changes shared state runs with the
+CPU interrupt mask set for a few instructions.
+
+*/
+
+#include "allocator.h"
+#include "log.h"
+
+#define POOL_MINIMUM_ALIGNMENT 8  //Blocks can hold doubles and uint64_t
+
+static unsigned char *arena_next_ptr = NULL_PTR;
+static uint32_t arena_failures = 0;
+static Memory_Pool *pool_list_ptr = NULL_PTR;
+
+/*  Take size bytes from the arena, alignment has to be a power of two.  There
+	is no free, returns NULL_PTR once the arena has run out.
+*/
+
+void *arena_alloc(uint32_t size, uint32_t alignment)
+{
+	void *to_return = NULL_PTR;
+	if ((alignment != 0) && ((alignment & (alignment - 1)) == 0))
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		if (arena_next_ptr == NULL_PTR)
+		{
+			arena_next_ptr = __arena_start__;
+		}
+		uint32_t start = ((uint32_t)arena_next_ptr + alignment - 1) & ~(alignment - 1);
+		//Aligning up can wrap, or go past the end of the arena, check both before the subtraction
+		if ((start >= (uint32_t)arena_next_ptr) && (start <= (uint32_t)__arena_end__) &&
+			(size <= ((uint32_t)__arena_end__ - start)))
+		{
+			arena_next_ptr = (unsigned char *)(start + size);
+			to_return = (void *)start;
+		}
+		else
+		{
+			arena_failures++;
+		}
+		exit_critical_section(saved_cpsr);
+	}
+	return to_return;
+}
+
+uint32_t arena_used(void)
+{
+	uint32_t to_return = 0;
+	if (arena_next_ptr != NULL_PTR)
+	{
+		to_return = (uint32_t)(arena_next_ptr - __arena_start__);
+	}
+	return to_return;
+}
+
+uint32_t arena_available(void)
+{
+	return (uint32_t)(__arena_end__ - __arena_start__) - arena_used();
+}
+
+/*  Set up a pool of block_count blocks.  The blocks are carved out of the
+	arena when storage_ptr is NULL_PTR, otherwise storage_ptr has to point at
+	block_count blocks of block_size rounded up to a multiple of 8.  A pool
+	can only be set up once.
+*/
+
+Error_Returns pool_init(Memory_Pool *pool, const char *name, void *storage_ptr,
+		uint32_t block_size, uint32_t block_count)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if ((pool == NULL_PTR) || (name == NULL_PTR) || (block_size == 0) || (block_count == 0))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		//Rounding up the block size and the total size can both wrap
+		if (block_size > (UINT32_MAX - (POOL_MINIMUM_ALIGNMENT - 1)))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		block_size = (block_size + POOL_MINIMUM_ALIGNMENT - 1) & ~(POOL_MINIMUM_ALIGNMENT - 1);
+		if (block_count > (UINT32_MAX / block_size))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+
+		Memory_Pool *listed_ptr = pool_list_ptr;
+		while ((listed_ptr != NULL_PTR) && (listed_ptr != pool))
+		{
+			listed_ptr = listed_ptr->next_ptr;
+		}
+		if (listed_ptr == pool)
+		{
+			//Linking it in again would make a cycle of the list
+			to_return = RPi_InUse;
+			break;
+		}
+
+		if (storage_ptr == NULL_PTR)
+		{
+			storage_ptr = arena_alloc(block_size * block_count, POOL_MINIMUM_ALIGNMENT);
+			if (storage_ptr == NULL_PTR)
+			{
+				log_string_plus("pool_init: arena exhausted, bytes wanted: ", block_size * block_count);
+				to_return = RPi_InsufficientResources;
+				break;
+			}
+		}
+
+		pool->name = name;
+		pool->storage_ptr = storage_ptr;
+		pool->block_size = block_size;
+		pool->block_count = block_count;
+		pool->in_use = 0;
+		pool->high_water = 0;
+		pool->failures = 0;
+
+		//Thread the free list through the blocks, lowest address first
+		unsigned char *block_ptr = pool->storage_ptr;
+		for (uint32_t block = 0; block < block_count - 1; block++)
+		{
+			*(void **)block_ptr = block_ptr + block_size;
+			block_ptr += block_size;
+		}
+		*(void **)block_ptr = NULL_PTR;
+		pool->free_list_ptr = pool->storage_ptr;
+
+		pool->next_ptr = pool_list_ptr;
+		pool_list_ptr = pool;
+	} while(0);
+	return to_return;
+}
+
+//Returns NULL_PTR when the pool is empty
+void *pool_alloc(Memory_Pool *pool)
+{
+	uint32_t saved_cpsr = enter_critical_section();
+	void *to_return = pool->free_list_ptr;
+	if (to_return != NULL_PTR)
+	{
+		pool->free_list_ptr = *(void **)to_return;
+		if (++pool->in_use > pool->high_water)
+		{
+			pool->high_water = pool->in_use;
+		}
+	}
+	else
+	{
+		pool->failures++;
+	}
+	exit_critical_section(saved_cpsr);
+	return to_return;
+}
+
+/*  Give a block back.  It has to be the start of one of the pool's blocks but
+	that is all that is checked, freeing a block twice will corrupt the pool.
+*/
+
+Error_Returns pool_free(Memory_Pool *pool, void *block_ptr)
+{
+	Error_Returns to_return = RPi_Success;
+	unsigned char *pool_end_ptr = pool->storage_ptr + (pool->block_size * pool->block_count);
+	if (((unsigned char *)block_ptr >= pool->storage_ptr) && ((unsigned char *)block_ptr < pool_end_ptr) &&
+		((((unsigned char *)block_ptr - pool->storage_ptr) % pool->block_size) == 0))
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		*(void **)block_ptr = pool->free_list_ptr;
+		pool->free_list_ptr = block_ptr;
+		pool->in_use--;
+		exit_critical_section(saved_cpsr);
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
+COLD void allocator_dump_stats(void)
+{
+	log_string_plus("Arena bytes used: ", arena_used());
+	log_string_plus("Arena bytes available: ", arena_available());
+	log_string_plus("Arena failures: ", arena_failures);
+	for (Memory_Pool *pool = pool_list_ptr; pool != NULL_PTR; pool = pool->next_ptr)
+	{
+		log_string(pool->name);
+		log_string_plus("  block size: ", pool->block_size);
+		log_string_plus("  blocks: ", pool->block_count);
+		log_string_plus("  in use: ", pool->in_use);
+		log_string_plus("  high water: ", pool->high_water);
+		log_string_plus("  failures: ", pool->failures);
+	}
+}
@@ -0,0 +1,203 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  boot.c
+
+Implementation of the boot phase orchestrator.  Phases are kept in the order
+they were added for the report.  While every running phase is in a delay the
+CPU sleeps until the earliest one is due.
+
+*/
+
+#include "boot.h"
+#include "arm_timer.h"
+#include "system_timer.h"
+#include "log.h"
+
+static Boot_Phase *phase_list_ptr = NULL_PTR;
+static Boot_Phase *phase_tail_ptr = NULL_PTR;
+static uint64_t boot_start_us = 0;
+static uint64_t boot_end_us = 0;
+
+Error_Returns boot_add_phase(Boot_Phase *phase, const char *name,
+		ProtothreadStatus (*thread_ptr)(Protothread *pt, uint32_t argument, Error_Returns *status_ptr),
+		uint32_t argument, uint32_t stage)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((phase != NULL_PTR) && (name != NULL_PTR) && (thread_ptr != NULL_PTR))
+	{
+		phase->name = name;
+		phase->thread_ptr = thread_ptr;
+		phase->argument = argument;
+		phase->stage = stage;
+		phase->status = RPi_Success;
+		phase->finished = 0;
+		phase->steps = 0;
+		phase->busy_us = 0;
+		phase->start_us = 0;
+		phase->end_us = 0;
+		PT_INIT(&phase->thread);
+		phase->next_ptr = NULL_PTR;
+		if (phase_tail_ptr == NULL_PTR)
+		{
+			phase_list_ptr = phase;
+		}
+		else
+		{
+			phase_tail_ptr->next_ptr = phase;
+		}
+		phase_tail_ptr = phase;
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
+/*  Run every phase of one stage until they have all finished.  Returns the
+	status of the first phase to fail, the rest of the stage is still run to
+	the end so the devices aren't left half set up.
+*/
+
+COLD static Error_Returns boot_run_stage(uint32_t stage)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t running;
+	do
+	{
+		uint64_t next_wake = 0;
+		uint32_t yielded = 0;
+		running = 0;
+		for (Boot_Phase *phase = phase_list_ptr; phase != NULL_PTR; phase = phase->next_ptr)
+		{
+			if ((phase->stage != stage) || phase->finished)
+			{
+				continue;
+			}
+			if ((phase->thread.wake_time != 0) && !timer_deadline_reached(phase->thread.wake_time))
+			{
+				//Still in a delay, no need to call it
+				running++;
+				if ((next_wake == 0) || (phase->thread.wake_time < next_wake))
+				{
+					next_wake = phase->thread.wake_time;
+				}
+				continue;
+			}
+
+			uint64_t step_start = timer_now_us();
+			if (phase->steps == 0)
+			{
+				phase->start_us = step_start;
+			}
+			ProtothreadStatus status = phase->thread_ptr(&phase->thread, phase->argument, &phase->status);
+			uint64_t step_end = timer_now_us();
+			phase->steps++;
+			phase->busy_us += (uint32_t)(step_end - step_start);
+
+			if (PT_RUNNING(status))
+			{
+				running++;
+				if (phase->thread.wake_time == 0)
+				{
+					yielded = 1;
+				}
+				else if ((next_wake == 0) || (phase->thread.wake_time < next_wake))
+				{
+					next_wake = phase->thread.wake_time;
+				}
+			}
+			else
+			{
+				phase->finished = 1;
+				phase->end_us = step_end;
+				if ((status == Protothread_Exited) && (phase->status == RPi_Success))
+				{
+					phase->status = RPi_OperationFailed;
+				}
+				if ((phase->status != RPi_Success) && (to_return == RPi_Success))
+				{
+					log_string(phase->name);
+					log_string_plus("boot_run: phase failed ", phase->status);
+					to_return = phase->status;
+				}
+			}
+		}
+		if (running && !yielded && (next_wake != 0))
+		{
+			timer_delay_until_us(next_wake);
+		}
+	} while (running);
+	return to_return;
+}
+
+/*  Run every phase that hasn't been run yet, a stage at a time, lowest stage
+	first.  Stops at the first stage with a failed phase.
+*/
+
+COLD Error_Returns boot_run(void)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t stage = 0;
+	boot_start_us = timer_now_us();
+	while (to_return == RPi_Success)
+	{
+		uint32_t next_stage = 0xFFFFFFFF;
+		for (Boot_Phase *phase = phase_list_ptr; phase != NULL_PTR; phase = phase->next_ptr)
+		{
+			if (!phase->finished && (phase->stage >= stage) && (phase->stage < next_stage))
+			{
+				next_stage = phase->stage;
+			}
+		}
+		if (next_stage == 0xFFFFFFFF)
+		{
+			break;
+		}
+		stage = next_stage;
+		to_return = boot_run_stage(stage);
+		stage++;
+	}
+	boot_end_us = timer_now_us();
+	return to_return;
+}
+
+COLD void boot_dump_report(void)
+{
+	log_string("Boot phases, times in us from the start of boot_run:");
+	for (Boot_Phase *phase = phase_list_ptr; phase != NULL_PTR; phase = phase->next_ptr)
+	{
+		log_string(phase->name);
+		log_string_plus("  stage: ", phase->stage);
+		if (!phase->finished)
+		{
+			log_string("  not run");
+			continue;
+		}
+		log_string_plus("  status: ", phase->status);
+		log_string_plus("  start: ", (uint32_t)(phase->start_us - boot_start_us));
+		log_string_plus("  end: ", (uint32_t)(phase->end_us - boot_start_us));
+		log_string_plus("  busy: ", phase->busy_us);
+		log_string_plus("  steps: ", phase->steps);
+	}
+	log_string_plus("Boot orchestration us: ", (uint32_t)(boot_end_us - boot_start_us));
+	//The System Timer starts counting at power on
+	log_string_plus("Power on to ready ms: ", (uint32_t)(boot_end_us / 1000));
+}
@@ -0,0 +1,291 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  event_loop.c
+
+Implementation of the event driven main loop.  Utilization is worked out over
+one second windows on the System Timer:  busy is everything that isn't spent in
+WFI, which includes interrupt handlers.
+
+*/
+
+#include "event_loop.h"
+#include "scheduler.h"
+#include "work_queue.h"
+#include "arm_timer.h"
+#include "system_timer.h"
+#include "log.h"
+
+#define UTILIZATION_WINDOW 1000000  //In microseconds
+#define PERCENT 100
+
+typedef struct {
+	void (*handler_ptr)(void);
+	const char *name;
+	uint32_t count;
+	uint32_t max_us;
+	uint64_t total_us;
+} Event_Info;
+
+static Event_Info event_info[EVENT_LOOP_MAX_EVENTS];
+static Event_Info work_queue_info;
+static Event_Info scheduler_info;
+static volatile uint32_t pending_events = 0;
+static volatile uint32_t event_loop_running = 0;
+static Soft_Timer wakeup_timer;  //Only here to wake the idle loop for the next task release
+static unsigned char event_loop_initialized = 0;
+
+static uint64_t window_start_us = 0;
+static uint64_t window_idle_us = 0;
+static uint32_t last_utilization = 0;  //Percent busy over the last complete window
+static uint32_t min_utilization = PERCENT;
+static uint32_t max_utilization = 0;
+static uint32_t windows = 0;
+static uint64_t total_idle_us = 0;
+static uint64_t stats_start_us = 0;
+
+static void event_loop_wakeup(uint32_t argument)
+{
+}
+
+static void event_loop_clear_info(Event_Info *info)
+{
+	info->count = 0;
+	info->max_us = 0;
+	info->total_us = 0;
+}
+
+static void event_loop_record(Event_Info *info, uint64_t start_us)
+{
+	uint32_t elapsed = (uint32_t)(timer_now_us() - start_us);
+	info->count++;
+	info->total_us += elapsed;
+	if (elapsed > info->max_us)
+	{
+		info->max_us = elapsed;
+	}
+}
+
+static void event_loop_update_window(uint64_t now)
+{
+	uint64_t window = now - window_start_us;
+	if (window >= UTILIZATION_WINDOW)
+	{
+		uint64_t idle = (window_idle_us > window) ? window : window_idle_us;
+		last_utilization = (uint32_t)(((window - idle) * PERCENT) / window);
+		if (last_utilization < min_utilization)
+		{
+			min_utilization = last_utilization;
+		}
+		if (last_utilization > max_utilization)
+		{
+			max_utilization = last_utilization;
+		}
+		windows++;
+		window_start_us = now;
+		window_idle_us = 0;
+	}
+}
+
+COLD Error_Returns event_loop_init(void)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!event_loop_initialized)
+	{
+		do
+		{
+			to_return = scheduler_init();
+			if (to_return != RPi_Success)
+			{
+				log_string_plus("event_loop_init: scheduler_init failed: ", to_return);
+				break;
+			}
+			for (uint32_t event = 0; event < EVENT_LOOP_MAX_EVENTS; event++)
+			{
+				event_info[event].handler_ptr = NULL_PTR;
+				event_info[event].name = NULL_PTR;
+			}
+			work_queue_info.name = "work queue";
+			scheduler_info.name = "scheduler tasks";
+			arm_timer_init_soft_timer(&wakeup_timer, event_loop_wakeup, 0);
+			pending_events = 0;
+			event_loop_initialized = 1;
+			event_loop_reset_stats();
+		} while(0);
+	}
+	return to_return;
+}
+
+Error_Returns event_loop_register(uint32_t event, void (*handler_ptr)(void), const char *name)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (!event_loop_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((event >= EVENT_LOOP_MAX_EVENTS) || (handler_ptr == NULL_PTR))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		if (event_info[event].handler_ptr != NULL_PTR)
+		{
+			to_return = RPi_InUse;
+			break;
+		}
+		event_loop_clear_info(&event_info[event]);
+		event_info[event].name = name;
+		event_info[event].handler_ptr = handler_ptr;
+	} while(0);
+	return to_return;
+}
+
+//Safe to call from an interrupt handler, signalling an event that is already set does nothing more
+HOT void event_loop_signal(uint32_t event)
+{
+	if (event < EVENT_LOOP_MAX_EVENTS)
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		pending_events |= (1 << event);
+		exit_critical_section(saved_cpsr);
+	}
+}
+
+/*  Run until event_loop_stop is called.  Each pass takes all of the pending
+	events at once, handles them lowest number first, then runs deferred work
+	and released tasks.
+*/
+
+void event_loop_run(void)
+{
+	event_loop_running = 1;
+	while (event_loop_running)
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		uint32_t events = pending_events;
+		pending_events = 0;
+		exit_critical_section(saved_cpsr);
+
+		while (events)
+		{
+			uint32_t event = __builtin_ctz(events);
+			events &= events - 1;
+			if (event_info[event].handler_ptr != NULL_PTR)
+			{
+				uint64_t start = timer_now_us();
+				event_info[event].handler_ptr();
+				event_loop_record(&event_info[event], start);
+			}
+		}
+
+		uint64_t start = timer_now_us();
+		if (work_queue_dispatch() != 0)
+		{
+			event_loop_record(&work_queue_info, start);
+		}
+		start = timer_now_us();
+		if (scheduler_run_ready() != 0)
+		{
+			event_loop_record(&scheduler_info, start);
+		}
+
+		uint64_t next_release = scheduler_next_release();
+		if (next_release != 0)
+		{
+			arm_timer_start_at(&wakeup_timer, next_release);
+		}
+		//Masked so an interrupt between the check and the WFI can't be slept through
+		saved_cpsr = enter_critical_section();
+		if (event_loop_running && (pending_events == 0) && (work_queue_pending() == 0) &&
+			((next_release == 0) || !timer_deadline_reached(next_release)))
+		{
+			uint64_t sleep_start = timer_now_us();
+			wait_for_interrupt();
+			uint64_t slept = timer_now_us() - sleep_start;
+			window_idle_us += slept;
+			total_idle_us += slept;
+		}
+		exit_critical_section(saved_cpsr);
+		event_loop_update_window(timer_now_us());
+	}
+	arm_timer_cancel(&wakeup_timer);
+}
+
+void event_loop_stop(void)
+{
+	event_loop_running = 0;
+}
+
+void event_loop_reset_stats(void)
+{
+	for (uint32_t event = 0; event < EVENT_LOOP_MAX_EVENTS; event++)
+	{
+		event_loop_clear_info(&event_info[event]);
+	}
+	event_loop_clear_info(&work_queue_info);
+	event_loop_clear_info(&scheduler_info);
+	stats_start_us = timer_now_us();
+	window_start_us = stats_start_us;
+	window_idle_us = 0;
+	total_idle_us = 0;
+	min_utilization = PERCENT;
+	max_utilization = 0;
+	windows = 0;
+}
+
+COLD static void event_loop_dump_info(Event_Info *info)
+{
+	log_string(info->name);
+	log_string_plus("  count: ", info->count);
+	if (info->count != 0)
+	{
+		log_string_plus("  avg us: ", (uint32_t)(info->total_us / info->count));
+		log_string_plus("  max us: ", info->max_us);
+		log_string_plus("  total ms: ", (uint32_t)(info->total_us / 1000));
+	}
+}
+
+COLD void event_loop_dump_stats(void)
+{
+	uint64_t elapsed = timer_now_us() - stats_start_us;
+	log_string_plus("CPU utilization % last second: ", last_utilization);
+	if (windows != 0)
+	{
+		log_string_plus("CPU utilization % min: ", min_utilization);
+		log_string_plus("CPU utilization % max: ", max_utilization);
+	}
+	if (elapsed != 0)
+	{
+		uint64_t idle = (total_idle_us > elapsed) ? elapsed : total_idle_us;
+		log_string_plus("CPU utilization % average: ", (uint32_t)(((elapsed - idle) * PERCENT) / elapsed));
+	}
+	log_string_plus("Over ms: ", (uint32_t)(elapsed / 1000));
+	for (uint32_t event = 0; event < EVENT_LOOP_MAX_EVENTS; event++)
+	{
+		if (event_info[event].handler_ptr != NULL_PTR)
+		{
+			event_loop_dump_info(&event_info[event]);
+		}
+	}
+	event_loop_dump_info(&work_queue_info);
+	event_loop_dump_info(&scheduler_info);
+}
@@ -28,6 +28,7 @@ goes is controlled by a -D flag specified in the makefile.
 #include "aux_peripherals.h"
 #include "gpio.h"
 #include "arm_timer.h"
+#include "mem_ops.h"
 #include "log.h"
 
 #define TIMER_VAL 600000
@@ -164,7 +165,7 @@ void log_indicate_system_error(void)
 	}
 }
 
-void log_cpu_registers(Exception_Types error_source, uint32_t stack_pointer, uint32_t link_return)
+COLD void log_cpu_registers(Exception_Types error_source, uint32_t stack_pointer, uint32_t link_return)
 {
 	log_string(" ");
 	switch (error_source)
@@ -217,7 +218,7 @@ void log_cpu_registers(Exception_Types error_source, uint32_t stack_pointer, uin
 	log_indicate_system_error();
 }
 
-Error_Returns log_init(void)
+COLD Error_Returns log_init(void)
 {
 	Error_Returns to_return = gpio_init();
 	if (to_return == RPi_Success)
@@ -289,7 +290,7 @@ void log_putchar(char c)
 	LOG_CHAR(c);
 }
 
-void log_dump_buffer(void)
+COLD void log_dump_buffer(void)
 {
 	/* If the buffer rolled over we could just skip over any
 	partial message, but since we are doing this for debugging purposes
@@ -333,7 +334,7 @@ void log_dump_buffer(void)
 	}
 }
 
-void log_dump_and_clear(void)
+COLD void log_dump_and_clear(void)
 {
 	log_dump_buffer();
 
@@ -342,11 +343,8 @@ void log_dump_and_clear(void)
 	 * buffer indices.
 	 */
 
-	for (uint32_t index = 0; index < LOG_BUFFER_SIZE; index++)
-		{
-		log_buffer[index] = 0;
-		interrupt_log_buffer[index] = 0;
-		}
+	memclr(log_buffer, LOG_BUFFER_SIZE);
+	memclr(interrupt_log_buffer, LOG_BUFFER_SIZE);
 	buffer_rolled_over = 0;
 	buffer_write_index = 0;
 
@@ -0,0 +1,130 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  mem_benchmark.c
+
+Cycle counts for the memory routines against the byte at a time loops they
+replaced.  Each kernel is run a few times per size and the best pass is kept,
+the first one pays for the cache misses.  The byte loops go through volatile
+pointers, otherwise gcc recognizes them and calls memcpy or memset instead.
+
+*/
+
+#include "mem_ops.h"
+#include "allocator.h"
+#include "log.h"
+
+#define MEM_BENCHMARK_MIN_SIZE 16
+#define MEM_BENCHMARK_MAX_SIZE 0x10000
+#define MEM_BENCHMARK_PASSES 4
+#define MEM_BENCHMARK_ALIGNMENT 32
+#define PMU_CYCLE_DIVIDER 0x08
+
+typedef void (*Mem_Kernel)(unsigned char *dst, unsigned char *src, uint32_t length);
+
+static unsigned char *source_buffer = NULL_PTR;
+static unsigned char *destination_buffer = NULL_PTR;
+
+static void kernel_memcpy(unsigned char *dst, unsigned char *src, uint32_t length)
+{
+	memcpy(dst, src, length);
+}
+
+//Source one byte off so memcpy has to shift every word into place
+static void kernel_memcpy_unaligned(unsigned char *dst, unsigned char *src, uint32_t length)
+{
+	memcpy(dst, src + 1, length);
+}
+
+static void kernel_byte_copy(unsigned char *dst, unsigned char *src, uint32_t length)
+{
+	volatile unsigned char *dst_ptr = dst;
+	volatile unsigned char *src_ptr = src;
+	for (uint32_t index = 0; index < length; index++)
+	{
+		dst_ptr[index] = src_ptr[index];
+	}
+}
+
+static void kernel_memset(unsigned char *dst, unsigned char *src, uint32_t length)
+{
+	memset(dst, 0, length);
+}
+
+static void kernel_byte_set(unsigned char *dst, unsigned char *src, uint32_t length)
+{
+	volatile unsigned char *dst_ptr = dst;
+	for (uint32_t index = 0; index < length; index++)
+	{
+		dst_ptr[index] = 0;
+	}
+}
+
+COLD static uint32_t mem_benchmark_time(Mem_Kernel kernel, uint32_t length)
+{
+	uint32_t best_cycles = 0xFFFFFFFF;
+	for (uint32_t pass = 0; pass < MEM_BENCHMARK_PASSES; pass++)
+	{
+		uint32_t start_cycles = read_cycle_counter();
+		kernel(destination_buffer, source_buffer, length);
+		uint32_t cycles = read_cycle_counter() - start_cycles;
+		if (cycles < best_cycles)
+		{
+			best_cycles = cycles;
+		}
+	}
+	return best_cycles;
+}
+
+COLD Error_Returns mem_ops_benchmark(void)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (source_buffer == NULL_PTR)
+		{
+			//+ MEM_BENCHMARK_ALIGNMENT leaves room for the unaligned source
+			source_buffer = arena_alloc(MEM_BENCHMARK_MAX_SIZE + MEM_BENCHMARK_ALIGNMENT,
+				MEM_BENCHMARK_ALIGNMENT);
+			destination_buffer = arena_alloc(MEM_BENCHMARK_MAX_SIZE, MEM_BENCHMARK_ALIGNMENT);
+			if ((source_buffer == NULL_PTR) || (destination_buffer == NULL_PTR))
+			{
+				log_string("mem_ops_benchmark:  no room in the arena");
+				source_buffer = NULL_PTR;
+				to_return = RPi_InsufficientResources;
+				break;
+			}
+		}
+
+		enable_cycle_counter();
+		//profile_init may have the cycle counter counting every 64th cycle
+		uint32_t cycle_scale = (read_pmu_control() & PMU_CYCLE_DIVIDER) ? 64 : 1;
+		for (uint32_t length = MEM_BENCHMARK_MIN_SIZE; length <= MEM_BENCHMARK_MAX_SIZE; length *= 4)
+		{
+			log_string_plus("Bytes: ", length);
+			log_string_plus("  memcpy cycles: ", mem_benchmark_time(kernel_memcpy, length) * cycle_scale);
+			log_string_plus("  memcpy unaligned cycles: ",
+				mem_benchmark_time(kernel_memcpy_unaligned, length) * cycle_scale);
+			log_string_plus("  byte copy cycles: ", mem_benchmark_time(kernel_byte_copy, length) * cycle_scale);
+			log_string_plus("  memset cycles: ", mem_benchmark_time(kernel_memset, length) * cycle_scale);
+			log_string_plus("  byte set cycles: ", mem_benchmark_time(kernel_byte_set, length) * cycle_scale);
+		}
+	} while(0);
+	return to_return;
+}
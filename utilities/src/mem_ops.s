@@ -0,0 +1,229 @@
+;@ Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+;@
+;@ Permission is hereby granted, free of charge, to any person obtaining
+;@ a copy of this software and associated documentation files (the "Software"),
+;@ to deal in the Software without restriction, including without limitation
+;@ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+;@ and/or sell copies of the Software, and to permit persons to whom the Software
+;@ is furnished to do so, subject to the following conditions:
+;@
+;@ The above copyright notice and this permission notice shall be included in all
+;@ copies or substantial portions of the Software.
+;@
+;@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+;@ INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+;@ PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+;@ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+;@ OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+;@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+;@
+;@ File:  mem_ops.s
+;@
+;@ memcpy, memmove, memset and memclr for the ARM1176.  We link with -nostdlib
+;@ so these are the only copies there are, gcc also calls them for structure
+;@ copies and initializers.  Anything 16 bytes or longer is done with the
+;@ destination word aligned, 32 bytes per ldm/stm and a preload a couple of
+;@ lines ahead of the source.  A source that can't be word aligned along with
+;@ the destination is read as aligned words and shifted into place rather than
+;@ falling back to bytes (the core's unaligned access support is off).
+
+.equ MEM_BURST, 32
+.equ MEM_SMALL, 16
+
+;@ Finish a copy with the source misaligned by \offset bytes.  r0 is word
+;@ aligned, r1 is the word after the one held in r3 and r2 the bytes left.
+.macro copy_shifted offset
+1:  subs r2,r2,#16
+    blo 2f
+    pld [r1,#MEM_BURST]
+    ldmia r1!,{r4,r5,r6,r7}
+    mov r3,r3,lsr #(8 * \offset)
+    orr r3,r3,r4,lsl #(32 - (8 * \offset))
+    mov r4,r4,lsr #(8 * \offset)
+    orr r4,r4,r5,lsl #(32 - (8 * \offset))
+    mov r5,r5,lsr #(8 * \offset)
+    orr r5,r5,r6,lsl #(32 - (8 * \offset))
+    mov r6,r6,lsr #(8 * \offset)
+    orr r6,r6,r7,lsl #(32 - (8 * \offset))
+    stmia r0!,{r3,r4,r5,r6}
+    mov r3,r7
+    b 1b
+2:  add r2,r2,#16
+3:  subs r2,r2,#4
+    blo 4f
+    ldr r4,[r1],#4
+    mov r3,r3,lsr #(8 * \offset)
+    orr r3,r3,r4,lsl #(32 - (8 * \offset))
+    str r3,[r0],#4
+    mov r3,r4
+    b 3b
+4:  add r2,r2,#4
+    ;@ back to the first source byte not yet copied
+    sub r1,r1,#(4 - \offset)
+    b copy_bytes
+.endm
+
+;@ void *memcpy(void *dst, const void *src, size_t n)
+.globl memcpy
+memcpy:
+    cmp r2,#MEM_SMALL
+    blo copy_small
+    push {r0,r4,r5,r6,r7,r8,r9,r10,r11,lr}
+    pld [r1]
+copy_align_dst:
+    tst r0,#3
+    beq copy_dst_aligned
+    ldrb r3,[r1],#1
+    strb r3,[r0],#1
+    sub r2,r2,#1
+    b copy_align_dst
+copy_dst_aligned:
+    ands r12,r1,#3
+    beq copy_aligned
+    bic r1,r1,#3
+    ldr r3,[r1],#4
+    cmp r12,#2
+    beq copy_shift_2
+    bhi copy_shift_3
+    copy_shifted 1
+copy_shift_2:
+    copy_shifted 2
+copy_shift_3:
+    copy_shifted 3
+
+copy_aligned:
+    subs r2,r2,#MEM_BURST
+    blo copy_words
+copy_burst:
+    pld [r1,#(MEM_BURST * 2)]
+    ldmia r1!,{r3,r4,r5,r6,r7,r8,r9,r10}
+    stmia r0!,{r3,r4,r5,r6,r7,r8,r9,r10}
+    subs r2,r2,#MEM_BURST
+    bhs copy_burst
+copy_words:
+    add r2,r2,#MEM_BURST
+1:  subs r2,r2,#4
+    blo 2f
+    ldr r3,[r1],#4
+    str r3,[r0],#4
+    b 1b
+2:  add r2,r2,#4
+copy_bytes:
+    cmp r2,#0
+    beq copy_done
+1:  ldrb r3,[r1],#1
+    strb r3,[r0],#1
+    subs r2,r2,#1
+    bne 1b
+copy_done:
+    pop {r0,r4,r5,r6,r7,r8,r9,r10,r11,pc}
+
+;@ Too short for the setup to pay off, r0 has to come back unchanged
+copy_small:
+    mov r12,r0
+    cmp r2,#0
+    beq 2f
+1:  ldrb r3,[r1],#1
+    strb r3,[r0],#1
+    subs r2,r2,#1
+    bne 1b
+2:  mov r0,r12
+    bx lr
+
+;@ void *memmove(void *dst, const void *src, size_t n)
+;@ If dst - src (unsigned) is at least n the destination doesn't start inside
+;@ the source and a forward copy is safe, memcpy only ever reads ahead of where
+;@ it writes.  Otherwise copy from the top down.
+.globl memmove
+memmove:
+    sub r3,r0,r1
+    cmp r3,r2
+    bhs memcpy
+    push {r0,r4,r5,r6,r7,r8,r9,r10,r11,lr}
+    add r0,r0,r2
+    add r1,r1,r2
+    cmp r2,#MEM_SMALL
+    blo move_back_bytes
+    ;@ Only bursts when both ends can be word aligned together
+    eor r3,r0,r1
+    tst r3,#3
+    bne move_back_bytes
+1:  tst r0,#3
+    beq 2f
+    ldrb r3,[r1,#-1]!
+    strb r3,[r0,#-1]!
+    sub r2,r2,#1
+    b 1b
+2:  subs r2,r2,#MEM_BURST
+    blo 3f
+    pld [r1,#-(MEM_BURST * 2)]
+    ldmdb r1!,{r3,r4,r5,r6,r7,r8,r9,r10}
+    stmdb r0!,{r3,r4,r5,r6,r7,r8,r9,r10}
+    b 2b
+3:  add r2,r2,#MEM_BURST
+4:  subs r2,r2,#4
+    blo 5f
+    ldr r3,[r1,#-4]!
+    str r3,[r0,#-4]!
+    b 4b
+5:  add r2,r2,#4
+move_back_bytes:
+    cmp r2,#0
+    beq move_done
+1:  ldrb r3,[r1,#-1]!
+    strb r3,[r0,#-1]!
+    subs r2,r2,#1
+    bne 1b
+move_done:
+    pop {r0,r4,r5,r6,r7,r8,r9,r10,r11,pc}
+
+;@ void memclr(void *dst, size_t n)
+.globl memclr
+memclr:
+    mov r2,r1
+    mov r1,#0
+    ;@ fall through to memset
+
+;@ void *memset(void *dst, int c, size_t n)
+.globl memset
+memset:
+    and r1,r1,#0xFF
+    orr r1,r1,r1,lsl #8
+    orr r1,r1,r1,lsl #16
+    mov r12,r0
+    cmp r2,#MEM_SMALL
+    blo set_bytes
+    push {r4,r5,r6,r7,r8,r9}
+set_align_dst:
+    tst r12,#3
+    beq set_dst_aligned
+    strb r1,[r12],#1
+    sub r2,r2,#1
+    b set_align_dst
+set_dst_aligned:
+    mov r3,r1
+    mov r4,r1
+    mov r5,r1
+    mov r6,r1
+    mov r7,r1
+    mov r8,r1
+    mov r9,r1
+    subs r2,r2,#MEM_BURST
+    blo 2f
+1:  stmia r12!,{r1,r3,r4,r5,r6,r7,r8,r9}
+    subs r2,r2,#MEM_BURST
+    bhs 1b
+2:  add r2,r2,#MEM_BURST
+3:  subs r2,r2,#4
+    blo 4f
+    str r1,[r12],#4
+    b 3b
+4:  add r2,r2,#4
+    pop {r4,r5,r6,r7,r8,r9}
+set_bytes:
+    cmp r2,#0
+    beq 2f
+1:  strb r1,[r12],#1
+    subs r2,r2,#1
+    bne 1b
+2:  bx lr
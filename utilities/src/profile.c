@@ -0,0 +1,230 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  profile.c
+
+Implementation of the ARM1176 performance monitor profiling.  The three counters
+are only 32 bits and the events can wrap one in a few seconds, so they are
+extended to 64 bits in software using the overflow flags in the control register.
+That only works if the counters are read (any probe start or stop will do) at
+least once per wrap.
+
+Note:  The cycle counter is shared with the interrupt profiler, so the divide by
+64 option scales its numbers too.
+
+*/
+
+#include "profile.h"
+#include "log.h"
+
+#define PMU_ENABLE				0x01
+#define PMU_CYCLE_DIVIDER		0x08
+#define PMU_EVENT_0_OVERFLOW	0x100
+#define PMU_EVENT_1_OVERFLOW	0x200
+#define PMU_CYCLE_OVERFLOW		0x400
+#define PMU_OVERFLOW_FLAGS		(PMU_EVENT_0_OVERFLOW | PMU_EVENT_1_OVERFLOW | PMU_CYCLE_OVERFLOW)
+#define PMU_EVENT_1_SHIFT		12
+#define PMU_EVENT_0_SHIFT		20
+#define COUNTER_TOP_BIT			0x80000000
+#define COUNTER_WRAP			0x100000000ULL
+
+typedef struct {
+	uint64_t cycles;
+	uint64_t event_0;
+	uint64_t event_1;
+} Profile_Counters;
+
+static uint64_t cycles_high = 0;
+static uint64_t event_0_high = 0;
+static uint64_t event_1_high = 0;
+static uint32_t overflow_count = 0;
+static uint32_t cycle_scale = 1;
+static ProfileEvent current_event_0 = Profile_Event_ICache_Miss;
+static ProfileEvent current_event_1 = Profile_Event_DCache_Miss;
+static Profile_Probe *probe_list_ptr = NULL_PTR;
+static unsigned char profile_initialized = 0;
+
+/*  A counter that shows its overflow flag has wrapped since the last look.  If
+	its value still has the top bit set it was read before the wrap, so it
+	belongs with the old high part.
+*/
+
+static uint64_t profile_extend(uint32_t value, uint32_t overflowed, uint64_t *high_ptr)
+{
+	uint64_t to_return;
+	if (overflowed)
+	{
+		to_return = *high_ptr + value;
+		*high_ptr += COUNTER_WRAP;
+		if (!(value & COUNTER_TOP_BIT))
+		{
+			to_return += COUNTER_WRAP;
+		}
+		overflow_count++;
+	}
+	else
+	{
+		to_return = *high_ptr + value;
+	}
+	return to_return;
+}
+
+static void profile_read_counters(Profile_Counters *counters)
+{
+	uint32_t saved_cpsr = enter_critical_section();
+	uint32_t cycles = read_cycle_counter();
+	uint32_t event_0 = read_event_counter_0();
+	uint32_t event_1 = read_event_counter_1();
+	uint32_t control = read_pmu_control();
+	if (control & PMU_OVERFLOW_FLAGS)
+	{
+		//Writing a 1 clears a flag, the event selection has to be written back as is
+		write_pmu_control(control);
+	}
+	counters->cycles = profile_extend(cycles, control & PMU_CYCLE_OVERFLOW, &cycles_high);
+	counters->event_0 = profile_extend(event_0, control & PMU_EVENT_0_OVERFLOW, &event_0_high);
+	counters->event_1 = profile_extend(event_1, control & PMU_EVENT_1_OVERFLOW, &event_1_high);
+	exit_critical_section(saved_cpsr);
+}
+
+/*  Select what the two event counters count and whether the cycle counter
+	counts every cycle or every 64th.  The counters aren't reset (the interrupt
+	profiler is using the cycle counter) so probe totals carry on, call
+	profile_reset if the events are changed.
+*/
+
+Error_Returns profile_init(ProfileEvent event_0, ProfileEvent event_1, uint32_t divide_by_64)
+{
+	uint32_t saved_cpsr = enter_critical_section();
+	uint32_t control = PMU_ENABLE | PMU_OVERFLOW_FLAGS |
+		((uint32_t)event_0 << PMU_EVENT_0_SHIFT) | ((uint32_t)event_1 << PMU_EVENT_1_SHIFT);
+	if (divide_by_64)
+	{
+		control |= PMU_CYCLE_DIVIDER;
+	}
+	write_pmu_control(control);
+	cycles_high = 0;
+	event_0_high = 0;
+	event_1_high = 0;
+	current_event_0 = event_0;
+	current_event_1 = event_1;
+	cycle_scale = divide_by_64 ? 64 : 1;
+	profile_initialized = 1;
+	exit_critical_section(saved_cpsr);
+	return RPi_Success;
+}
+
+Error_Returns profile_add_probe(Profile_Probe *probe, const char *name)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((probe != NULL_PTR) && (name != NULL_PTR))
+	{
+		probe->name = name;
+		probe->count = 0;
+		probe->min_cycles = 0xFFFFFFFF;
+		probe->max_cycles = 0;
+		probe->total_cycles = 0;
+		probe->total_event_0 = 0;
+		probe->total_event_1 = 0;
+		probe->next_ptr = probe_list_ptr;
+		probe_list_ptr = probe;
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
+void profile_start(Profile_Probe *probe)
+{
+	Profile_Counters counters;
+	profile_read_counters(&counters);
+	probe->start_cycles = counters.cycles;
+	probe->start_event_0 = counters.event_0;
+	probe->start_event_1 = counters.event_1;
+}
+
+void profile_stop(Profile_Probe *probe)
+{
+	Profile_Counters counters;
+	profile_read_counters(&counters);
+	uint64_t cycles = counters.cycles - probe->start_cycles;
+	uint32_t clipped_cycles = (cycles > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)cycles;
+	probe->count++;
+	probe->total_cycles += cycles;
+	probe->total_event_0 += counters.event_0 - probe->start_event_0;
+	probe->total_event_1 += counters.event_1 - probe->start_event_1;
+	if (clipped_cycles < probe->min_cycles)
+	{
+		probe->min_cycles = clipped_cycles;
+	}
+	if (clipped_cycles > probe->max_cycles)
+	{
+		probe->max_cycles = clipped_cycles;
+	}
+}
+
+void profile_scope_exit(Profile_Probe **probe_ptr)
+{
+	profile_stop(*probe_ptr);
+}
+
+void profile_reset(void)
+{
+	for (Profile_Probe *probe = probe_list_ptr; probe != NULL_PTR; probe = probe->next_ptr)
+	{
+		probe->count = 0;
+		probe->min_cycles = 0xFFFFFFFF;
+		probe->max_cycles = 0;
+		probe->total_cycles = 0;
+		probe->total_event_0 = 0;
+		probe->total_event_1 = 0;
+	}
+	overflow_count = 0;
+}
+
+/*  Cycle numbers are in counter units, multiply by the scale to get cycles if
+	the divider is on.
+*/
+
+COLD void profile_dump(void)
+{
+	if (!profile_initialized)
+	{
+		log_string("profile_dump: PMU events not selected, call profile_init");
+	}
+	log_string_plus("Profile event 0: ", current_event_0);
+	log_string_plus("Profile event 1: ", current_event_1);
+	log_string_plus("Cycle scale: ", cycle_scale);
+	log_string_plus("Counter overflows: ", overflow_count);
+	for (Profile_Probe *probe = probe_list_ptr; probe != NULL_PTR; probe = probe->next_ptr)
+	{
+		log_string(probe->name);
+		log_string_plus("  count: ", probe->count);
+		if (probe->count != 0)
+		{
+			log_string_plus("  min cycles: ", probe->min_cycles);
+			log_string_plus("  avg cycles: ", (uint32_t)(probe->total_cycles / probe->count));
+			log_string_plus("  max cycles: ", probe->max_cycles);
+			log_string_plus("  avg event 0: ", (uint32_t)(probe->total_event_0 / probe->count));
+			log_string_plus("  avg event 1: ", (uint32_t)(probe->total_event_1 / probe->count));
+		}
+	}
+}
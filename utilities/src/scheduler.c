@@ -0,0 +1,220 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  scheduler.c
+
+Implementation of the cooperative task scheduler.  The task list is kept in
+priority order (ties in period order) so picking the next task is a walk down
+the list to the first one that is released.
+
+*/
+
+#include "scheduler.h"
+#include "work_queue.h"
+#include "arm_timer.h"
+#include "system_timer.h"
+#include "log.h"
+
+static Scheduler_Task *task_list_ptr = NULL_PTR;
+static unsigned char scheduler_initialized = 0;
+
+COLD Error_Returns scheduler_init(void)
+{
+	Error_Returns to_return = RPi_Success;
+	if (!scheduler_initialized)
+	{
+		do
+		{
+			to_return = arm_timer_init();
+			if (to_return != RPi_Success)
+			{
+				log_string_plus("scheduler_init: arm_timer_init failed: ", to_return);
+				break;
+			}
+			to_return = work_queue_init();
+			if (to_return != RPi_Success)
+			{
+				log_string_plus("scheduler_init: work_queue_init failed: ", to_return);
+				break;
+			}
+			task_list_ptr = NULL_PTR;
+			scheduler_initialized = 1;
+		} while(0);
+	}
+	return to_return;
+}
+
+/*  The first release is one period from now.  Tasks are static, there is no
+	remove, and a task can only be added once.
+*/
+
+Error_Returns scheduler_add_task(Scheduler_Task *task, const char *name, void (*task_ptr)(uint32_t argument),
+		uint32_t argument, uint32_t period_us, uint32_t priority, uint32_t budget_us)
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (!scheduler_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((task == NULL_PTR) || (task_ptr == NULL_PTR) || (period_us == 0))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+
+		Scheduler_Task **insert_ptr = &task_list_ptr;
+		while ((*insert_ptr != NULL_PTR) && (*insert_ptr != task))
+		{
+			insert_ptr = &(*insert_ptr)->next_ptr;
+		}
+		if (*insert_ptr == task)
+		{
+			//Linking it in again would make a cycle of the list
+			to_return = RPi_InUse;
+			break;
+		}
+
+		task->name = name;
+		task->task_ptr = task_ptr;
+		task->argument = argument;
+		task->period_us = period_us;
+		task->priority = priority;
+		task->budget_us = budget_us;
+		task->release_us = timer_now_us() + period_us;
+		task->runs = 0;
+		task->deadline_misses = 0;
+		task->budget_overruns = 0;
+		task->max_execution_us = 0;
+		task->max_lateness_us = 0;
+		task->total_execution_us = 0;
+
+		insert_ptr = &task_list_ptr;
+		while ((*insert_ptr != NULL_PTR) && (((*insert_ptr)->priority < priority) ||
+			(((*insert_ptr)->priority == priority) && ((*insert_ptr)->period_us <= period_us))))
+		{
+			insert_ptr = &(*insert_ptr)->next_ptr;
+		}
+		task->next_ptr = *insert_ptr;
+		*insert_ptr = task;
+	} while(0);
+	return to_return;
+}
+
+/*  Run the most important released task, then look again from the top, until
+	nothing is released.  Returns the number of tasks run.
+*/
+
+HOT uint32_t scheduler_run_ready(void)
+{
+	uint32_t to_return = 0;
+	Scheduler_Task *task = task_list_ptr;
+	while (task != NULL_PTR)
+	{
+		uint64_t start = timer_now_us();
+		if (start < task->release_us)
+		{
+			task = task->next_ptr;
+			continue;
+		}
+
+		uint32_t lateness = (uint32_t)(start - task->release_us);
+		if (lateness > task->max_lateness_us)
+		{
+			task->max_lateness_us = lateness;
+		}
+		task->task_ptr(task->argument);
+		uint64_t finish = timer_now_us();
+		uint32_t execution = (uint32_t)(finish - start);
+
+		task->runs++;
+		task->total_execution_us += execution;
+		if (execution > task->max_execution_us)
+		{
+			task->max_execution_us = execution;
+		}
+		if ((task->budget_us != 0) && (execution > task->budget_us))
+		{
+			task->budget_overruns++;
+		}
+
+		//Releases stay on the original grid, a release that has already gone by is dropped
+		task->release_us += task->period_us;
+		if (finish > task->release_us)
+		{
+			task->deadline_misses++;
+			while (task->release_us <= finish)
+			{
+				task->release_us += task->period_us;
+			}
+		}
+		to_return++;
+		task = task_list_ptr;
+	}
+	return to_return;
+}
+
+//The earliest release of any task, zero if there are no tasks
+uint64_t scheduler_next_release(void)
+{
+	uint64_t to_return = 0;
+	for (Scheduler_Task *task = task_list_ptr; task != NULL_PTR; task = task->next_ptr)
+	{
+		if ((to_return == 0) || (task->release_us < to_return))
+		{
+			to_return = task->release_us;
+		}
+	}
+	return to_return;
+}
+
+void scheduler_reset_stats(void)
+{
+	for (Scheduler_Task *task = task_list_ptr; task != NULL_PTR; task = task->next_ptr)
+	{
+		task->runs = 0;
+		task->deadline_misses = 0;
+		task->budget_overruns = 0;
+		task->max_execution_us = 0;
+		task->max_lateness_us = 0;
+		task->total_execution_us = 0;
+	}
+}
+
+COLD void scheduler_dump_stats(void)
+{
+	for (Scheduler_Task *task = task_list_ptr; task != NULL_PTR; task = task->next_ptr)
+	{
+		log_string(task->name);
+		log_string_plus("  period us: ", task->period_us);
+		log_string_plus("  priority: ", task->priority);
+		log_string_plus("  runs: ", task->runs);
+		if (task->runs != 0)
+		{
+			log_string_plus("  avg execution us: ", (uint32_t)(task->total_execution_us / task->runs));
+		}
+		log_string_plus("  max execution us: ", task->max_execution_us);
+		log_string_plus("  budget us: ", task->budget_us);
+		log_string_plus("  budget overruns: ", task->budget_overruns);
+		log_string_plus("  max release lateness us: ", task->max_lateness_us);
+		log_string_plus("  deadline misses: ", task->deadline_misses);
+	}
+}
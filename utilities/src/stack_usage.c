@@ -0,0 +1,91 @@
+/*Copyright 2021 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  stack_usage.c
+
+Implementation of the stack high water marks.  The stack bounds are the
+symbols memmap defines, the search starts at the limit (the deepest a stack
+can go) and walks up to the first word that has been written.
+
+*/
+
+#include "stack_usage.h"
+#include "log.h"
+
+extern unsigned char __svc_stack_limit__[];
+extern unsigned char __irq_stack_limit__[];
+extern unsigned char __irq_stack_top__[];
+extern unsigned char __fiq_stack_limit__[];
+extern unsigned char __fiq_stack_top__[];
+extern unsigned char __abt_stack_limit__[];
+extern unsigned char __abt_stack_top__[];
+extern unsigned char __und_stack_limit__[];
+extern unsigned char __und_stack_top__[];
+
+typedef struct {
+	const char *name;
+	unsigned char *limit_ptr;
+	unsigned char *top_ptr;
+} Stack_Bounds;
+
+static const Stack_Bounds stack_bounds[Stack_Mode_Count] = {
+	{"SVC", __svc_stack_limit__, __svc_stack_top__},
+	{"IRQ", __irq_stack_limit__, __irq_stack_top__},
+	{"FIQ", __fiq_stack_limit__, __fiq_stack_top__},
+	{"Abort", __abt_stack_limit__, __abt_stack_top__},
+	{"Undefined", __und_stack_limit__, __und_stack_top__}
+};
+
+COLD Error_Returns stack_usage_get(StackMode mode, Stack_Usage *usage_ptr)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((mode < Stack_Mode_Count) && (usage_ptr != NULL_PTR))
+	{
+		uint32_t *word_ptr = (uint32_t *)stack_bounds[mode].limit_ptr;
+		uint32_t *top_ptr = (uint32_t *)stack_bounds[mode].top_ptr;
+		while ((word_ptr < top_ptr) && (*word_ptr == STACK_PAINT_PATTERN))
+		{
+			word_ptr++;
+		}
+		usage_ptr->size = (uint32_t)(top_ptr - (uint32_t *)stack_bounds[mode].limit_ptr) * sizeof(uint32_t);
+		usage_ptr->high_water = (uint32_t)(top_ptr - word_ptr) * sizeof(uint32_t);
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
+COLD void stack_usage_dump(void)
+{
+	Stack_Usage usage;
+	for (uint32_t mode = 0; mode < Stack_Mode_Count; mode++)
+	{
+		stack_usage_get((StackMode)mode, &usage);
+		log_string(stack_bounds[mode].name);
+		log_string_plus("  size: ", usage.size);
+		log_string_plus("  high water: ", usage.high_water);
+		log_string_plus("  never used: ", usage.size - usage.high_water);
+		if (usage.high_water == usage.size)
+		{
+			log_string("  paint gone at the limit, the stack may have overflowed");
+		}
+	}
+}
@@ -0,0 +1,199 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  work_queue.c
+
+Implementation of the deferred work queue.  There is one ring of work item
+pointers per priority.  Each ring has a single producer side (the post, which
+runs with the CPU interrupt mask set for a handful of instructions so it can be
+called from an interrupt handler or from the main loop) and a single consumer
+side (the dispatcher) that never masks interrupts.  The indices are free running
+and only ever written by their owning side so the dispatcher can drain a ring
+while handlers keep posting to it.
+
+*/
+
+#include "work_queue.h"
+#include "log.h"
+
+#define WORK_QUEUE_SIZE 16  //Must be a power of two
+#define WORK_QUEUE_MASK (WORK_QUEUE_SIZE - 1)
+
+typedef struct {
+	Work_Item *items[WORK_QUEUE_SIZE];
+	volatile uint32_t write_index;
+	volatile uint32_t read_index;
+	uint32_t posted;
+	uint32_t coalesced;
+	uint32_t dropped;
+	uint32_t max_depth;
+} Work_Ring;
+
+static Work_Ring work_rings[Work_Priority_Count];
+static unsigned char work_queue_initialized = 0;
+
+COLD Error_Returns work_queue_init(void)
+{
+	if (!work_queue_initialized)
+	{
+		for (uint32_t priority = 0; priority < Work_Priority_Count; priority++)
+		{
+			work_rings[priority].write_index = 0;
+			work_rings[priority].read_index = 0;
+			work_rings[priority].posted = 0;
+			work_rings[priority].coalesced = 0;
+			work_rings[priority].dropped = 0;
+			work_rings[priority].max_depth = 0;
+		}
+		work_queue_initialized = 1;
+	}
+	return RPi_Success;
+}
+
+/*  Set up an item before it is first posted.  The item has to start out zeroed
+	(a static is), one that is still queued can't be set up again.
+*/
+
+Error_Returns work_queue_init_item(Work_Item *item, void (*handler_ptr)(uint32_t argument),
+		uint32_t argument, WorkPriority priority)
+{
+	Error_Returns to_return = RPi_Success;
+	if ((item != NULL_PTR) && (handler_ptr != NULL_PTR) && (priority < Work_Priority_Count))
+	{
+		uint32_t saved_cpsr = enter_critical_section();
+		if (item->pending)
+		{
+			//Resetting it would leave it in the ring to be run a second time
+			to_return = RPi_InUse;
+		}
+		else
+		{
+			item->handler_ptr = handler_ptr;
+			item->argument = argument;
+			item->priority = priority;
+		}
+		exit_critical_section(saved_cpsr);
+	}
+	else
+	{
+		to_return = RPi_InvalidParam;
+	}
+	return to_return;
+}
+
+/*  Queue a work item.  This is safe to call from an interrupt handler, it never
+	blocks and never touches the hardware.  If the item is already queued the
+	request is folded into the queued entry.
+*/
+
+HOT Error_Returns work_queue_post(Work_Item *item)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t saved_cpsr = enter_critical_section();
+	do
+	{
+		if (!work_queue_initialized)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((item == NULL_PTR) || (item->priority >= Work_Priority_Count))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+
+		Work_Ring *ring = &work_rings[item->priority];
+		if (item->pending)
+		{
+			ring->coalesced++;
+			break;
+		}
+
+		uint32_t depth = ring->write_index - ring->read_index;
+		if (depth >= WORK_QUEUE_SIZE)
+		{
+			ring->dropped++;
+			to_return = RPi_InsufficientResources;
+			break;
+		}
+
+		item->pending = 1;
+		ring->items[ring->write_index & WORK_QUEUE_MASK] = item;
+		ring->write_index++;  //Publish only after the slot is filled in
+		ring->posted++;
+		if (++depth > ring->max_depth)
+		{
+			ring->max_depth = depth;
+		}
+	} while(0);
+	exit_critical_section(saved_cpsr);
+	return to_return;
+}
+
+/*  Run queued work, highest priority first.  After each item the scan starts
+	over at the top so high priority work posted while a low priority item ran
+	goes next.  Returns the number of items run.
+*/
+
+HOT uint32_t work_queue_dispatch(void)
+{
+	uint32_t to_return = 0;
+	uint32_t priority = 0;
+	while (priority < Work_Priority_Count)
+	{
+		Work_Ring *ring = &work_rings[priority];
+		if (ring->read_index == ring->write_index)
+		{
+			priority++;
+			continue;
+		}
+
+		Work_Item *item = ring->items[ring->read_index & WORK_QUEUE_MASK];
+		ring->read_index++;
+		//Clear pending before running so the handler (or an interrupt) can requeue it
+		item->pending = 0;
+		item->handler_ptr(item->argument);
+		to_return++;
+		priority = 0;
+	}
+	return to_return;
+}
+
+uint32_t work_queue_pending(void)
+{
+	uint32_t to_return = 0;
+	for (uint32_t priority = 0; priority < Work_Priority_Count; priority++)
+	{
+		to_return += work_rings[priority].write_index - work_rings[priority].read_index;
+	}
+	return to_return;
+}
+
+COLD void work_queue_dump_stats(void)
+{
+	for (uint32_t priority = 0; priority < Work_Priority_Count; priority++)
+	{
+		log_string_plus("Work priority: ", priority);
+		log_string_plus("  posted: ", work_rings[priority].posted);
+		log_string_plus("  coalesced: ", work_rings[priority].coalesced);
+		log_string_plus("  dropped: ", work_rings[priority].dropped);
+		log_string_plus("  max depth: ", work_rings[priority].max_depth);
+	}
+}